@@ -0,0 +1,301 @@
+/**
+ * @file airqualityindex.cpp
+ * @brief Implementation of the air quality index engine.
+ */
+
+#include "airqualityindex.h"
+#include "db.h"
+#include "storesnapshot.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtNumeric>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+namespace {
+const char kMagic[8] = { 'W', 'X', 'A', 'Q', 'I', '1', 0, 0 };
+const int kMaxWindow = 24; ///< Longest window of any pollutant
+
+/**
+ * @brief Upper bounds of the categories VeryGood to Bad in µg/m³ (GIOS, 2020).
+ * @details A mean above the last bound is VeryBad.
+ */
+const float kThresholds[AirQualityIndex::PollutantCount][5] = {
+    { 20, 50, 80, 110, 150 },   // PM10, 24 h
+    { 13, 35, 55, 75, 110 },    // PM2.5, 24 h
+    { 40, 100, 150, 230, 400 }, // NO2, 1 h
+    { 50, 100, 200, 350, 500 }, // SO2, 1 h
+    { 70, 120, 150, 180, 240 }, // O3, 8 h
+};
+
+QString cachePath(const QString &location)
+{
+    return db::getAppDataPath() + "/db/" + location + "/index.aqi";
+}
+
+/**
+ * @brief Reads a cached index series.
+ * @return bool False if the file is missing or damaged.
+ */
+bool readCache(const QString &location, AirQualityIndex::Series *series)
+{
+    QFile file(cachePath(location));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[sizeof(kMagic)];
+    if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic)) || memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+        return false;
+
+    qint64 firstHour = 0;
+    quint32 count = 0;
+    in >> firstHour;
+    for (qint32 &until : series->inputsUntil)
+        in >> until;
+    in >> count;
+    if (in.status() != QDataStream::Ok || file.size() - file.pos() != qint64(count) * 2)
+        return false;
+
+    series->firstHour = firstHour;
+    series->categories.resize(int(count));
+    series->dominant.resize(int(count));
+    in.readRawData(reinterpret_cast<char *>(series->categories.data()), int(count));
+    in.readRawData(reinterpret_cast<char *>(series->dominant.data()), int(count));
+    return in.status() == QDataStream::Ok;
+}
+
+/**
+ * @brief Replaces a cached index series atomically.
+ */
+void writeCache(const AirQualityIndex::Series &series)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(kMagic, sizeof(kMagic));
+    out << series.firstHour;
+    for (qint32 until : series.inputsUntil)
+        out << until;
+    out << quint32(series.categories.size());
+    out.writeRawData(reinterpret_cast<const char *>(series.categories.constData()), int(series.categories.size()));
+    out.writeRawData(reinterpret_cast<const char *>(series.dominant.constData()), int(series.dominant.size()));
+
+    QSaveFile file(cachePath(series.location));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) < 0 || !file.commit())
+        qWarning() << "Could not write the index of" << series.location;
+}
+}
+
+/**
+ * @brief Implementation of Series::latest().
+ */
+int AirQualityIndex::Series::latest() const
+{
+    for (int i = categories.size() - 1; i >= 0; --i) {
+        if (categories[i] != NoIndex)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Implementation of key().
+ */
+QString AirQualityIndex::key(Pollutant pollutant)
+{
+    static const char *const keys[PollutantCount] = { "PM10", "PM2.5", "NO2", "SO2", "O3" };
+    return keys[pollutant];
+}
+
+/**
+ * @brief Implementation of windowHours().
+ */
+int AirQualityIndex::windowHours(Pollutant pollutant)
+{
+    switch (pollutant) {
+    case PM10:
+    case PM25:
+        return 24;
+    case O3:
+        return 8;
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief Implementation of categoryName().
+ */
+QString AirQualityIndex::categoryName(int category)
+{
+    static const char *const names[] = { "Bardzo dobry", "Dobry", "Umiarkowany", "Dostateczny", "Zły", "Bardzo zły" };
+    return category >= VeryGood && category <= VeryBad ? QString::fromUtf8(names[category]) : QString("Brak indeksu");
+}
+
+/**
+ * @brief Implementation of categorize().
+ * @details Counts the bounds the mean is above; the comparisons have no
+ * branches, so loops calling this vectorize.
+ */
+AirQualityIndex::Category AirQualityIndex::categorize(Pollutant pollutant, float mean)
+{
+    const float *t = kThresholds[pollutant];
+    const int passed = (mean > t[0]) + (mean > t[1]) + (mean > t[2]) + (mean > t[3]) + (mean > t[4]);
+    return qIsNaN(mean) ? NoIndex : Category(passed);
+}
+
+/**
+ * @brief Implementation of rollingMeans().
+ * @details Each hour adds the value entering the window and removes the one
+ * leaving it, so the cost does not depend on the window length. The sum is
+ * restarted whenever the window is empty to keep rounding from piling up.
+ */
+QVector<float> AirQualityIndex::rollingMeans(const QVector<float> &hours, int window, int minCount)
+{
+    QVector<float> means(hours.size(), qQNaN());
+    double sum = 0;
+    int count = 0;
+
+    for (int i = 0; i < hours.size(); ++i) {
+        const float entering = hours[i];
+        if (!qIsNaN(entering)) {
+            sum += entering;
+            count++;
+        }
+        if (i >= window) {
+            const float leaving = hours[i - window];
+            if (!qIsNaN(leaving)) {
+                sum -= leaving;
+                count--;
+            }
+        }
+        if (count == 0)
+            sum = 0;
+        if (count >= minCount)
+            means[i] = float(sum / count);
+    }
+    return means;
+}
+
+/**
+ * @brief Implementation of compute().
+ * @details The cache is reused when it starts at the same hour as the data,
+ * i.e. nothing older than it was imported since. Hours before
+ * kRevisionHours ahead of its end are then copied, and the rest is
+ * recomputed from inputs reaching one window further back.
+ */
+AirQualityIndex::Series AirQualityIndex::compute(const QString &location)
+{
+    Series series;
+    series.location = location;
+
+    TilePyramid pyramids[PollutantCount];
+    qint64 firstHour = std::numeric_limits<qint64>::max();
+    qint64 lastHour = std::numeric_limits<qint64>::min();
+    for (int p = 0; p < PollutantCount; ++p) {
+        if (db::latestStoredTimestamp(location, key(Pollutant(p))) == 0)
+            continue;
+        pyramids[p] = db::loadPyramid(location, key(Pollutant(p)));
+        series.inputsUntil[p] = pyramids[p].coveredUntil();
+        if (pyramids[p].isEmpty())
+            continue;
+        firstHour = qMin(firstHour, qint64(pyramids[p].firstTimestamp()) / TilePyramid::kBaseSeconds);
+        lastHour = qMax(lastHour, qint64(pyramids[p].lastTimestamp()) / TilePyramid::kBaseSeconds);
+    }
+    if (lastHour < firstHour)
+        return series;
+
+    Series cached;
+    qint64 from = firstHour;
+    if (readCache(location, &cached) && cached.firstHour == firstHour) {
+        if (memcmp(cached.inputsUntil, series.inputsUntil, sizeof(series.inputsUntil)) == 0) {
+            cached.location = location;
+            return cached;
+        }
+        from = qBound(firstHour, cached.firstHour + cached.categories.size() - kRevisionHours, lastHour + 1);
+    }
+
+    const int hours = int(lastHour - firstHour + 1);
+    const int kept = int(from - firstHour);
+    series.firstHour = firstHour;
+    series.categories = cached.categories.mid(0, kept);
+    series.dominant = cached.dominant.mid(0, kept);
+    series.categories.resize(hours);
+    series.dominant.resize(hours);
+    std::fill(series.categories.begin() + kept, series.categories.end(), qint8(NoIndex));
+    std::fill(series.dominant.begin() + kept, series.dominant.end(), qint8(-1));
+
+    // Inputs start one window early so the first recomputed hour has a full window
+    const qint64 inputFrom = qMax(firstHour, from - (kMaxWindow - 1));
+    const int inputCount = int(lastHour - inputFrom + 1);
+    const int offset = int(from - inputFrom);
+    qint8 *categories = series.categories.data() + kept;
+    qint8 *dominant = series.dominant.data() + kept;
+
+    for (int p = 0; p < PollutantCount; ++p) {
+        if (pyramids[p].isEmpty())
+            continue;
+        const Pollutant pollutant = Pollutant(p);
+        const int window = windowHours(pollutant);
+        const QVector<float> means = rollingMeans(pyramids[p].hourValues(inputFrom, inputCount),
+                                                  window, (window * 3 + 3) / 4);
+        const float *m = means.constData() + offset;
+        for (int i = 0; i < hours - kept; ++i) {
+            const qint8 category = qint8(categorize(pollutant, m[i]));
+            const bool worse = category > categories[i];
+            categories[i] = worse ? category : categories[i];
+            dominant[i] = worse ? qint8(p) : dominant[i];
+        }
+    }
+
+    writeCache(series);
+    return series;
+}
+
+/**
+ * @brief Implementation of computeAll().
+ * @details Workers claim locations through an atomic counter, as in
+ * ArchiveAnalytics; each writes its own result slot.
+ */
+QVector<AirQualityIndex::Series> AirQualityIndex::computeAll(const QStringList &locations, int threads)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QStringList names = locations.isEmpty() ? StoreSnapshot::capture().locations() : locations;
+    QVector<Series> results(names.size());
+
+    QThreadPool pool;
+    if (threads > 0)
+        pool.setMaxThreadCount(threads);
+    const int workers = qMax(1, qMin(pool.maxThreadCount(), int(names.size())));
+    std::atomic_int next{0};
+
+    for (int w = 0; w < workers; ++w) {
+        pool.start([&]() {
+            for (int i = next++; i < names.size(); i = next++)
+                results[i] = compute(names[i]);
+        });
+    }
+    pool.waitForDone();
+
+    QVector<Series> indexed;
+    qint64 hours = 0;
+    for (const Series &series : std::as_const(results)) {
+        if (!series.isEmpty()) {
+            indexed.append(series);
+            hours += series.categories.size();
+        }
+    }
+    qDebug() << "Air quality index:" << indexed.size() << "locations," << hours << "hours,"
+             << workers << "workers," << timer.elapsed() << "ms";
+    return indexed;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file airqualityindex.h
+ * @brief Hourly air quality index of stored stations.
+ */
+
+#ifndef AIRQUALITYINDEX_H
+#define AIRQUALITYINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @class AirQualityIndex
+ * @brief Polish air quality index ("Polski Indeks Jakości Powietrza") from stored data.
+ *
+ * Each pollutant is averaged over its own window: 24 hours for PM10 and
+ * PM2.5, 8 hours for O3 and one hour for NO2 and SO2. A window needs 75% of
+ * its hours. Each mean is put into one of six GIOS categories and the index
+ * of an hour is the worst category of its pollutants.
+ *
+ * Inputs are the hour columns of the stations' tile pyramids, which are
+ * already aligned on whole hours, so a station costs one pass per pollutant
+ * over contiguous floats: a rolling window keeps its sum and count and
+ * updates them with the hour entering and the hour leaving, and categories
+ * are found by counting passed thresholds without branches.
+ *
+ * Results are kept in "db/[location]/index.aqi". A later run recomputes only
+ * the last kRevisionHours plus the hours added since, and nothing at all if
+ * no pollutant has new data. Data imported for hours older than the cached
+ * series discards the cache; data filled in further back than
+ * kRevisionHours inside it is not picked up until then.
+ */
+class AirQualityIndex
+{
+public:
+    /**
+     * @brief Pollutants of the index.
+     */
+    enum Pollutant {
+        PM10,
+        PM25,
+        NO2,
+        SO2,
+        O3,
+        PollutantCount
+    };
+
+    /**
+     * @brief Index categories, from best to worst.
+     */
+    enum Category {
+        NoIndex = -1,
+        VeryGood = 0,
+        Good,
+        Moderate,
+        Sufficient,
+        Bad,
+        VeryBad
+    };
+
+    /**
+     * @brief Index series of one location.
+     */
+    struct Series {
+        QString location;
+        qint64 firstHour = 0;                   ///< Hours since the epoch of categories[0]
+        QVector<qint8> categories;              ///< Category per hour
+        QVector<qint8> dominant;                ///< Pollutant deciding each hour, -1 for none
+        qint32 inputsUntil[PollutantCount] = {}; ///< TilePyramid::coveredUntil() of each pollutant when computed
+
+        bool isEmpty() const { return categories.isEmpty(); }
+
+        /**
+         * @brief Position of the newest hour with an index, -1 if there is none.
+         */
+        int latest() const;
+    };
+
+    static const int kRevisionHours = 72; ///< Hours recomputed even if cached; GIOS revises recent values
+
+    /**
+     * @brief Parameter key of a pollutant in the store, e.g. "PM2.5".
+     */
+    static QString key(Pollutant pollutant);
+
+    /**
+     * @brief Averaging window of a pollutant in hours.
+     */
+    static int windowHours(Pollutant pollutant);
+
+    /**
+     * @brief Polish name of a category, e.g. "Umiarkowany".
+     */
+    static QString categoryName(int category);
+
+    /**
+     * @brief Category of a mean concentration.
+     * @param mean Concentration in µg/m³, averaged over windowHours().
+     */
+    static Category categorize(Pollutant pollutant, float mean);
+
+    /**
+     * @brief Trailing rolling means over a dense hour column.
+     * @param hours Hour values, NaN where missing.
+     * @param window Window length in hours.
+     * @param minCount Values a window needs for a mean.
+     * @return QVector<float> Mean of the window ending at each hour, NaN if it has too few values.
+     */
+    static QVector<float> rollingMeans(const QVector<float> &hours, int window, int minCount);
+
+    /**
+     * @brief Index series of one location, updated from its cached result.
+     * @note Writes the cache file when anything was recomputed.
+     */
+    static Series compute(const QString &location);
+
+    /**
+     * @brief Index series of several locations on a thread pool.
+     * @param locations Store locations; empty for all locations in the store.
+     * @param threads Worker count (0 for one per core).
+     * @return QVector<Series> Series of locations with data for any pollutant, in order of locations.
+     */
+    static QVector<Series> computeAll(const QStringList &locations = QStringList(), int threads = 0);
+};
+
+#endif // AIRQUALITYINDEX_H
@@ -0,0 +1,193 @@
+/**
+ * @file allocstats.cpp
+ * @brief Implementation of the allocation counters.
+ */
+
+#include "allocstats.h"
+#include <QDebug>
+#include <QStringList>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef WEATHERAPP_ALLOC_STATS
+namespace {
+std::atomic<quint64> allocations[AllocStats::StageCount];
+std::atomic<quint64> bytes[AllocStats::StageCount];
+thread_local AllocStats::Stage currentStage = AllocStats::Other;
+
+void count(std::size_t size)
+{
+    allocations[currentStage].fetch_add(1, std::memory_order_relaxed);
+    bytes[currentStage].fetch_add(size, std::memory_order_relaxed);
+}
+}
+
+#ifdef __GLIBC__
+// Replacements for the C allocator. Definitions in the executable take
+// precedence over the C library's for every shared library as well, so Qt's
+// container buffers and the standard library's operator new are counted
+// here. realloc() counts as one allocation of its new size; the aligned
+// allocation functions are not replaced and not counted.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *p, std::size_t size);
+void __libc_free(void *p);
+
+void *malloc(std::size_t size)
+{
+    count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size)
+{
+    count(n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, std::size_t size)
+{
+    count(size);
+    return __libc_realloc(p, size);
+}
+
+void free(void *p)
+{
+    __libc_free(p);
+}
+}
+#else
+// Replacements for the global allocation functions; the sized and nothrow
+// variants of the standard library forward to these. Over-aligned
+// allocations keep the library's functions and are not counted, and
+// neither is anything allocated with malloc().
+void *operator new(std::size_t size)
+{
+    count(size);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+#endif
+
+/**
+ * @brief Implementation of the Scope constructor.
+ */
+AllocStats::Scope::Scope(Stage stage)
+    : m_previous(currentStage)
+{
+    currentStage = stage;
+}
+
+AllocStats::Scope::~Scope()
+{
+    currentStage = m_previous;
+}
+#endif
+
+/**
+ * @brief Implementation of counts().
+ */
+AllocStats::Counts AllocStats::counts(Stage stage)
+{
+    Counts result;
+#ifdef WEATHERAPP_ALLOC_STATS
+    result.allocations = allocations[stage].load(std::memory_order_relaxed);
+    result.bytes = bytes[stage].load(std::memory_order_relaxed);
+#else
+    Q_UNUSED(stage);
+#endif
+    return result;
+}
+
+/**
+ * @brief Implementation of total().
+ */
+AllocStats::Counts AllocStats::total()
+{
+    Counts result;
+    for (int stage = 0; stage < StageCount; ++stage) {
+        const Counts stageCounts = counts(Stage(stage));
+        result.allocations += stageCounts.allocations;
+        result.bytes += stageCounts.bytes;
+    }
+    return result;
+}
+
+/**
+ * @brief Implementation of reset().
+ */
+void AllocStats::reset()
+{
+#ifdef WEATHERAPP_ALLOC_STATS
+    for (int stage = 0; stage < StageCount; ++stage) {
+        allocations[stage].store(0, std::memory_order_relaxed);
+        bytes[stage].store(0, std::memory_order_relaxed);
+    }
+#endif
+}
+
+/**
+ * @brief Implementation of report().
+ */
+void AllocStats::report(const QString &label)
+{
+    if (!isEnabled())
+        return;
+
+    // Read everything before formatting, which allocates itself
+    Counts stages[StageCount];
+    const Counts all = total();
+    for (int stage = 0; stage < StageCount; ++stage)
+        stages[stage] = counts(Stage(stage));
+
+    QStringList parts;
+    for (int stage = 0; stage < StageCount; ++stage) {
+        parts.append(QString("%1 %2 (%3 KB)")
+                         .arg(stageName(Stage(stage)))
+                         .arg(stages[stage].allocations)
+                         .arg(stages[stage].bytes / 1024.0, 0, 'f', 1));
+    }
+    if (countsMalloc())
+        qInfo().noquote() << "Allocations for" << label + ":" << parts.join(", ") << "- total" << all.allocations;
+    else
+        qInfo().noquote() << "operator new calls for" << label + ":" << parts.join(", ")
+                          << "- Qt container buffers not counted";
+    reset();
+}
+
+/**
+ * @brief Implementation of stageName().
+ */
+const char *AllocStats::stageName(Stage stage)
+{
+    switch (stage) {
+    case Decode:
+        return "decode";
+    case Stats:
+        return "stats";
+    case Store:
+        return "store";
+    case Chart:
+        return "chart";
+    default:
+        return "other";
+    }
+}
@@ -0,0 +1,113 @@
+/**
+ * @file allocstats.h
+ * @brief Heap allocation counters per processing stage (WEATHERAPP_ALLOC_STATS builds).
+ */
+
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <QString>
+
+/**
+ * @class AllocStats
+ * @brief Counts heap allocations and bytes by the stage that made them.
+ *
+ * Only builds configured with -DWEATHERAPP_ALLOC_STATS=ON count: they
+ * replace the allocator, which charges each allocation to the stage of the
+ * calling thread. A Scope sets that stage for its lifetime; allocations
+ * outside any scope count as Other. In normal builds scopes compile to
+ * nothing and report() logs nothing.
+ *
+ * On glibc, malloc(), calloc() and realloc() are replaced, so the counts
+ * include Qt's container buffers (QString, QByteArray, QList and the JSON
+ * classes allocate through malloc) and every library's allocations. On
+ * other C libraries only operator new is replaced; those buffers are then
+ * missed and the counts are a lower bound (see countsMalloc()).
+ *
+ * Counters are process-wide, so a report covers everything allocated since
+ * the last reset(), including other threads' work in stage Other.
+ */
+class AllocStats
+{
+public:
+    /**
+     * @brief Pipeline stage of a sensor request.
+     */
+    enum Stage {
+        Other,
+        Decode, ///< API response to SensorSeries
+        Stats,  ///< Quality checks, aggregates and tiles
+        Store,  ///< Serializing and writing store files
+        Chart,  ///< Building and filling the chart
+        StageCount
+    };
+
+    /**
+     * @brief Allocations of one stage.
+     */
+    struct Counts {
+        quint64 allocations = 0;
+        quint64 bytes = 0;
+    };
+
+    /**
+     * @brief Charges the calling thread's allocations to a stage until destroyed.
+     */
+    class Scope
+    {
+    public:
+#ifdef WEATHERAPP_ALLOC_STATS
+        explicit Scope(Stage stage);
+        ~Scope();
+
+    private:
+        Stage m_previous;
+#else
+        explicit Scope(Stage) {}
+#endif
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    /**
+     * @brief Whether this build counts allocations.
+     */
+    static constexpr bool isEnabled()
+    {
+#ifdef WEATHERAPP_ALLOC_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Whether malloc() and realloc() are counted, not only operator new.
+     */
+    static constexpr bool countsMalloc()
+    {
+#if defined(WEATHERAPP_ALLOC_STATS) && defined(__GLIBC__)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static Counts counts(Stage stage);
+    static Counts total();
+
+    /**
+     * @brief Zeroes all counters.
+     */
+    static void reset();
+
+    /**
+     * @brief Logs the counters of every stage, then resets them.
+     * @param label What was measured, e.g. "sensor 92".
+     */
+    static void report(const QString &label);
+
+    static const char *stageName(Stage stage);
+};
+
+#endif // ALLOCSTATS_H
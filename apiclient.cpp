@@ -4,15 +4,170 @@
  */
 
 #include "ApiClient.h"
+#include "allocstats.h"
+#include "responsearchive.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHttp2Configuration>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QPointer>
+#include <QThread>
+#if QT_CONFIG(ssl)
+#include <QSslConfiguration>
+#endif
+#include <zlib.h>
+
+namespace {
+const char *const kDefaultBaseUrl = "https://api.gios.gov.pl/pjp-api/rest";
+const int kStreamWindow = 4 * 1024 * 1024; ///< HTTP/2 receive window; findAll arrives without flow-control stalls
+
+/**
+ * @brief Network access manager shared by the clients of the calling thread.
+ * @details A QNetworkAccessManager may only be used from its own thread,
+ * so each thread gets one. The main thread's is owned by the application
+ * object; another thread's is deleted when that thread finishes.
+ */
+QNetworkAccessManager *sharedManager()
+{
+    static thread_local QPointer<QNetworkAccessManager> manager;
+    if (!manager) {
+        QCoreApplication *app = QCoreApplication::instance();
+        QThread *thread = QThread::currentThread();
+        manager = new QNetworkAccessManager(app && app->thread() == thread ? app : nullptr);
+        if (!manager->parent())
+            QObject::connect(thread, &QThread::finished, manager, &QObject::deleteLater);
+    }
+    return manager;
+}
+
+/**
+ * @brief Inflates a compressed body.
+ * @param windowBits As for inflateInit2(): 15 + 32 for a zlib or gzip
+ * header detected from the data, -15 for raw deflate data.
+ */
+bool inflateStream(const QByteArray &encoded, int windowBits, QByteArray *decoded)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, windowBits) != Z_OK)
+        return false;
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(encoded.constData()));
+    stream.avail_in = uInt(encoded.size());
+
+    decoded->clear();
+    decoded->reserve(encoded.size() * 4);
+    char buffer[16384];
+    int result = Z_OK;
+    while (result == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_OK || result == Z_STREAM_END)
+            decoded->append(buffer, qsizetype(sizeof(buffer) - stream.avail_out));
+    }
+    inflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+/**
+ * @brief Decodes a gzip or deflate response body.
+ * @param encoded Body as transferred.
+ * @param encoding Content-Encoding, lower case.
+ * @param decoded Receives the decoded body.
+ * @return bool False if the body is truncated or damaged.
+ * @note "deflate" is meant to be zlib-wrapped, but some servers send raw
+ * deflate data; that is tried when the zlib header does not check out.
+ */
+bool inflateBody(const QByteArray &encoded, const QByteArray &encoding, QByteArray *decoded)
+{
+    if (inflateStream(encoded, 15 + 32, decoded))
+        return true;
+    return encoding == "deflate" && inflateStream(encoded, -15, decoded);
+}
+}
 
 /**
- * @brief Constructs the ApiClient and initializes network manager.
+ * @brief Constructs the ApiClient on the shared network manager.
  * @param parent Parent QObject (optional).
  */
-ApiClient::ApiClient(QObject *parent) : QObject(parent) {
-    manager = new QNetworkAccessManager(this);
+ApiClient::ApiClient(QObject *parent)
+    : QObject(parent)
+    , manager(sharedManager())
+    , baseUrl(qEnvironmentVariable("WEATHERAPP_API_BASE", kDefaultBaseUrl)) {
+}
+
+/**
+ * @brief Implementation of preconnect().
+ * @details The TLS configuration offers the same protocols as get(), so
+ * the connection is cached under the key the first request looks up.
+ */
+void ApiClient::preconnect() {
+    const QUrl url(baseUrl);
+#if QT_CONFIG(ssl)
+    if (url.scheme() == "https") {
+        QSslConfiguration ssl = QSslConfiguration::defaultConfiguration();
+        if (m_http2Allowed)
+            ssl.setAllowedNextProtocols({ QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::NextProtocolHttp1_1 });
+        manager->connectToHostEncrypted(url.host(), quint16(url.port(443)), ssl);
+        return;
+    }
+#endif
+    manager->connectToHost(url.host(), quint16(url.port(80)));
+}
+
+/**
+ * @brief Implementation of get().
+ * @details Accept-Encoding is set by hand, which turns off Qt's transparent
+ * decompression: the reply then holds the body as transferred, so its size
+ * is the wire size, and readBody() decodes it.
+ */
+QNetworkReply *ApiClient::get(const QString &path, QNetworkRequest::Priority priority) {
+    QNetworkRequest request(QUrl(baseUrl + path));
+    request.setPriority(priority);
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, m_http2Allowed);
+    request.setRawHeader("Accept-Encoding", "gzip, deflate");
+
+    QHttp2Configuration http2;
+    http2.setStreamReceiveWindowSize(kStreamWindow);
+    http2.setSessionReceiveWindowSize(kStreamWindow);
+    request.setHttp2Configuration(http2);
+
+    QNetworkReply *reply = manager->get(request);
+    reply->setProperty("apiPath", path);
+#if QT_CONFIG(ssl)
+    // Emitted only by replies that completed a new handshake
+    connect(reply, &QNetworkReply::encrypted, this, [this]() { m_stats.handshakes++; });
+#endif
+    // Connected before the caller's handler, so the body is still unread
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        m_stats.requests++;
+        m_stats.wireBytes += reply->bytesAvailable(); // Still encoded, see above
+        if (reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool())
+            m_stats.http2++;
+        if (reply->hasRawHeader("Content-Encoding"))
+            m_stats.compressed++;
+    });
+    return reply;
+}
+
+/**
+ * @brief Implementation of readBody().
+ * @details Bodies are archived before parsing, so a response the current
+ * parser rejects can still be reprocessed later.
+ */
+QByteArray ApiClient::readBody(QNetworkReply *reply) {
+    QByteArray body = reply->readAll();
+    const QByteArray encoding = reply->rawHeader("Content-Encoding").trimmed().toLower();
+    if (!encoding.isEmpty() && encoding != "identity") {
+        QByteArray decoded;
+        if (!inflateBody(body, encoding, &decoded))
+            qWarning() << "Could not decode" << encoding << "response of" << reply->property("apiPath").toString();
+        body = decoded; // Empty if damaged; rejected by the parser
+    }
+    m_stats.payloadBytes += body.size();
+    if (ResponseArchive *archive = ResponseArchive::instance())
+        archive->record(reply->property("apiPath").toString(), body);
+    return body;
 }
 
 /**
@@ -22,9 +177,7 @@ ApiClient::ApiClient(QObject *parent) : QObject(parent) {
  * - `errorOccurred(QString)` on network or data format errors.
  */
 void ApiClient::getAllStations() {
-    QUrl url(baseUrl + "/station/findAll");
-    QNetworkRequest request(url);
-    QNetworkReply *reply = manager->get(request);
+    QNetworkReply *reply = get("/station/findAll");
 
     connect(reply, &QNetworkReply::finished, [this, reply]() {
         if (reply->error() != QNetworkReply::NoError) {
@@ -33,7 +186,7 @@ void ApiClient::getAllStations() {
             return;
         }
 
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
+        QJsonDocument doc = QJsonDocument::fromJson(readBody(reply));
         reply->deleteLater();
 
         if (doc.isNull() || !doc.isArray()) {
@@ -48,7 +201,8 @@ void ApiClient::getAllStations() {
 /**
  * @brief Processes raw station data into a simplified JSON structure.
  * @param stations Raw QJsonArray from GIOS API.
- * @details Extracts: city, district, province, and street names.
+ * @details Extracts: city, district, province, street names and coordinates,
+ * plus the station code when the API provides one (used by the archive importer).
  * Emits `allStationsProcessed(QJsonArray)` with filtered data.
  */
 void ApiClient::processStationsData(const QJsonArray &stations) {
@@ -64,6 +218,16 @@ void ApiClient::processStationsData(const QJsonArray &stations) {
         filteredStation["district"] = commune["districtName"];
         filteredStation["province"] = commune["provinceName"];
         filteredStation["station_street"] = station["stationName"];
+        if (station.contains("stationCode"))
+            filteredStation["station_code"] = station["stationCode"];
+
+        // Coordinates arrive as strings ("50.972167"); store them as numbers
+        QJsonValue lat = station["gegrLat"];
+        QJsonValue lon = station["gegrLon"];
+        if (!lat.isUndefined() && !lon.isUndefined()) {
+            filteredStation["lat"] = lat.isString() ? lat.toString().toDouble() : lat.toDouble();
+            filteredStation["lon"] = lon.isString() ? lon.toString().toDouble() : lon.toDouble();
+        }
 
         filteredData.append(filteredStation);
     }
@@ -73,16 +237,14 @@ void ApiClient::processStationsData(const QJsonArray &stations) {
 /**
  * @brief Fetches sensor details for a specific station.
  * @param stationId Unique ID of the station.
+ * @param priority Network priority of the request.
  * @details Emits:
  * - `stationDetailsReceived(QJsonObject)` on success.
  * - `errorOccurred(QString)` on failure.
  */
-void ApiClient::getStationDetails(int stationId) {
+void ApiClient::getStationDetails(int stationId, QNetworkRequest::Priority priority) {
     emit statusChanged(QString("Searching for sensors of station %1...").arg(stationId));
-    QUrl url(baseUrl + QString("/station/sensors/%1").arg(stationId));
-    QNetworkRequest request(url);
-
-    auto reply = manager->get(request);
+    auto reply = get(QString("/station/sensors/%1").arg(stationId), priority);
     connect(reply, &QNetworkReply::finished, [this, reply]() {
         handleResponse(reply, [this](const QJsonDocument &doc) {
             if (doc.isObject()) {
@@ -105,31 +267,39 @@ void ApiClient::getStationDetails(int stationId) {
 /**
  * @brief Fetches measurement data for a specific sensor.
  * @param sensorId Unique ID of the sensor.
+ * @param priority Network priority of the request.
  * @details Emits:
- * - `sensorDataReceived(QJsonObject)` on success.
+ * - `sensorDataReceived(SensorSeries)` on success.
  * - `errorOccurred(QString)` on failure.
  */
-void ApiClient::getSensorData(int sensorId) {
+void ApiClient::getSensorData(int sensorId, QNetworkRequest::Priority priority) {
     emit statusChanged(QString("Searching for data of sensor %1...").arg(sensorId));
-    QUrl url(baseUrl + QString("/data/getData/%1").arg(sensorId));
-    QNetworkRequest request(url);
-
-    auto reply = manager->get(request);
-    connect(reply, &QNetworkReply::finished, [this, reply]() {
-        handleResponse(reply, [this](const QJsonDocument &doc) {
+    auto reply = get(QString("/data/getData/%1").arg(sensorId), priority);
+    connect(reply, &QNetworkReply::finished, [this, reply, sensorId]() {
+        handleResponse(reply, [this, sensorId](const QJsonDocument &doc) {
             if (doc.isObject()) {
-                emit sensorDataReceived(doc.object());
-                emit statusChanged("Successfully retrieved sensor data");
-            }
-            else if (doc.isArray()) {
-                QJsonObject wrapper;
-                wrapper["data"] = doc.array();
-                emit sensorDataReceived(wrapper);
+                SensorSeries series;
+                {
+                    AllocStats::Scope decode(AllocStats::Decode);
+                    series = SensorSeries::fromJson(doc.object(), sensorId);
+                }
+                emit sensorDataReceived(series);
                 emit statusChanged("Successfully retrieved sensor data");
             }
             else {
                 emit errorOccurred("Invalid response format");
             }
+        }, [this, sensorId](const QByteArray &body) {
+            // Common case: read the body directly, without a JSON document
+            SensorSeries series;
+            {
+                AllocStats::Scope decode(AllocStats::Decode);
+                if (!SensorSeries::fromResponse(body, sensorId, &series))
+                    return false;
+            }
+            emit sensorDataReceived(series);
+            emit statusChanged("Successfully retrieved sensor data");
+            return true;
         });
     });
 }
@@ -138,12 +308,23 @@ void ApiClient::getSensorData(int sensorId) {
  * @brief Handles network responses and errors.
  * @param reply Network reply object.
  * @param successHandler Callback for processing successful JSON responses.
+ * @param rawHandler Tried on the body before it is parsed as JSON (optional).
  * @details Emits `statusChanged(QString)` or `errorOccurred(QString)`.
  */
 void ApiClient::handleResponse(QNetworkReply *reply,
-                               std::function<void(const QJsonDocument&)> successHandler) {
+                               std::function<void(const QJsonDocument&)> successHandler,
+                               std::function<bool(const QByteArray&)> rawHandler) {
     if (reply->error() == QNetworkReply::NoError) {
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
+        const QByteArray body = readBody(reply);
+        if (rawHandler && rawHandler(body)) {
+            reply->deleteLater();
+            return;
+        }
+        QJsonDocument doc;
+        {
+            AllocStats::Scope decode(AllocStats::Decode);
+            doc = QJsonDocument::fromJson(body);
+        }
         if (!doc.isNull()) {
             successHandler(doc);
             emit statusChanged("Success");
@@ -11,6 +11,7 @@
 #include <QtNetwork/QNetworkReply>
 #include <QJsonDocument>
 #include <functional>
+#include "sensorseries.h"
 
 /**
  * @class ApiClient
@@ -20,16 +21,60 @@
  * - Retrieving list of monitoring stations
  * - Fetching station details
  * - Getting sensor measurements
+ *
+ * All clients share one QNetworkAccessManager, so the main
+ * window, the prefetcher and the poll scheduler reuse the same pooled
+ * connections and TLS sessions. Requests allow HTTP/2, which multiplexes a
+ * sensor sweep over one connection; over HTTP/1.1 Qt's default of six
+ * connections per host applies. Responses are negotiated with gzip/deflate
+ * and decoded by the client rather than by Qt, so the transferred size can
+ * be counted. Transfer statistics of each client are available from
+ * transportStats(). Clients must be created on the main thread.
+ *
+ * The base URL can be changed with the WEATHERAPP_API_BASE environment
+ * variable, e.g. to measure against a local stand-in for the GIOS API.
+ * With WEATHERAPP_RAW_ARCHIVE set, response bodies are kept in the
+ * ResponseArchive.
  */
 class ApiClient : public QObject {
     Q_OBJECT
 public:
+    /**
+     * @brief Counters of the requests sent by one client.
+     */
+    struct TransportStats {
+        int requests = 0;         ///< Finished requests, including failed ones
+        int http2 = 0;            ///< Requests served over HTTP/2
+        int compressed = 0;       ///< Responses with a Content-Encoding
+        int handshakes = 0;       ///< TLS handshakes; other HTTPS requests reused a connection
+        qint64 wireBytes = 0;     ///< Response bodies as transferred, still encoded
+        qint64 payloadBytes = 0;  ///< Bodies of successful responses after decoding
+    };
+
     /**
      * @brief Constructs an ApiClient instance
      * @param parent Parent QObject (optional)
      */
     explicit ApiClient(QObject *parent = nullptr);
 
+    /**
+     * @brief Opens a connection to the API host ahead of the first request.
+     * @details Performs DNS lookup, TCP connect and, for HTTPS, the TLS
+     * handshake, so the first real request starts on a warm connection.
+     */
+    void preconnect();
+
+    /**
+     * @brief Transfer statistics of this client since it was created.
+     */
+    TransportStats transportStats() const { return m_stats; }
+
+    /**
+     * @brief Allows or forbids HTTP/2 for further requests of this client.
+     * @note Meant for comparing transports; HTTP/2 is allowed by default.
+     */
+    void setHttp2Allowed(bool allowed) { m_http2Allowed = allowed; }
+
     /**
      * @brief Requests list of all air quality monitoring stations
      * @note Emits allStationsProcessed() or errorOccurred() when complete
@@ -39,16 +84,18 @@ public:
     /**
      * @brief Requests details for specific monitoring station
      * @param stationId Unique identifier of the station
+     * @param priority Network priority of the request
      * @note Emits stationDetailsReceived() or errorOccurred() when complete
      */
-    void getStationDetails(int stationId);
+    void getStationDetails(int stationId, QNetworkRequest::Priority priority = QNetworkRequest::NormalPriority);
 
     /**
      * @brief Requests measurement data from specific sensor
      * @param sensorId Unique identifier of the sensor
+     * @param priority Network priority of the request
      * @note Emits sensorDataReceived() or errorOccurred() when complete
      */
-    void getSensorData(int sensorId);
+    void getSensorData(int sensorId, QNetworkRequest::Priority priority = QNetworkRequest::NormalPriority);
 
 signals:
     /**
@@ -65,9 +112,9 @@ signals:
 
     /**
      * @brief Emitted when sensor measurement data is received
-     * @param data JSON object containing sensor readings
+     * @param series Parsed sensor readings
      */
-    void sensorDataReceived(const QJsonObject &data);
+    void sensorDataReceived(const SensorSeries &series);
 
     /**
      * @brief Emitted when API request fails
@@ -82,8 +129,26 @@ signals:
     void statusChanged(const QString &status);
 
 private:
-    QNetworkAccessManager *manager; ///< Handles network communication
-    const QString baseUrl = "https://api.gios.gov.pl/pjp-api/rest"; ///< GIOS API base URL
+    QNetworkAccessManager *manager; ///< Shared by all clients of the thread
+    const QString baseUrl;          ///< GIOS API base URL
+    TransportStats m_stats;
+    bool m_http2Allowed = true;
+
+    /**
+     * @brief Builds a request with the transport settings and counts its reply.
+     * @param path Path below the base URL, e.g. "/station/findAll".
+     * @param priority Network priority of the request.
+     * @return QNetworkReply* Reply of the GET request.
+     */
+    QNetworkReply *get(const QString &path, QNetworkRequest::Priority priority = QNetworkRequest::NormalPriority);
+
+    /**
+     * @brief Reads and decodes a successful reply's body and archives it if archiving is enabled.
+     * @param reply Finished reply created by get().
+     * @return QByteArray Decoded body; empty if its encoding is damaged.
+     * @see ResponseArchive
+     */
+    QByteArray readBody(QNetworkReply *reply);
 
     /**
      * @brief Processes raw station data into simplified format
@@ -95,9 +160,12 @@ private:
      * @brief Handles network response and error processing
      * @param reply Network reply object
      * @param successHandler Callback function for successful responses
+     * @param rawHandler Optional callback tried on the body first; returns
+     * false to have the body parsed and passed to successHandler
      */
     void handleResponse(QNetworkReply *reply,
-                        std::function<void(const QJsonDocument&)> successHandler);
+                        std::function<void(const QJsonDocument&)> successHandler,
+                        std::function<bool(const QByteArray&)> rawHandler = nullptr);
 };
 
 #endif // APICLIENT_H
@@ -0,0 +1,170 @@
+/**
+ * @file archiveanalytics.cpp
+ * @brief Implementation of the parallel store aggregation.
+ */
+
+#include "archiveanalytics.h"
+#include "db.h"
+#include "storesnapshot.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+namespace {
+/**
+ * @brief Files of one location and parameter, in precedence order.
+ */
+struct WorkUnit {
+    QString location;
+    QString key;
+    QStringList files;
+};
+
+/**
+ * @brief Lists the work units matching a filter.
+ * @details Only file names from one store snapshot are read; ranges outside
+ * the filter are skipped.
+ */
+QVector<WorkUnit> listUnits(const QString &root, const ExportQuery &filter)
+{
+    QVector<WorkUnit> units;
+    const StoreSnapshot snapshot = StoreSnapshot::capture(root);
+    for (const QString &location : snapshot.locations()) {
+        if (!filter.location.isEmpty() && !location.contains(filter.location, Qt::CaseInsensitive))
+            continue;
+
+        QMap<QString, QStringList> byKey;
+        for (const QString &fileName : snapshot.files(location)) {
+            QString key;
+            qint32 from = 0, to = 0;
+            if (!db::parseSeriesFileName(fileName, &key, &from, &to))
+                continue;
+            if (!filter.parameter.isEmpty() && key != filter.parameter)
+                continue;
+            if ((filter.from != 0 && to < filter.from) || (filter.to != 0 && from > filter.to))
+                continue;
+            byKey[key].append(fileName);
+        }
+
+        for (auto k = byKey.cbegin(); k != byKey.cend(); ++k)
+            units.append({ location, k.key(), db::sortSeriesFiles(k.value(), k.key()) });
+    }
+    return units;
+}
+}
+
+/**
+ * @brief Implementation of AnalyticsGroup::merge().
+ */
+void AnalyticsGroup::merge(const AnalyticsGroup &other)
+{
+    if (other.count == 0)
+        return;
+    min = count > 0 ? qMin(min, other.min) : other.min;
+    max = count > 0 ? qMax(max, other.max) : other.max;
+    count += other.count;
+    sum += other.sum;
+    exceedances += other.exceedances;
+}
+
+/**
+ * @brief Implementation of run().
+ */
+QVector<AnalyticsGroup> ArchiveAnalytics::run(const AnalyticsQuery &query)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QVector<WorkUnit> units = listUnits(db::getAppDataPath() + "/db", query.filter);
+    const qint32 rangeFrom = query.filter.from != 0 ? qint32(query.filter.from) : std::numeric_limits<qint32>::min();
+    const qint32 rangeTo = query.filter.to != 0 ? qint32(query.filter.to) : std::numeric_limits<qint32>::max();
+
+    QThreadPool pool;
+    if (query.threads > 0)
+        pool.setMaxThreadCount(query.threads);
+    const int workers = qMax(1, qMin(pool.maxThreadCount(), int(units.size())));
+
+    QVector<QHash<QString, AnalyticsGroup>> partials(workers);
+    std::atomic_int nextUnit{0};
+    std::atomic<qint64> points{0};
+
+    for (int w = 0; w < workers; ++w) {
+        pool.start([&, w]() {
+            QHash<QString, AnalyticsGroup> &groups = partials[w];
+            qint64 seen = 0;
+
+            for (int u = nextUnit++; u < units.size(); u = nextUnit++) {
+                const WorkUnit &unit = units[u];
+                AnalyticsGroup &group = groups[query.groupBy == AnalyticsQuery::ByLocation ? unit.location : unit.key];
+
+                // Overlapping files give one point per timestamp, as in db::loadSeries()
+                const SensorSeries series = db::loadSeriesFiles(unit.location, unit.files);
+                const int begin = series.lowerBound(rangeFrom);
+                const int end = series.upperBound(rangeTo);
+
+                const ColumnSpan<float> values = series.values();
+                for (int i = begin; i < end; ++i) {
+                    if (!series.isUsable(i)) // Missing or flagged by QualityDetector
+                        continue;
+                    const float value = values[i];
+                    group.min = group.count > 0 ? qMin(group.min, value) : value;
+                    group.max = group.count > 0 ? qMax(group.max, value) : value;
+                    group.count++;
+                    group.sum += value;
+                    if (query.hasThreshold && value > query.threshold)
+                        group.exceedances++;
+                }
+                seen += qMax(0, end - begin);
+            }
+            points += seen;
+        });
+    }
+    pool.waitForDone();
+
+    // Reduce
+    QHash<QString, AnalyticsGroup> merged;
+    for (const QHash<QString, AnalyticsGroup> &partial : std::as_const(partials)) {
+        for (auto it = partial.cbegin(); it != partial.cend(); ++it) {
+            AnalyticsGroup &group = merged[it.key()];
+            group.name = it.key();
+            group.merge(it.value());
+        }
+    }
+
+    QVector<AnalyticsGroup> result;
+    result.reserve(merged.size());
+    for (const AnalyticsGroup &group : std::as_const(merged)) {
+        if (group.count > 0)
+            result.append(group);
+    }
+
+    auto metric = [&query](const AnalyticsGroup &group) -> double {
+        switch (query.order) {
+        case AnalyticsQuery::ByMax: return group.max;
+        case AnalyticsQuery::ByCount: return double(group.count);
+        case AnalyticsQuery::ByExceedances: return double(group.exceedances);
+        case AnalyticsQuery::ByMean: break;
+        }
+        return group.mean();
+    };
+    auto before = [&metric](const AnalyticsGroup &a, const AnalyticsGroup &b) {
+        const double ma = metric(a), mb = metric(b);
+        return ma != mb ? ma > mb : a.name < b.name;
+    };
+
+    if (query.topK > 0 && query.topK < result.size()) {
+        std::partial_sort(result.begin(), result.begin() + query.topK, result.end(), before);
+        result.resize(query.topK);
+    } else {
+        std::sort(result.begin(), result.end(), before);
+    }
+
+    const double seconds = qMax<qint64>(1, timer.elapsed()) / 1000.0;
+    qDebug() << "Analytics:" << units.size() << "series," << points.load() << "points," << workers << "workers,"
+             << qRound64(points.load() / seconds) << "points/s";
+    return result;
+}
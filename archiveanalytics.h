@@ -0,0 +1,87 @@
+/**
+ * @file archiveanalytics.h
+ * @brief Parallel aggregation over the whole local store.
+ */
+
+#ifndef ARCHIVEANALYTICS_H
+#define ARCHIVEANALYTICS_H
+
+#include <QString>
+#include <QVector>
+#include "seriesexporter.h"
+
+/**
+ * @brief Aggregation request over stored data.
+ */
+struct AnalyticsQuery {
+    /**
+     * @brief Grouping of the results.
+     */
+    enum GroupBy {
+        ByLocation,  ///< One group per store location
+        ByParameter, ///< One group per parameter key
+    };
+
+    /**
+     * @brief Ranking used by topK.
+     */
+    enum Order {
+        ByMean,
+        ByMax,
+        ByCount,
+        ByExceedances,
+    };
+
+    ExportQuery filter;           ///< Same semantics as for exports
+    GroupBy groupBy = ByLocation;
+    double threshold = 0;         ///< Values above it count as exceedances
+    bool hasThreshold = false;    ///< Whether exceedances are counted
+    Order order = ByMean;         ///< Descending
+    int topK = 0;                 ///< Number of groups to return (0 for all)
+    int threads = 0;              ///< Worker count (0 for one per core)
+};
+
+/**
+ * @brief Aggregate of one group.
+ */
+struct AnalyticsGroup {
+    QString name;
+    qint64 count = 0;       ///< Valid points without quality flags
+    double sum = 0;
+    float min = 0;
+    float max = 0;
+    qint64 exceedances = 0; ///< Valid points above the threshold
+
+    double mean() const { return count > 0 ? sum / count : 0; }
+
+    /**
+     * @brief Adds another partial aggregate of the same group.
+     */
+    void merge(const AnalyticsGroup &other);
+};
+
+/**
+ * @class ArchiveAnalytics
+ * @brief Map-reduce over stored series on a thread pool.
+ *
+ * The store is split into work units of one location and parameter, which
+ * covers all saved windows of one sensor. Workers claim units through an
+ * atomic counter, merge the unit's files by store precedence (see
+ * db::loadSeriesFiles(); points repeated in overlapping windows are counted
+ * once, with the value the store reads back) and aggregate into a private
+ * table.
+ * Only when all units are done are the per-worker tables merged, so workers
+ * share nothing but the counter and scale with the number of cores until
+ * the disk becomes the limit.
+ */
+class ArchiveAnalytics
+{
+public:
+    /**
+     * @brief Runs a query; blocks until all workers are done.
+     * @return QVector<AnalyticsGroup> Groups in descending order of query.order.
+     */
+    static QVector<AnalyticsGroup> run(const AnalyticsQuery &query);
+};
+
+#endif // ARCHIVEANALYTICS_H
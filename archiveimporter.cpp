@@ -0,0 +1,375 @@
+/**
+ * @file archiveimporter.cpp
+ * @brief Implementation of the GIOS archive importer.
+ */
+
+#include "archiveimporter.h"
+#include "db.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+
+namespace {
+/**
+ * @brief Splits a CSV line, honouring double-quoted fields.
+ */
+QVector<QByteArray> splitFields(const QByteArray &line, char separator)
+{
+    QVector<QByteArray> fields;
+    QByteArray field;
+    bool quoted = false;
+
+    for (int i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (c == '"') {
+            if (quoted && i + 1 < line.size() && line[i + 1] == '"') {
+                field += '"';
+                ++i;
+            } else {
+                quoted = !quoted;
+            }
+        } else if (c == separator && !quoted) {
+            fields.append(field.trimmed());
+            field.clear();
+        } else if (c != '\r' && c != '\n') {
+            field += c;
+        }
+    }
+    fields.append(field.trimmed());
+    return fields;
+}
+
+/**
+ * @brief Parses the timestamp column of an archive row.
+ * @return qint32 Epoch seconds, or 0 if the field is not a date.
+ */
+qint32 parseTimestamp(const QByteArray &field)
+{
+    static const char *const formats[] = { "yyyy-MM-dd HH:mm:ss", "yyyy-MM-dd HH:mm", "dd.MM.yyyy HH:mm" };
+
+    const QString text = QString::fromLatin1(field);
+    for (const char *format : formats) {
+        QDateTime time = QDateTime::fromString(text, format);
+        if (time.isValid())
+            return qint32(time.toSecsSinceEpoch());
+    }
+    return 0;
+}
+}
+
+/**
+ * @brief Stores the paths; nothing is read until run().
+ */
+ArchiveImporter::ArchiveImporter(const QString &filePath, const QString &stationCodesPath, QObject *parent)
+    : QObject(parent)
+    , m_filePath(filePath)
+    , m_stationCodesPath(stationCodesPath)
+{
+}
+
+/**
+ * @brief Implementation of run().
+ */
+void ArchiveImporter::run()
+{
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit finished(false, "Could not open file: " + m_filePath);
+        return;
+    }
+    m_totalBytes = file.size();
+
+    // Header rows run until the first line that starts with a timestamp
+    QVector<QByteArray> headerRows;
+    QByteArray line;
+    qint64 dataStart = 0;
+    bool haveDataLine = false;
+    while (!file.atEnd()) {
+        dataStart = file.pos();
+        line = file.readLine();
+        if (line.trimmed().isEmpty())
+            continue;
+        if (headerRows.isEmpty())
+            m_separator = line.count(';') > line.count(',') ? ';' : ',';
+        if (parseTimestamp(splitFields(line, m_separator).value(0)) != 0) {
+            haveDataLine = true;
+            break;
+        }
+        headerRows.append(line);
+        if (headerRows.size() > 32) {
+            emit finished(false, "No data rows found in " + m_filePath);
+            return;
+        }
+    }
+
+    if (!haveDataLine || !parseHeader(headerRows)) {
+        emit finished(false, "Unrecognized archive layout in " + m_filePath);
+        return;
+    }
+
+    // Resume after the last checkpoint if the file has not changed
+    const qint64 checkpoint = loadCheckpoint();
+    if (checkpoint >= m_totalBytes) {
+        emit finished(true, "Already imported: " + m_filePath);
+        return;
+    }
+    if (checkpoint > dataStart) {
+        file.seek(checkpoint);
+        haveDataLine = false;
+        qDebug() << "Resuming import at byte" << checkpoint;
+    }
+    m_committedOffset = qMax(checkpoint, dataStart);
+
+    m_timer.start();
+    m_inFlight.release(2 * m_pool.maxThreadCount());
+
+    int chunkIndex = 0;
+    Chunk chunk{ chunkIndex, 0, {} };
+    chunk.lines.reserve(kChunkRows);
+
+    auto submit = [this, &chunk, &chunkIndex, &file]() {
+        chunk.endOffset = file.pos();
+        m_inFlight.acquire(); // Back-pressure: wait for a free slot
+        m_pool.start([this, chunk]() { processChunk(chunk); });
+        chunk = Chunk{ ++chunkIndex, 0, {} };
+        chunk.lines.reserve(kChunkRows);
+    };
+
+    if (haveDataLine)
+        chunk.lines.append(line);
+
+    while (!file.atEnd() && !m_cancelled) {
+        chunk.lines.append(file.readLine());
+        if (chunk.lines.size() >= kChunkRows)
+            submit();
+    }
+    if (!chunk.lines.isEmpty() && !m_cancelled)
+        submit();
+
+    m_pool.waitForDone();
+
+    const double seconds = qMax<qint64>(1, m_timer.elapsed()) / 1000.0;
+    if (m_cancelled) {
+        emit finished(false, QString("Import cancelled after %1 rows; it will resume from the last checkpoint")
+                                 .arg(m_rows));
+        return;
+    }
+
+    saveCheckpoint(m_totalBytes);
+    emit finished(true, QString("Imported %1 rows of %2 in %3 s (%4 rows/s)")
+                            .arg(m_rows).arg(m_parameter)
+                            .arg(seconds, 0, 'f', 1)
+                            .arg(m_rows / seconds, 0, 'f', 0));
+}
+
+/**
+ * @brief Loads the station code to store location mapping.
+ * @details Codes come from the "station_code" field of the cached station list
+ * and from the optional "code;id" file, whose IDs are resolved via the cache.
+ */
+QHash<QString, QString> ArchiveImporter::loadStationCodes() const
+{
+    QHash<QString, QString> codes;
+    QHash<int, QString> names;
+
+    QFile cache(db::getAppDataPath() + "/citySearchData.json");
+    if (cache.open(QIODevice::ReadOnly)) {
+        const QJsonArray stations = QJsonDocument::fromJson(cache.readAll()).array();
+        for (const QJsonValue &value : stations) {
+            const QJsonObject station = value.toObject();
+            const QString name = db::stationDisplayName(station);
+            names.insert(station["id"].toInt(), name);
+            const QString code = station["station_code"].toString();
+            if (!code.isEmpty())
+                codes.insert(code, name);
+        }
+    }
+
+    if (!m_stationCodesPath.isEmpty()) {
+        QFile mapping(m_stationCodesPath);
+        if (!mapping.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "Could not open station code file:" << m_stationCodesPath;
+            return codes;
+        }
+        while (!mapping.atEnd()) {
+            const QByteArray row = mapping.readLine();
+            const QVector<QByteArray> fields = splitFields(row, row.contains(';') ? ';' : ',');
+            bool ok = false;
+            const int id = fields.value(1).toInt(&ok);
+            if (ok && names.contains(id))
+                codes.insert(QString::fromUtf8(fields[0]), names.value(id));
+        }
+    }
+
+    return codes;
+}
+
+/**
+ * @brief Reads station codes and the parameter from the header rows.
+ * @return bool False if no column could be mapped to a known station.
+ */
+bool ArchiveImporter::parseHeader(const QVector<QByteArray> &headerRows)
+{
+    QVector<QByteArray> stationCodes;
+    QVector<QByteArray> positionCodes;
+
+    for (const QByteArray &row : headerRows) {
+        const QVector<QByteArray> fields = splitFields(row, m_separator);
+        const QByteArray label = fields.value(0);
+        if (label.startsWith("Kod stacji"))
+            stationCodes = fields.mid(1);
+        else if (label.startsWith("Kod stanowiska"))
+            positionCodes = fields.mid(1);
+        else if (label.startsWith("Wska") && m_parameter.isEmpty()) // "Wskaźnik", any encoding
+            m_parameter = QString::fromUtf8(fields.value(1));
+    }
+
+    // Position codes look like "DsBialka-PM10-1g"
+    if (stationCodes.isEmpty()) {
+        for (const QByteArray &code : positionCodes)
+            stationCodes.append(code.split('-').value(0));
+    }
+    if (m_parameter.isEmpty() && !positionCodes.isEmpty())
+        m_parameter = QString::fromUtf8(positionCodes.first().split('-').value(1));
+
+    if (stationCodes.isEmpty() || m_parameter.isEmpty())
+        return false;
+
+    const QHash<QString, QString> codes = loadStationCodes();
+    int mapped = 0;
+    m_columnLocations.clear();
+    for (const QByteArray &code : stationCodes) {
+        const QString location = codes.value(QString::fromUtf8(code));
+        if (location.isEmpty())
+            qWarning() << "Unknown station code, column skipped:" << code;
+        else
+            mapped++;
+        m_columnLocations.append(SensorSeries::intern(location));
+    }
+
+    qDebug() << "Importing" << m_parameter << "for" << mapped << "of" << stationCodes.size() << "stations";
+    return mapped > 0;
+}
+
+/**
+ * @brief Parses one chunk and stores one series per mapped station column.
+ * @details Runs on a pool thread. Empty cells are skipped rather than
+ * stored as invalid points.
+ */
+void ArchiveImporter::processChunk(const Chunk &chunk)
+{
+    const int columns = m_columnLocations.size();
+    QVector<SensorSeries> series(columns);
+    qint64 rows = 0;
+
+    for (const QByteArray &line : chunk.lines) {
+        const QVector<QByteArray> fields = splitFields(line, m_separator);
+        const qint32 time = parseTimestamp(fields.value(0));
+        if (time == 0)
+            continue;
+        rows++;
+
+        for (int column = 0; column < columns && column + 1 < fields.size(); ++column) {
+            if (m_columnLocations[column].isEmpty())
+                continue;
+
+            QByteArray cell = fields[column + 1];
+            if (cell.isEmpty())
+                continue;
+            if (m_separator == ';')
+                cell.replace(',', '.');
+
+            bool ok = false;
+            const double value = cell.toDouble(&ok);
+            SensorSeries &target = series[column];
+            if (ok && (target.isEmpty() || time > target.lastTimestamp()))
+                target.append(time, float(value));
+        }
+    }
+
+    QVector<SensorSeries> batch;
+    for (int column = 0; column < columns; ++column) {
+        if (series[column].isEmpty())
+            continue;
+        series[column].setKey(m_parameter);
+        series[column].setLocation(m_columnLocations[column]);
+        batch.append(series[column]);
+    }
+    db::saveSensorDataBatch(batch);
+
+    chunkDone(chunk, rows);
+}
+
+/**
+ * @brief Records a stored chunk and advances the checkpoint.
+ * @details Chunks finish out of order; the checkpoint only moves past a
+ * chunk once every earlier chunk is stored as well.
+ */
+void ArchiveImporter::chunkDone(const Chunk &chunk, qint64 rows)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_completed.insert(chunk.index, chunk.endOffset);
+        m_rows += rows;
+
+        bool advanced = false;
+        while (m_completed.contains(m_nextToCommit)) {
+            m_committedOffset = m_completed.take(m_nextToCommit);
+            m_nextToCommit++;
+            advanced = true;
+        }
+        if (advanced)
+            saveCheckpoint(m_committedOffset);
+
+        const double seconds = qMax<qint64>(1, m_timer.elapsed()) / 1000.0;
+        emit progress(m_committedOffset, m_totalBytes, m_rows, m_rows / seconds);
+    }
+    m_inFlight.release();
+}
+
+/**
+ * @brief Path of the checkpoint file for the imported file.
+ */
+QString ArchiveImporter::progressPath() const
+{
+    const QByteArray hash = QCryptographicHash::hash(QFileInfo(m_filePath).absoluteFilePath().toUtf8(),
+                                                     QCryptographicHash::Md5).toHex();
+    return db::getAppDataPath() + "/import/" + QString::fromLatin1(hash) + ".json";
+}
+
+/**
+ * @brief Loads the stored offset if the file is unchanged since it was written.
+ * @return qint64 Offset to resume from, 0 to start over.
+ */
+qint64 ArchiveImporter::loadCheckpoint() const
+{
+    QFile file(progressPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    const QJsonObject state = QJsonDocument::fromJson(file.readAll()).object();
+    const QFileInfo info(m_filePath);
+    if (state["size"].toInteger() != info.size()
+        || state["modified"].toInteger() != info.lastModified().toMSecsSinceEpoch())
+        return 0;
+    return state["offset"].toInteger();
+}
+
+/**
+ * @brief Writes the checkpoint file.
+ * @param offset Byte offset up to which every row is stored.
+ */
+void ArchiveImporter::saveCheckpoint(qint64 offset) const
+{
+    const QFileInfo info(m_filePath);
+    QJsonObject state;
+    state["path"] = info.absoluteFilePath();
+    state["size"] = info.size();
+    state["modified"] = info.lastModified().toMSecsSinceEpoch();
+    state["offset"] = offset;
+
+    QDir().mkpath(db::getAppDataPath() + "/import");
+    QFile file(progressPath());
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        file.write(QJsonDocument(state).toJson(QJsonDocument::Compact));
+}
@@ -0,0 +1,124 @@
+/**
+ * @file archiveimporter.h
+ * @brief Parallel importer for GIOS historical archive CSV files.
+ */
+
+#ifndef ARCHIVEIMPORTER_H
+#define ARCHIVEIMPORTER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+
+/**
+ * @class ArchiveImporter
+ * @brief Streams a GIOS yearly archive file into the local store.
+ *
+ * GIOS publishes one file per parameter and year in "wide" layout: a few
+ * header rows ("Kod stacji", "Wskaźnik", "Czas uśredniania", ...) followed by
+ * one row per timestamp with one column per station. Spreadsheets must be
+ * saved as CSV first; both ',' and ';' separators and decimal commas are
+ * accepted.
+ *
+ * The calling thread reads lines and hands chunks of rows to a thread pool,
+ * where they are parsed and written through db::saveSensorDataBatch(), one
+ * durable commit per chunk. At most
+ * two chunks per thread are in flight, so a slow disk throttles the reader
+ * instead of growing memory. After every chunk the contiguous byte offset
+ * that is fully stored is checkpointed, and a later run on the same,
+ * unchanged file resumes from there.
+ *
+ * Station codes are resolved through the "station_code" field of the station
+ * cache and, optionally, a "code;id" mapping file.
+ */
+class ArchiveImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs an importer.
+     * @param filePath Archive CSV to import.
+     * @param stationCodesPath Optional "code;id" CSV extending the station cache.
+     * @param parent Parent QObject (optional).
+     */
+    explicit ArchiveImporter(const QString &filePath, const QString &stationCodesPath = QString(),
+                             QObject *parent = nullptr);
+
+public slots:
+    /**
+     * @brief Performs the import; blocks until all chunks are stored.
+     */
+    void run();
+
+    /**
+     * @brief Stops reading new chunks; safe from any thread.
+     */
+    void cancel() { m_cancelled = true; }
+
+signals:
+    /**
+     * @brief Emitted after each stored chunk.
+     * @param bytesDone Bytes of the file stored so far.
+     * @param bytesTotal File size.
+     * @param rows Data rows stored so far (this run).
+     * @param rowsPerSecond Throughput of this run.
+     */
+    void progress(qint64 bytesDone, qint64 bytesTotal, qint64 rows, double rowsPerSecond);
+
+    /**
+     * @brief Emitted when the import ends.
+     * @param ok False on error or cancellation.
+     * @param message Summary or error description.
+     */
+    void finished(bool ok, const QString &message);
+
+private:
+    /**
+     * @brief Consecutive data rows handed to one worker.
+     */
+    struct Chunk {
+        int index;
+        qint64 endOffset; ///< File offset just after the chunk's last line
+        QVector<QByteArray> lines;
+    };
+
+    QString m_filePath;
+    QString m_stationCodesPath;
+    std::atomic_bool m_cancelled{false};
+
+    // Header information shared read-only by the workers
+    char m_separator = ',';
+    QString m_parameter;
+    QVector<QString> m_columnLocations; ///< Store location per station column, empty if unmapped
+
+    QThreadPool m_pool;
+    QSemaphore m_inFlight;
+
+    // Checkpoint state, guarded by m_mutex
+    QMutex m_mutex;
+    QMap<int, qint64> m_completed; ///< Finished chunks not yet contiguous
+    int m_nextToCommit = 0;
+    qint64 m_committedOffset = 0;
+    qint64 m_rows = 0;
+    qint64 m_totalBytes = 0;
+    QElapsedTimer m_timer;
+
+    QHash<QString, QString> loadStationCodes() const;
+    bool parseHeader(const QVector<QByteArray> &headerRows);
+    void processChunk(const Chunk &chunk);
+    void chunkDone(const Chunk &chunk, qint64 rows);
+    QString progressPath() const;
+    qint64 loadCheckpoint() const;
+    void saveCheckpoint(qint64 offset) const;
+
+    static const int kChunkRows = 2048; ///< Data rows per chunk
+};
+
+#endif // ARCHIVEIMPORTER_H
@@ -0,0 +1,252 @@
+/**
+ * @file archivemodel.cpp
+ * @brief Implementation of the archive item model and its filter proxy.
+ */
+
+#include "archivemodel.h"
+#include "db.h"
+#include <QDir>
+
+/**
+ * @brief Constructs the model; rows are created when the view asks for them.
+ */
+ArchiveModel::ArchiveModel(const QString &rootPath, QObject *parent)
+    : QAbstractItemModel(parent)
+    , m_rootPath(rootPath)
+    , m_snapshot(StoreSnapshot::capture(rootPath))
+    , m_pendingLocations(m_snapshot.locations())
+{
+}
+
+ArchiveModel::~ArchiveModel() = default;
+
+/**
+ * @brief Resolves the location node of a location row.
+ * @details Location rows carry internal ID 0; series rows carry their
+ * location's row + 1.
+ */
+ArchiveModel::LocationNode *ArchiveModel::locationFor(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.internalId() != 0)
+        return nullptr;
+    return m_locations[size_t(index.row())].get();
+}
+
+QModelIndex ArchiveModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent))
+        return QModelIndex();
+    if (!parent.isValid())
+        return createIndex(row, column, quintptr(0));
+    return createIndex(row, column, quintptr(parent.row() + 1));
+}
+
+QModelIndex ArchiveModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid() || child.internalId() == 0)
+        return QModelIndex();
+    return createIndex(int(child.internalId() - 1), 0, quintptr(0));
+}
+
+int ArchiveModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return int(m_locations.size());
+    if (parent.column() != 0)
+        return 0;
+    LocationNode *node = locationFor(parent);
+    return node ? int(node->files.size()) : 0;
+}
+
+int ArchiveModel::columnCount(const QModelIndex &) const
+{
+    return ColumnCount;
+}
+
+bool ArchiveModel::hasChildren(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return true;
+    LocationNode *node = locationFor(parent);
+    return node && parent.column() == 0 && (node->nextPending < node->pending.size() || !node->files.empty());
+}
+
+/**
+ * @brief Reports whether a level still has unlisted snapshot entries.
+ */
+bool ArchiveModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return m_nextLocation < m_pendingLocations.size();
+    LocationNode *node = locationFor(parent);
+    return node && node->nextPending < node->pending.size();
+}
+
+/**
+ * @brief Lists the next batch of locations or files from the snapshot.
+ * @details Takes at most kBatchSize entries, then inserts them in one
+ * beginInsertRows()/endInsertRows() pair.
+ */
+void ArchiveModel::fetchMore(const QModelIndex &parent)
+{
+    if (!parent.isValid()) {
+        std::vector<std::unique_ptr<LocationNode>> batch;
+        while (int(batch.size()) < kBatchSize && m_nextLocation < m_pendingLocations.size()) {
+            auto node = std::make_unique<LocationNode>();
+            node->name = m_pendingLocations[m_nextLocation++];
+            node->pending = m_snapshot.files(node->name);
+            batch.push_back(std::move(node));
+        }
+        if (batch.empty())
+            return;
+
+        const int first = int(m_locations.size());
+        beginInsertRows(QModelIndex(), first, first + int(batch.size()) - 1);
+        for (auto &node : batch)
+            m_locations.push_back(std::move(node));
+        endInsertRows();
+        return;
+    }
+
+    LocationNode *node = locationFor(parent);
+    if (!node)
+        return;
+
+    std::vector<FileEntry> batch;
+    while (int(batch.size()) < kBatchSize && node->nextPending < node->pending.size()) {
+        FileEntry entry;
+        entry.fileName = node->pending[node->nextPending++];
+        if (db::parseSeriesFileName(entry.fileName, &entry.key, &entry.from, &entry.to))
+            batch.push_back(std::move(entry));
+    }
+    if (node->nextPending >= node->pending.size()) {
+        node->pending.clear();
+        node->nextPending = 0;
+    }
+    if (batch.empty())
+        return;
+
+    const int first = int(node->files.size());
+    beginInsertRows(parent, first, first + int(batch.size()) - 1);
+    for (FileEntry &entry : batch)
+        node->files.push_back(std::move(entry));
+    m_loadedFiles += int(batch.size());
+    endInsertRows();
+}
+
+QVariant ArchiveModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    if (index.internalId() == 0) {
+        const LocationNode *node = m_locations[size_t(index.row())].get();
+        switch (role) {
+        case Qt::DisplayRole:
+            return index.column() == NameColumn ? QVariant(node->name) : QVariant();
+        case LocationRole:
+            return node->name;
+        case IsFileRole:
+            return false;
+        default:
+            return QVariant();
+        }
+    }
+
+    const LocationNode *node = m_locations[size_t(index.internalId() - 1)].get();
+    const FileEntry &entry = node->files[size_t(index.row())];
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case NameColumn: return entry.key;
+        case FromColumn: return QDateTime::fromSecsSinceEpoch(entry.from);
+        case ToColumn: return QDateTime::fromSecsSinceEpoch(entry.to);
+        default: return QVariant();
+        }
+    case Qt::ToolTipRole:
+    case FileNameRole:
+        return entry.fileName;
+    case LocationRole:
+        return node->name;
+    case KeyRole:
+        return entry.key;
+    case FromRole:
+        return entry.from;
+    case ToRole:
+        return entry.to;
+    case IsFileRole:
+        return true;
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ArchiveModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case NameColumn: return QStringLiteral("Location / Parameter");
+    case FromColumn: return QStringLiteral("From");
+    case ToColumn: return QStringLiteral("To");
+    default: return QVariant();
+    }
+}
+
+/**
+ * @brief Constructs a proxy that accepts everything until filters are set.
+ */
+ArchiveFilterProxy::ArchiveFilterProxy(QObject *parent)
+    : QSortFilterProxyModel(parent)
+{
+}
+
+void ArchiveFilterProxy::setLocationFilter(const QString &text)
+{
+    m_location = text;
+    invalidateFilter();
+}
+
+void ArchiveFilterProxy::setParameterFilter(const QString &key)
+{
+    m_parameter = key;
+    invalidateFilter();
+}
+
+void ArchiveFilterProxy::setTimeRange(const QDateTime &from, const QDateTime &to)
+{
+    m_from = from.isValid() ? from.toSecsSinceEpoch() : 0;
+    m_to = to.isValid() ? to.toSecsSinceEpoch() : 0;
+    invalidateFilter();
+}
+
+/**
+ * @brief Implementation of acceptedFileCount().
+ * @details Only counts rows that have been fetched so far.
+ */
+int ArchiveFilterProxy::acceptedFileCount() const
+{
+    int count = 0;
+    const int locations = rowCount();
+    for (int row = 0; row < locations; ++row)
+        count += rowCount(index(row, 0));
+    return count;
+}
+
+bool ArchiveFilterProxy::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    const QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+
+    if (!sourceParent.isValid())
+        return m_location.isEmpty()
+               || index.data(ArchiveModel::LocationRole).toString().contains(m_location, Qt::CaseInsensitive);
+
+    if (!m_parameter.isEmpty() && index.data(ArchiveModel::KeyRole).toString() != m_parameter)
+        return false;
+    if (m_from != 0 && index.data(ArchiveModel::ToRole).toLongLong() < m_from)
+        return false;
+    if (m_to != 0 && index.data(ArchiveModel::FromRole).toLongLong() > m_to)
+        return false;
+    return true;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file archivemodel.h
+ * @brief Lazily populated item model over the saved sensor archive.
+ */
+
+#ifndef ARCHIVEMODEL_H
+#define ARCHIVEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QDateTime>
+#include <QSortFilterProxyModel>
+#include <memory>
+#include <vector>
+#include "storesnapshot.h"
+
+/**
+ * @class ArchiveModel
+ * @brief Two-level tree of locations and their saved series files.
+ *
+ * Top-level rows are location directories, child rows are series files.
+ * Both levels are added in batches through canFetchMore()/fetchMore(),
+ * so only rows the view has scrolled to are ever created, and a listed file
+ * costs a few dozen bytes instead of a widget.
+ *
+ * Rows come from one StoreSnapshot taken at construction, so a collector
+ * writing at the same time neither changes the listing under the view nor
+ * exposes files that are still being written.
+ */
+class ArchiveModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Columns exposed by the model.
+     */
+    enum Column {
+        NameColumn = 0, ///< Location name or parameter key
+        FromColumn,     ///< Oldest measurement in the file
+        ToColumn,       ///< Newest measurement in the file
+        ColumnCount
+    };
+
+    /**
+     * @brief Custom data roles.
+     */
+    enum Role {
+        FileNameRole = Qt::UserRole + 1, ///< File name of a series row
+        LocationRole,                    ///< Location of the row
+        KeyRole,                         ///< Parameter key of a series row
+        FromRole,                        ///< Oldest timestamp, epoch seconds
+        ToRole,                          ///< Newest timestamp, epoch seconds
+        IsFileRole                       ///< True for series rows
+    };
+
+    /**
+     * @brief Constructs a model over a snapshot of a store.
+     * @param rootPath Directory containing one subdirectory per location.
+     * @param parent Parent QObject (optional).
+     */
+    explicit ArchiveModel(const QString &rootPath, QObject *parent = nullptr);
+    ~ArchiveModel() override;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    /**
+     * @brief Number of series rows listed so far across all locations.
+     */
+    int loadedFileCount() const { return m_loadedFiles; }
+
+private:
+    /**
+     * @brief Compact description of one saved series file.
+     */
+    struct FileEntry {
+        QString fileName;
+        QString key; ///< Interned parameter key
+        qint32 from; ///< Oldest measurement, epoch seconds
+        qint32 to;   ///< Newest measurement, epoch seconds
+    };
+
+    /**
+     * @brief Location directory and the files listed from it so far.
+     */
+    struct LocationNode {
+        QString name;
+        QStringList pending; ///< Snapshot file names not yet listed
+        int nextPending = 0;
+        std::vector<FileEntry> files;
+    };
+
+    QString m_rootPath;
+    StoreSnapshot m_snapshot;
+    QStringList m_pendingLocations; ///< Snapshot locations
+    int m_nextLocation = 0;         ///< First location not yet listed
+    std::vector<std::unique_ptr<LocationNode>> m_locations;
+    int m_loadedFiles = 0;
+
+    static const int kBatchSize = 256; ///< Rows read per fetchMore() call
+
+    LocationNode *locationFor(const QModelIndex &index) const;
+};
+
+/**
+ * @class ArchiveFilterProxy
+ * @brief Filters archive rows by location text, parameter and time range.
+ *
+ * Location rows pass when their name contains the location text; series rows
+ * pass when their key matches and their time range overlaps the selected one.
+ */
+class ArchiveFilterProxy : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit ArchiveFilterProxy(QObject *parent = nullptr);
+
+    /**
+     * @brief Sets the substring location names must contain (empty for all).
+     */
+    void setLocationFilter(const QString &text);
+
+    /**
+     * @brief Sets the parameter key series must have (empty for all).
+     */
+    void setParameterFilter(const QString &key);
+
+    /**
+     * @brief Restricts series to those overlapping a time range.
+     * @param from Range start; invalid for no lower bound.
+     * @param to Range end; invalid for no upper bound.
+     */
+    void setTimeRange(const QDateTime &from, const QDateTime &to);
+
+    /**
+     * @brief Number of series rows currently passing the filter.
+     */
+    int acceptedFileCount() const;
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    QString m_location;
+    QString m_parameter;
+    qint64 m_from = 0;
+    qint64 m_to = 0;
+};
+
+#endif // ARCHIVEMODEL_H
@@ -0,0 +1,992 @@
+/**
+ * @file commandline.cpp
+ * @brief Implementation of the headless commands.
+ */
+
+#include "commandline.h"
+#include "allocstats.h"
+#include "seriesexporter.h"
+#include "archiveanalytics.h"
+#include "airqualityindex.h"
+#include "apiclient.h"
+#include "archiveimporter.h"
+#include "metadatacatalog.h"
+#include "pollscheduler.h"
+#include "queryservice.h"
+#include "responsearchive.h"
+#include "startupprofile.h"
+#include "storereplicator.h"
+#include "storesnapshot.h"
+#include "db.h"
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QMap>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+/**
+ * @brief Options that switch the application into headless mode.
+ */
+const char *const kCommands[] = { "--export", "--import", "--collect", "--nearby", "--box", "--bench-stations", "--stats",
+                                  "--stress-store", "--aqi",
+                                  "--bench-http", "--sensors", "--sync-catalog", "--serve", "--load-test",
+                                  "--replicate", "--replica-manifest", "--make-bundle", "--apply-bundle",
+                                  "--archive-stats", "--replay", "--startup-bench",
+                                  "--bench-decode" };
+
+/**
+ * @brief Parses an ISO date or date-time argument into epoch seconds.
+ * @return qint64 0 if the text is empty or invalid.
+ */
+qint64 parseTime(const QString &text)
+{
+    if (text.isEmpty())
+        return 0;
+    QDateTime time = QDateTime::fromString(text, Qt::ISODate);
+    return time.isValid() ? time.toSecsSinceEpoch() : 0;
+}
+
+/**
+ * @brief Exports stored data selected by the filter options.
+ */
+int runExport(const QCommandLineParser &parser, const QString &path)
+{
+    QTextStream err(stderr);
+
+    ExportQuery query;
+    query.location = parser.value("location");
+    query.parameter = parser.value("parameter");
+    query.from = parseTime(parser.value("from"));
+    query.to = parseTime(parser.value("to"));
+
+    SeriesExporter exporter(query, SeriesExporter::formatForPath(path), path);
+    QObject::connect(&exporter, &SeriesExporter::progress, [&err](int done, int total) {
+        if (done == total || done % 100 == 0)
+            err << "\r" << done << "/" << total << " files" << Qt::flush;
+    });
+
+    bool success = false;
+    QObject::connect(&exporter, &SeriesExporter::finished, [&](bool ok, const QString &message) {
+        err << "\n" << message << Qt::endl;
+        success = ok;
+    });
+
+    exporter.run();
+    return success ? 0 : 1;
+}
+
+/**
+ * @brief Prints aggregates of stored data selected by the filter options.
+ */
+int runStats(const QCommandLineParser &parser)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    AnalyticsQuery query;
+    query.filter.location = parser.value("location");
+    query.filter.parameter = parser.value("parameter");
+    query.filter.from = parseTime(parser.value("from"));
+    query.filter.to = parseTime(parser.value("to"));
+    query.topK = parser.value("top").toInt();
+    query.threads = parser.value("threads").toInt();
+
+    const QString groupBy = parser.value("group-by");
+    if (groupBy == "parameter") {
+        query.groupBy = AnalyticsQuery::ByParameter;
+    } else if (!groupBy.isEmpty() && groupBy != "location") {
+        err << "--group-by expects location or parameter" << Qt::endl;
+        return 1;
+    }
+
+    if (parser.isSet("above")) {
+        bool ok = false;
+        query.threshold = parser.value("above").toDouble(&ok);
+        if (!ok) {
+            err << "--above expects a number" << Qt::endl;
+            return 1;
+        }
+        query.hasThreshold = true;
+        query.order = AnalyticsQuery::ByExceedances;
+    }
+
+    const QString order = parser.value("order");
+    if (order == "mean") query.order = AnalyticsQuery::ByMean;
+    else if (order == "max") query.order = AnalyticsQuery::ByMax;
+    else if (order == "count") query.order = AnalyticsQuery::ByCount;
+    else if (order == "exceedances") query.order = AnalyticsQuery::ByExceedances;
+    else if (!order.isEmpty()) {
+        err << "--order expects mean, max, count or exceedances" << Qt::endl;
+        return 1;
+    }
+
+    out << "group\tcount\tmean\tmin\tmax" << (query.hasThreshold ? "\texceedances\n" : "\n");
+    for (const AnalyticsGroup &group : ArchiveAnalytics::run(query)) {
+        out << group.name << '\t' << group.count << '\t' << QString::number(group.mean(), 'f', 2) << '\t'
+            << group.min << '\t' << group.max;
+        if (query.hasThreshold)
+            out << '\t' << group.exceedances;
+        out << '\n';
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints the newest air quality index of each stored location.
+ * @details --location narrows the locations as for the other commands.
+ */
+int runAirQualityIndex(const QCommandLineParser &parser)
+{
+    QTextStream out(stdout);
+
+    const QString filter = parser.value("location");
+    QStringList locations;
+    for (const QString &location : StoreSnapshot::capture().locations()) {
+        if (filter.isEmpty() || location.contains(filter, Qt::CaseInsensitive))
+            locations.append(location);
+    }
+    if (locations.isEmpty()) {
+        QTextStream(stderr) << "No stored locations match." << Qt::endl;
+        return 1;
+    }
+
+    out << "location\thour\tindex\tpollutant\n";
+    for (const AirQualityIndex::Series &series : AirQualityIndex::computeAll(locations, parser.value("threads").toInt())) {
+        const int latest = series.latest();
+        if (latest < 0) {
+            out << series.location << "\t-\t" << AirQualityIndex::categoryName(AirQualityIndex::NoIndex) << "\t-\n";
+            continue;
+        }
+        const qint64 hour = (series.firstHour + latest) * TilePyramid::kBaseSeconds;
+        out << series.location << '\t' << QDateTime::fromSecsSinceEpoch(hour).toString("yyyy-MM-dd HH:mm") << '\t'
+            << AirQualityIndex::categoryName(series.categories[latest]) << '\t'
+            << AirQualityIndex::key(AirQualityIndex::Pollutant(series.dominant[latest])) << '\n';
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses a comma-separated list of numbers.
+ * @return QVector<double> Empty if any element is not a number.
+ */
+QVector<double> parseNumbers(const QString &text)
+{
+    QVector<double> numbers;
+    for (const QString &part : text.split(',')) {
+        bool ok = false;
+        numbers.append(part.trimmed().toDouble(&ok));
+        if (!ok)
+            return {};
+    }
+    return numbers;
+}
+
+/**
+ * @brief Lists stations near a point or inside a box, using the station cache.
+ */
+int runStationQuery(const QCommandLineParser &parser)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    db::loadCityData(db::getAppDataPath() + "/citySearchData.json");
+    if (db::geoIndex.isEmpty()) {
+        err << "Station cache has no coordinates; start the application once to refresh it." << Qt::endl;
+        return 1;
+    }
+
+    if (parser.isSet("nearby")) {
+        const QVector<double> point = parseNumbers(parser.value("nearby"));
+        if (point.size() != 2) {
+            err << "--nearby expects <lat,lon>" << Qt::endl;
+            return 1;
+        }
+        const int count = parser.isSet("count") ? parser.value("count").toInt() : 10;
+        for (const GeoIndex::Hit &hit : db::geoIndex.nearest(point[0], point[1], count)) {
+            out << db::stations.id(hit.station) << '\t' << QString::number(hit.distanceKm, 'f', 2) << " km\t"
+                << db::stations.displayName(hit.station) << '\n';
+        }
+        return 0;
+    }
+
+    const QVector<double> box = parseNumbers(parser.value("box"));
+    if (box.size() != 4) {
+        err << "--box expects <minLat,minLon,maxLat,maxLon>" << Qt::endl;
+        return 1;
+    }
+    for (int row : db::geoIndex.withinBox(box[0], box[1], box[2], box[3]))
+        out << db::stations.id(row) << '\t' << db::stations.displayName(row) << '\n';
+    return 0;
+}
+
+/**
+ * @brief Compares station name lookups in the station table with a map keyed by display name.
+ * @details The map mirrors the former db::idMap. Its size is estimated from
+ * the node layout of std::map (three pointers and a colour word, then the
+ * key and value), since Qt 6 QMap is built on it.
+ */
+int runStationBenchmark()
+{
+    QTextStream out(stdout);
+
+    const QStringList names = db::loadCityData(db::getAppDataPath() + "/citySearchData.json");
+    if (names.isEmpty()) {
+        QTextStream(stderr) << "Station cache is empty; start the application once to fill it." << Qt::endl;
+        return 1;
+    }
+
+    QMap<QString, int> map;
+    qsizetype mapBytes = 0;
+    for (int row = 0; row < db::stations.size(); ++row) {
+        const QString name = db::stations.displayName(row);
+        map.insert(name, db::stations.id(row));
+        mapBytes += qsizetype(4 * sizeof(void *) + sizeof(QString) + sizeof(void *))
+                    + name.capacity() * qsizetype(sizeof(QChar));
+    }
+
+    const int kRounds = 200;
+    QElapsedTimer timer;
+    qint64 checksum = 0;
+
+    timer.start();
+    for (int round = 0; round < kRounds; ++round) {
+        for (const QString &name : names)
+            checksum += map.value(name);
+    }
+    const qint64 mapNs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int round = 0; round < kRounds; ++round) {
+        for (const QString &name : names)
+            checksum -= db::stations.id(db::stations.rowForName(name));
+    }
+    const qint64 tableNs = timer.nsecsElapsed();
+
+    const double lookups = double(kRounds) * names.size();
+    out << names.size() << " stations, " << lookups << " lookups per structure\n"
+        << "map:   " << mapBytes << " bytes, " << QString::number(mapNs / lookups, 'f', 1) << " ns/lookup\n"
+        << "table: " << db::stations.memoryUsage() << " bytes, "
+        << QString::number(tableNs / lookups, 'f', 1) << " ns/lookup\n";
+    if (checksum != 0)
+        out << "Lookups disagree; the cache has duplicate display names\n";
+    return 0;
+}
+
+/**
+ * @brief Saves series in a loop while reader threads check store snapshots.
+ * @details Runs on the Qt test-mode store so the user's data is untouched.
+ * Each process writes its own parameter key, so several processes started
+ * at the same time also check each other's commits. A torn read is a file
+ * listed in a snapshot that does not load, or a snapshot older than one
+ * the same reader saw before.
+ */
+int runStoreStress(int seconds)
+{
+    QTextStream out(stdout);
+    const QString root = db::getAppDataPath() + "/db";
+    const QString location = "Stress test";
+    const QString key = "S" + QString::number(QCoreApplication::applicationPid());
+    const int kReaders = qMax(2, QThreadPool::globalInstance()->maxThreadCount() - 1);
+
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 deadline = qint64(seconds) * 1000;
+    std::atomic<int> commits{0};
+    std::atomic<qint64> reads{0};
+    std::atomic<int> torn{0};
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(kReaders + 1);
+    pool.start([&] {
+        const qint32 base = qint32(QDateTime::currentSecsSinceEpoch() / 3600 * 3600);
+        while (timer.elapsed() < deadline) {
+            SensorSeries series;
+            series.setLocation(location);
+            series.setKey(key);
+            const qint32 start = base + commits.load() * 24 * 3600;
+            for (int hour = 0; hour < 24; ++hour)
+                series.append(start + hour * 3600, float(hour), true);
+            db::saveSensorData(series);
+            ++commits;
+        }
+    });
+    for (int reader = 0; reader < kReaders; ++reader) {
+        pool.start([&] {
+            qint64 lastVersion = -1;
+            while (timer.elapsed() < deadline) {
+                const StoreSnapshot snapshot = StoreSnapshot::capture(root);
+                if (snapshot.version() < lastVersion)
+                    ++torn;
+                lastVersion = snapshot.version();
+                for (const QString &fileName : snapshot.files(location)) {
+                    if (db::loadSensorData(root + "/" + location + "/" + fileName, location).isEmpty()) {
+                        QTextStream(stderr) << "Torn read: " << fileName << Qt::endl;
+                        ++torn;
+                    }
+                    ++reads;
+                }
+            }
+        });
+    }
+    pool.waitForDone();
+
+    const int files = StoreSnapshot::capture(root).files(location).size();
+    out << commits.load() << " commits, " << reads.load() << " file reads by " << kReaders << " readers, "
+        << files << " files in the stress location, " << torn.load() << " torn reads\n";
+    return torn.load() == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Times a station list download followed by a burst of sensor list requests.
+ * @details Both variants wait a second before the first request, so a
+ * preconnect has the same head start the application gets at startup.
+ * Point WEATHERAPP_API_BASE at a local stand-in server for repeatable
+ * numbers.
+ */
+int runHttpBenchmark(QCoreApplication &app, const QCommandLineParser &parser)
+{
+    QTextStream out(stdout);
+    const int count = qMax(1, parser.value("bench-http").toInt());
+
+    ApiClient client;
+    client.setHttp2Allowed(!parser.isSet("http1"));
+    if (!parser.isSet("no-preconnect"))
+        client.preconnect();
+
+    QElapsedTimer timer;
+    qint64 listMs = 0;
+    int pending = 0;
+    int failures = 0;
+    bool listed = false;
+
+    QObject::connect(&client, &ApiClient::allStationsProcessed, [&](const QJsonArray &stations) {
+        listed = true;
+        listMs = timer.elapsed();
+        pending = qMin(count, int(stations.size()));
+        if (pending == 0)
+            app.exit(1);
+        for (int i = 0; i < pending; ++i)
+            client.getStationDetails(stations[i].toObject()["id"].toInt());
+    });
+    auto finishOne = [&]() {
+        if (--pending == 0)
+            app.exit(0);
+    };
+    QObject::connect(&client, &ApiClient::stationDetailsReceived, finishOne);
+    QObject::connect(&client, &ApiClient::errorOccurred, [&](const QString &error) {
+        QTextStream(stderr) << error << Qt::endl;
+        failures++;
+        if (!listed)
+            app.exit(1);
+        else
+            finishOne();
+    });
+
+    QTimer::singleShot(1000, [&]() {
+        timer.start();
+        client.getAllStations();
+    });
+    const int result = app.exec();
+
+    const ApiClient::TransportStats stats = client.transportStats();
+    out << "station list: " << listMs << " ms, " << count << " sensor lists: " << timer.elapsed() - listMs << " ms\n"
+        << stats.requests << " requests, " << failures << " failed, " << stats.http2 << " over HTTP/2, "
+        << stats.compressed << " compressed\n"
+        << stats.wireBytes << " bytes transferred, " << stats.payloadBytes << " bytes decoded\n"
+        << stats.handshakes << " TLS handshakes (preconnect "
+        << (parser.isSet("no-preconnect") ? "off" : "on, not counted") << ")\n";
+    return result;
+}
+
+/**
+ * @brief Lists the sensors of a parameter in the whole network from the local catalog.
+ */
+int runSensorQuery(const QString &paramCode)
+{
+    QTextStream out(stdout);
+    db::loadCityData(db::getAppDataPath() + "/citySearchData.json");
+
+    MetadataCatalog catalog;
+    if (catalog.stationCount() == 0) {
+        QTextStream(stderr) << "The sensor catalog is empty; run --sync-catalog first." << Qt::endl;
+        return 1;
+    }
+
+    const QVector<MetadataCatalog::Sensor> sensors = catalog.sensorsForParameter(paramCode);
+    for (const MetadataCatalog::Sensor &sensor : sensors) {
+        const int row = db::stations.rowForId(sensor.stationId);
+        out << sensor.id << '\t' << sensor.stationId << '\t'
+            << (row >= 0 ? db::stations.displayName(row) : QString()) << '\n';
+    }
+    out << sensors.size() << " " << paramCode << " sensors at " << catalog.stationCount() << " catalogued stations\n";
+    return 0;
+}
+
+/**
+ * @brief Refreshes the sensor catalog for every station in the station cache.
+ */
+int runCatalogSync(QCoreApplication &app)
+{
+    QTextStream err(stderr);
+    db::loadCityData(db::getAppDataPath() + "/citySearchData.json");
+
+    QList<int> ids;
+    for (int id : db::stations.ids()) {
+        if (id != 0)
+            ids.append(id);
+    }
+    if (ids.isEmpty()) {
+        err << "Station cache is empty; start the application once to fill it." << Qt::endl;
+        return 1;
+    }
+
+    MetadataCatalog catalog;
+    QObject::connect(&catalog, &MetadataCatalog::syncProgress, [&err](int done, int total) {
+        err << "\r" << done << "/" << total << " stations" << Qt::flush;
+    });
+    QObject::connect(&catalog, &MetadataCatalog::syncFinished, [&](int changed) {
+        err << "\n" << changed << " stations changed" << Qt::endl;
+        app.quit();
+    });
+    catalog.sync(ids, true);
+    return app.exec();
+}
+
+/**
+ * @brief Serves the store to local tools until the process is stopped.
+ */
+int runQueryService(QCoreApplication &app, int port)
+{
+    QueryService service;
+    if (!service.start(quint16(port)))
+        return 1;
+    QTextStream(stderr) << "Serving the store on http://127.0.0.1:" << service.serverPort() << Qt::endl;
+    return app.exec();
+}
+
+/**
+ * @brief Sends one GET request and reads the response on a keep-alive connection.
+ * @return int Status code, or 0 if the connection failed.
+ */
+int fetch(QTcpSocket &socket, const QByteArray &target)
+{
+    socket.write("GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    int status = 0;
+    qint64 length = -1;
+    for (;;) {
+        while (!socket.canReadLine()) {
+            if (!socket.waitForReadyRead(QueryService::kIdleTimeoutMs))
+                return 0;
+        }
+        const QByteArray line = socket.readLine().trimmed();
+        if (line.isEmpty())
+            break;
+        if (status == 0)
+            status = line.split(' ').value(1).toInt();
+        else if (line.toLower().startsWith("content-length:"))
+            length = line.mid(15).trimmed().toLongLong();
+    }
+    if (length < 0)
+        return 0; // Only used for endpoints with a Content-Length
+    while (socket.bytesAvailable() < length) {
+        if (!socket.waitForReadyRead(QueryService::kIdleTimeoutMs))
+            return 0;
+    }
+    socket.read(length);
+    return status;
+}
+
+/**
+ * @brief Measures sustained throughput and latency of the query service.
+ * @details Runs the service in this process on a free port and one client
+ * per core, each sending a mix of latest-value and aggregate queries over
+ * one keep-alive connection for the given time. The first request of each
+ * target fills the cache, so the numbers describe repeated queries.
+ */
+int runLoadTest(QCoreApplication &app, int seconds)
+{
+    QTextStream out(stdout);
+    QueryService service;
+    if (!service.start(0))
+        return 1;
+    const quint16 port = service.serverPort();
+    const QList<QByteArray> targets = {
+        "/latest", "/latest?parameter=PM10", "/latest?parameter=PM2.5",
+        "/aggregate?group-by=parameter", "/aggregate?group-by=location&above=50",
+    };
+
+    const int kClients = QThread::idealThreadCount();
+    QVector<QVector<qint64>> latencies(kClients); // Nanoseconds, one vector per client
+    std::atomic<int> failures{0};
+    std::atomic<int> running{kClients};
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 deadline = qint64(seconds) * 1000;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(kClients);
+    for (int client = 0; client < kClients; ++client) {
+        pool.start([&, client] {
+            QTcpSocket socket;
+            socket.connectToHost(QHostAddress::LocalHost, port);
+            if (socket.waitForConnected(QueryService::kIdleTimeoutMs)) {
+                QElapsedTimer request;
+                for (int i = client; timer.elapsed() < deadline; ++i) {
+                    request.start();
+                    if (fetch(socket, targets[i % targets.size()]) != 200) {
+                        ++failures;
+                        break;
+                    }
+                    latencies[client].append(request.nsecsElapsed());
+                }
+            } else {
+                ++failures;
+            }
+            --running;
+        });
+    }
+
+    // The service accepts connections on this thread's event loop
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, [&] {
+        if (running.load() == 0)
+            app.quit();
+    });
+    poll.start(50);
+    app.exec();
+    pool.waitForDone();
+    const double elapsed = timer.elapsed() / 1000.0;
+
+    QVector<qint64> all;
+    for (const QVector<qint64> &client : std::as_const(latencies))
+        all += client;
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) {
+        return all.isEmpty() ? 0.0 : all[qMin(all.size() - 1, int(all.size() * p))] / 1e6;
+    };
+
+    const QueryService::Stats stats = service.stats();
+    out << all.size() << " requests by " << kClients << " clients in " << QString::number(elapsed, 'f', 1) << " s: "
+        << qRound64(all.size() / elapsed) << " QPS, p50 " << QString::number(percentile(0.5), 'f', 3)
+        << " ms, p99 " << QString::number(percentile(0.99), 'f', 3) << " ms, "
+        << stats.cacheHits << " cache hits, " << failures.load() << " failures\n";
+    return failures.load() == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Runs one replication step between stores.
+ * @details --store selects the local store (default: the application
+ * store). --replicate does a full round from another store directory into
+ * the local one and reports what it cost; the other commands split the
+ * round for stores on different machines: the receiver writes its hash
+ * list, the sender makes a bundle against it, the receiver applies it.
+ */
+int runReplication(const QCommandLineParser &parser)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    StoreReplicator local(parser.value("store"));
+
+    auto readFile = [&err](const QString &path, QByteArray *data) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            err << "Could not read " << path << Qt::endl;
+            return false;
+        }
+        *data = file.readAll();
+        return true;
+    };
+    auto report = [&](const StoreReplicator::ApplyResult &result) {
+        if (!result.ok) {
+            err << result.error << Qt::endl;
+            return 1;
+        }
+        out << result.added << " files added, " << result.merged << " merged, " << result.absorbed
+            << " without new points, " << result.known << " already present\n";
+        return 0;
+    };
+
+    if (parser.isSet("replicate")) {
+        QElapsedTimer timer;
+        timer.start();
+        StoreReplicator source(parser.value("replicate"));
+        QByteArray bundle;
+        QBuffer buffer(&bundle);
+        buffer.open(QIODevice::WriteOnly);
+        const int files = source.createBundle(StoreReplicator::parseManifest(local.manifest()), &buffer);
+        if (files < 0) {
+            err << "Could not create the bundle" << Qt::endl;
+            return 1;
+        }
+        out << files << " files in a " << bundle.size() << " byte bundle\n";
+        const int status = report(local.applyBundle(bundle));
+        out << "Replicated in " << timer.elapsed() << " ms\n";
+        return status;
+    }
+
+    if (parser.isSet("replica-manifest")) {
+        QSaveFile file(parser.value("replica-manifest"));
+        const QByteArray data = local.manifest();
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+            err << "Could not write " << file.fileName() << Qt::endl;
+            return 1;
+        }
+        out << (data.size() - 12) / StoreReplicator::kHashBytes << " hashes written\n";
+        return 0;
+    }
+
+    if (parser.isSet("make-bundle")) {
+        QSet<QByteArray> peer;
+        if (parser.isSet("peer-manifest")) {
+            QByteArray data;
+            bool ok = false;
+            if (!readFile(parser.value("peer-manifest"), &data))
+                return 1;
+            peer = StoreReplicator::parseManifest(data, &ok);
+            if (!ok) {
+                err << "Not a replication manifest: " << parser.value("peer-manifest") << Qt::endl;
+                return 1;
+            }
+        }
+        QSaveFile file(parser.value("make-bundle"));
+        const int files = file.open(QIODevice::WriteOnly) ? local.createBundle(peer, &file) : -1;
+        if (files < 0 || !file.commit()) {
+            err << "Could not write " << file.fileName() << Qt::endl;
+            return 1;
+        }
+        out << files << " files in a " << QFileInfo(file.fileName()).size() << " byte bundle\n";
+        return 0;
+    }
+
+    QByteArray bundle;
+    if (!readFile(parser.value("apply-bundle"), &bundle))
+        return 1;
+    return report(local.applyBundle(bundle));
+}
+
+/**
+ * @brief Prints the size of the raw response archive.
+ */
+int runArchiveStats()
+{
+    ResponseArchive archive(db::getAppDataPath() + "/raw");
+    const ResponseArchive::Stats stats = archive.stats();
+    QTextStream(stdout) << stats.responses << " responses, " << stats.objects << " distinct bodies, "
+                        << stats.rawBytes << " bytes in " << stats.storedBytes << " stored bytes ("
+                        << QString::number(stats.storedBytes > 0 ? double(stats.rawBytes) / stats.storedBytes : 0, 'f', 1)
+                        << "x)\n";
+    return 0;
+}
+
+/**
+ * @brief Parses archived sensor responses again and stores the series.
+ * @details --from and --to select by receive time; --no-store only
+ * parses, to measure the parser alone.
+ */
+int runReplay(const QCommandLineParser &parser)
+{
+    db::loadCityData(db::getAppDataPath() + "/citySearchData.json");
+    ResponseArchive archive(db::getAppDataPath() + "/raw");
+
+    ResponseArchive::ReplayOptions options;
+    options.fromMs = parseTime(parser.value("from")) * 1000;
+    options.toMs = parseTime(parser.value("to")) * 1000;
+    options.threads = parser.value("threads").toInt();
+    options.store = !parser.isSet("no-store");
+
+    const ResponseArchive::ReplayResult result = archive.replay(options);
+    const double seconds = qMax<qint64>(1, result.elapsedMs) / 1000.0;
+    QTextStream(stdout) << result.responses << " responses, " << result.points << " points in "
+                        << result.elapsedMs << " ms: " << qRound64(result.responses / seconds) << " responses/s, "
+                        << QString::number(result.bytes / seconds / (1024 * 1024), 'f', 1) << " MB/s; "
+                        << result.unresolved << " without a known station, " << result.failed << " damaged\n";
+    return result.failed == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Times decoding and serializing one "getData" response both ways.
+ * @details Compares SensorSeries::fromResponse() with QJsonDocument plus
+ * fromJson(), and toJsonBytes() with QJsonDocument(toJson()). Allocations
+ * per response are counted in builds with WEATHERAPP_ALLOC_STATS (see
+ * AllocStats for what is covered); the first run of each variant is not
+ * counted, so the request arena is warm.
+ */
+int runDecodeBenchmark(const QString &path)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    const int kRuns = 1000;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        err << "Could not open " << path << "\n";
+        return 1;
+    }
+    const QByteArray body = file.readAll();
+    const QJsonDocument document = QJsonDocument::fromJson(body);
+    if (!document.isObject()) {
+        err << path << " is not a sensor data response\n";
+        return 1;
+    }
+    const SensorSeries parsed = SensorSeries::fromJson(document.object());
+    SensorSeries direct;
+    const bool readable = SensorSeries::fromResponse(body, 0, &direct);
+
+    bool same = readable && direct.size() == parsed.size() && direct.key() == parsed.key();
+    for (int i = 0; same && i < parsed.size(); ++i) {
+        same = direct.timestamp(i) == parsed.timestamp(i) && direct.isValid(i) == parsed.isValid(i)
+               && direct.value(i) == parsed.value(i);
+    }
+
+    auto measure = [&](const char *name, const std::function<void()> &work) {
+        work();
+        AllocStats::reset();
+        QElapsedTimer timer;
+        timer.start();
+        for (int run = 0; run < kRuns; ++run)
+            work();
+        const double microseconds = timer.nsecsElapsed() / 1000.0 / kRuns;
+        const AllocStats::Counts counts = AllocStats::total();
+        out << QString(name).leftJustified(24) << QString::number(microseconds, 'f', 1).rightJustified(9) << " us";
+        if (AllocStats::isEnabled())
+            out << QString::number(double(counts.allocations) / kRuns, 'f', 1).rightJustified(10) << " allocations"
+                << QString::number(counts.bytes / 1024.0 / kRuns, 'f', 1).rightJustified(9) << " KB";
+        out << "\n";
+    };
+
+    out << parsed.size() << " points, " << body.size() << " bytes; per response:\n";
+    measure("decode, document", [&]() { SensorSeries::fromJson(QJsonDocument::fromJson(body).object()); });
+    if (readable) {
+        measure("decode, direct", [&]() {
+            SensorSeries series;
+            SensorSeries::fromResponse(body, 0, &series);
+        });
+    }
+    measure("store text, document", [&]() { QJsonDocument(parsed.toJson()).toJson(QJsonDocument::Indented); });
+    measure("store text, direct", [&]() { parsed.toJsonBytes(); });
+    if (!AllocStats::isEnabled())
+        out << "Configure with -DWEATHERAPP_ALLOC_STATS=ON to count allocations.\n";
+    else if (!AllocStats::countsMalloc())
+        out << "Allocations count operator new only; Qt container buffers are missing (glibc builds count both).\n";
+
+    const bool sameText = parsed.toJsonBytes() == QJsonDocument(parsed.toJson()).toJson(QJsonDocument::Indented);
+    out << "Direct decode: " << (!readable ? "not supported for this file" : same ? "same points" : "DIFFERENT points")
+        << "; direct store text: " << (sameText ? "identical" : "differs (same points)") << "\n";
+    return !readable || same ? 0 : 1;
+}
+
+/**
+ * @brief Starts the application window <runs> times and reports its startup milestones.
+ * @details Each run is a new process with StartupProfile::kBenchmarkVariable
+ * set, so it quits as soon as startup is complete. Milestones are read from
+ * the "Startup:" lines of its log. Without a display, run with
+ * QT_QPA_PLATFORM=offscreen.
+ */
+int runStartupBenchmark(int runs)
+{
+    QTextStream out(stdout);
+    const int kTimeoutMs = 60000;
+    static const QRegularExpression milestoneLine("Startup: (\\S+) at (\\d+) ms");
+
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert(StartupProfile::kBenchmarkVariable, "1");
+
+    QStringList milestones; // In the order first reached
+    QHash<QString, QVector<qint64>> times;
+    QVector<qint64> exits;
+    for (int run = 1; run <= runs; ++run) {
+        QProcess process;
+        process.setProcessEnvironment(environment);
+        process.setProcessChannelMode(QProcess::MergedChannels);
+        QElapsedTimer timer;
+        timer.start();
+        process.start(QCoreApplication::applicationFilePath(), QStringList());
+        if (!process.waitForFinished(kTimeoutMs)) {
+            QTextStream(stderr) << "Run " << run << " did not complete startup within " << kTimeoutMs / 1000 << " s\n";
+            process.kill();
+            process.waitForFinished();
+            return 1;
+        }
+        exits.append(timer.elapsed());
+
+        QRegularExpressionMatchIterator it = milestoneLine.globalMatch(QString::fromLocal8Bit(process.readAll()));
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            if (!times.contains(match.captured(1)))
+                milestones.append(match.captured(1));
+            times[match.captured(1)].append(match.captured(2).toLongLong());
+        }
+    }
+
+    auto row = [&out, &exits](const QString &name, QVector<qint64> values) {
+        std::sort(values.begin(), values.end());
+        out << name.leftJustified(20) << QString::number(values[values.size() / 2]).rightJustified(8)
+            << QString::number(values.first()).rightJustified(8) << QString::number(values.last()).rightJustified(8)
+            << (values.size() < exits.size() ? QString("  (%1 runs)").arg(values.size()) : QString()) << "\n";
+    };
+    out << "Milestone             median     min     max  (ms since main(), " << runs << " runs)\n";
+    for (const QString &milestone : std::as_const(milestones))
+        row(milestone, times.value(milestone));
+    row("process exit", exits);
+    out << "Time to first paint: "
+        << (times.contains("first-paint") ? QString::number(times.value("first-paint").first()) : QString("-"))
+        << " ms (first run), time to searchable: "
+        << (times.contains("searchable") ? QString::number(times.value("searchable").first()) : QString("-"))
+        << " ms (first run)\n";
+    return times.value("ready").size() == runs ? 0 : 1;
+}
+
+/**
+ * @brief Imports a GIOS archive CSV file into the store.
+ */
+int runImport(const QCommandLineParser &parser, const QString &path)
+{
+    QTextStream err(stderr);
+
+    ArchiveImporter importer(path, parser.value("station-codes"));
+    QObject::connect(&importer, &ArchiveImporter::progress,
+                     [&err](qint64 bytesDone, qint64 bytesTotal, qint64 rows, double rowsPerSecond) {
+        err << "\r" << (bytesTotal > 0 ? bytesDone * 100 / bytesTotal : 100) << "% "
+            << rows << " rows, " << qRound64(rowsPerSecond) << " rows/s" << Qt::flush;
+    });
+
+    bool success = false;
+    QObject::connect(&importer, &ArchiveImporter::finished, [&](bool ok, const QString &message) {
+        err << "\n" << message << Qt::endl;
+        success = ok;
+    });
+
+    importer.run();
+    return success ? 0 : 1;
+}
+}
+
+/**
+ * @brief Implementation of isCommandLineInvocation().
+ */
+bool isCommandLineInvocation(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        for (const char *command : kCommands) {
+            if (std::strncmp(argv[i], command, std::strlen(command)) == 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Implementation of runCommandLine().
+ * @details Shared filter options (--location, --parameter, --from, --to) use
+ * the same semantics as the filters in the database browser window.
+ */
+int runCommandLine(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("GIOS air quality data tool");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "export", "Export stored data to <file> (.csv, .json, otherwise columnar).", "file" },
+        { "location", "Only locations containing <text>.", "text" },
+        { "parameter", "Only parameter <key>, e.g. PM10.", "key" },
+        { "from", "Only data at or after <time> (ISO 8601).", "time" },
+        { "to", "Only data at or before <time> (ISO 8601).", "time" },
+        { "import", "Import a GIOS archive CSV <file> into the store.", "file" },
+        { "station-codes", "Extra \"code;id\" station mapping for --import.", "file" },
+        { "collect", "Keep polling the watched sensors and storing new data." },
+        { "nearby", "List the stations nearest to <lat,lon>.", "lat,lon" },
+        { "count", "Number of stations for --nearby (default 10).", "n" },
+        { "box", "List the stations inside <minLat,minLon,maxLat,maxLon>.", "box" },
+        { "bench-stations", "Compare station lookups with the former name map." },
+        { "stats", "Print aggregates of stored data (uses the filter options)." },
+        { "group-by", "Group --stats by location (default) or parameter.", "field" },
+        { "above", "Count values above <limit> per group; orders by that count.", "limit" },
+        { "order", "Order --stats by mean (default), max, count or exceedances.", "metric" },
+        { "top", "Only the first <k> groups of --stats.", "k" },
+        { "threads", "Worker threads for --stats, --aqi and --replay (default: one per core).", "n" },
+        { "aqi", "Print the current air quality index of stored locations." },
+        { "sensors", "List all sensors of parameter <code> from the local catalog.", "code" },
+        { "sync-catalog", "Refresh the local catalog of station sensors." },
+        { "bench-http", "Time the station list and <n> sensor list requests.", "n" },
+        { "http1", "Do not allow HTTP/2 for --bench-http." },
+        { "no-preconnect", "Do not open the connection early for --bench-http." },
+        { "stress-store", "Write and read a scratch store concurrently for <seconds>.", "seconds" },
+        { "serve", "Serve stored data over HTTP on local <port>.", "port" },
+        { "load-test", "Measure query service throughput for <seconds>.", "seconds" },
+        { "store", "Store root for the replication commands (default: the application store).", "dir" },
+        { "replicate", "Copy what the store lacks from the store in <dir>.", "dir" },
+        { "replica-manifest", "Write the hashes of the store's files to <file>.", "file" },
+        { "make-bundle", "Write the files missing from --peer-manifest to <file>.", "file" },
+        { "peer-manifest", "Hash list of the receiving store for --make-bundle.", "file" },
+        { "apply-bundle", "Merge the files of bundle <file> into the store.", "file" },
+        { "archive-stats", "Print the size of the raw response archive." },
+        { "replay", "Parse archived sensor responses again and store them (uses --from, --to)." },
+        { "no-store", "Only parse for --replay, without saving." },
+        { "startup-bench", "Start the window <runs> times and report its startup milestones.", "runs" },
+        { "bench-decode", "Time decoding and storing the sensor data response in <file>.", "file" },
+    });
+    parser.process(app);
+
+    // The scratch store must be selected before the store is first opened
+    if (parser.isSet("stress-store"))
+        QStandardPaths::setTestModeEnabled(true);
+    db::recoverStore();
+
+    if (parser.isSet("export"))
+        return runExport(parser, parser.value("export"));
+    if (parser.isSet("import"))
+        return runImport(parser, parser.value("import"));
+    if (parser.isSet("nearby") || parser.isSet("box"))
+        return runStationQuery(parser);
+    if (parser.isSet("bench-stations"))
+        return runStationBenchmark();
+    if (parser.isSet("stats"))
+        return runStats(parser);
+    if (parser.isSet("sensors"))
+        return runSensorQuery(parser.value("sensors"));
+    if (parser.isSet("sync-catalog"))
+        return runCatalogSync(app);
+    if (parser.isSet("bench-http"))
+        return runHttpBenchmark(app, parser);
+    if (parser.isSet("aqi"))
+        return runAirQualityIndex(parser);
+    if (parser.isSet("stress-store"))
+        return runStoreStress(qMax(1, parser.value("stress-store").toInt()));
+    if (parser.isSet("serve"))
+        return runQueryService(app, parser.value("serve").toInt());
+    if (parser.isSet("load-test"))
+        return runLoadTest(app, qMax(1, parser.value("load-test").toInt()));
+    if (parser.isSet("replicate") || parser.isSet("replica-manifest") || parser.isSet("make-bundle")
+        || parser.isSet("apply-bundle"))
+        return runReplication(parser);
+    if (parser.isSet("archive-stats"))
+        return runArchiveStats();
+    if (parser.isSet("replay"))
+        return runReplay(parser);
+    if (parser.isSet("bench-decode"))
+        return runDecodeBenchmark(parser.value("bench-decode"));
+    if (parser.isSet("startup-bench"))
+        return runStartupBenchmark(qMax(1, parser.value("startup-bench").toInt()));
+    if (parser.isSet("collect")) {
+        PollScheduler scheduler;
+        QTextStream(stderr) << "Collecting " << scheduler.watchCount() << " watched sensors" << Qt::endl;
+        return app.exec();
+    }
+
+    parser.showHelp(1);
+}
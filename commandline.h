@@ -0,0 +1,28 @@
+/**
+ * @file commandline.h
+ * @brief Headless command-line entry points of the application.
+ */
+
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QCoreApplication>
+
+/**
+ * @brief Checks whether the arguments request a headless command.
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return bool True if no GUI should be created.
+ * @note Must be called before the application object exists, since the
+ * answer decides between QCoreApplication and QApplication.
+ */
+bool isCommandLineInvocation(int argc, char *argv[]);
+
+/**
+ * @brief Runs the requested headless command.
+ * @param app Application object (event loop available for async commands).
+ * @return int Process exit code.
+ */
+int runCommandLine(QCoreApplication &app);
+
+#endif // COMMANDLINE_H
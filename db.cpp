@@ -4,9 +4,236 @@
  */
 
 #include "db.h"
+#include "allocstats.h"
+#include "writeaheadlog.h"
+#include "qualitydetector.h"
+#include "storesnapshot.h"
+#include <QDateTime>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+#include <QtNumeric>
+#include <algorithm>
 
-// Initialize static member
-QMap<QString, int> db::idMap;
+// Initialize static members
+StationTable db::stations;
+GeoIndex db::geoIndex;
+
+namespace {
+/**
+ * @brief Path of a parameter's pyramid file, relative to the store root.
+ */
+QString pyramidPath(const QString &location, const QString &key)
+{
+    return location + "/" + key + ".pyr";
+}
+
+/**
+ * @brief Loads a pyramid file without validating it against the store.
+ * @return bool False if the file is missing, damaged or emptied to be rebuilt.
+ */
+bool readPyramid(const QString &location, const QString &key, TilePyramid *pyramid)
+{
+    QFile file(db::getAppDataPath() + "/db/" + pyramidPath(location, key));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    bool ok = false;
+    *pyramid = TilePyramid::fromBytes(file.readAll(), &ok);
+    return ok;
+}
+
+/**
+ * @brief Loads a pyramid as a commit in progress sees it.
+ */
+bool readPyramid(const WriteAheadLog::Transaction &transaction, const QString &location, const QString &key,
+                 TilePyramid *pyramid)
+{
+    QByteArray data;
+    if (!transaction.pending(pyramidPath(location, key), &data))
+        return readPyramid(location, key, pyramid);
+    bool ok = false;
+    *pyramid = TilePyramid::fromBytes(data, &ok);
+    return ok;
+}
+
+/**
+ * @brief Copies point i of source to the end of target, flags included.
+ */
+void appendPoint(SensorSeries *target, const SensorSeries &source, int i)
+{
+    target->append(source.timestamp(i), source.value(i), source.isValid(i));
+    if (source.flags(i) != 0)
+        target->setFlags(target->size() - 1, source.flags(i));
+}
+}
+
+/**
+ * @brief Implementation of mergeByPrecedence().
+ */
+SensorSeries db::mergeByPrecedence(const QVector<SensorSeries> &parts)
+{
+    struct Ref {
+        qint32 time;
+        int part;
+        int index;
+    };
+    QVector<Ref> refs;
+    SensorSeries merged;
+    bool flagged = false;
+    for (int p = 0; p < parts.size(); ++p) {
+        const SensorSeries &part = parts[p];
+        if (part.isEmpty())
+            continue;
+        merged.setLocation(part.location());
+        merged.setKey(part.key());
+        merged.setSensorId(part.sensorId());
+        flagged = flagged || part.hasFlags();
+        for (int i = 0; i < part.size(); ++i)
+            refs.append({ part.timestamp(i), p, i });
+    }
+
+    // Stable: equal timestamps stay in part order, so the last one wins
+    std::stable_sort(refs.begin(), refs.end(), [](const Ref &a, const Ref &b) { return a.time < b.time; });
+    merged.reserve(refs.size());
+    for (int r = 0; r < refs.size(); ++r) {
+        if (r + 1 < refs.size() && refs[r + 1].time == refs[r].time)
+            continue;
+        appendPoint(&merged, parts[refs[r].part], refs[r].index);
+    }
+
+    // Keep checked series checked, even when no point carries a flag
+    if (flagged && !merged.isEmpty() && !merged.hasFlags())
+        merged.setFlags(0, 0);
+    return merged;
+}
+
+namespace {
+
+/**
+ * @brief Loads a series file as a commit in progress sees it.
+ * @param transaction Commit being built.
+ * @param relativePath Path below the store root.
+ * @param location Location the file belongs to.
+ * @return SensorSeries The logged content if the file is not in place yet,
+ * otherwise the stored file; empty if there is neither.
+ */
+SensorSeries loadStored(const WriteAheadLog::Transaction &transaction, const QString &relativePath,
+                        const QString &location)
+{
+    QByteArray json;
+    if (!transaction.pending(relativePath, &json))
+        return db::loadSensorData(db::getAppDataPath() + "/db/" + relativePath, location);
+
+    const QJsonDocument doc = QJsonDocument::fromJson(json);
+    SensorSeries series = SensorSeries::fromJson(doc.object(), doc.object()["sensorId"].toInt());
+    series.setLocation(location);
+    return series;
+}
+
+/**
+ * @brief Series files of a location's parameter as a commit in progress sees them.
+ * @return QStringList File names in precedence order, pending new files included.
+ */
+QStringList storedFiles(const WriteAheadLog::Transaction &transaction, const QString &location, const QString &key)
+{
+    QStringList names = db::seriesFiles(location, key);
+    for (const QString &name : transaction.pendingFiles(location)) {
+        if (!names.contains(name))
+            names.append(name);
+    }
+    return db::sortSeriesFiles(names, key);
+}
+
+/**
+ * @brief Adds the records that store one series to a commit.
+ * @param transaction Commit being built.
+ * @param series Series with its quality flags set.
+ * @param created Receives the series if it starts a new file.
+ * @param merged Receives the merged series if it replaces a stored file.
+ * @details A series whose file already exists (the same range fetched
+ * again) is merged into it, its values replacing the stored ones. A stored
+ * file that does not parse (torn by a crash before the log existed) is
+ * replaced. Nothing is added if the file already holds the same points.
+ */
+void stageSeries(WriteAheadLog::Transaction &transaction, SensorSeries series,
+                 QVector<SensorSeries> *created, QVector<SensorSeries> *merged)
+{
+    const QString relativePath = db::seriesRelativePath(series);
+    QByteArray json = series.toJsonBytes();
+    if (transaction.pending(relativePath) || QFile::exists(db::getAppDataPath() + "/db/" + relativePath)) {
+        const SensorSeries stored = loadStored(transaction, relativePath, series.location());
+        if (!stored.isEmpty()) {
+            const QByteArray storedJson = stored.toJsonBytes();
+            series = db::mergeByPrecedence({ stored, series });
+            json = series.toJsonBytes();
+            if (json == storedJson) {
+                qDebug() << "File already up to date:" << relativePath;
+                return;
+            }
+            qDebug() << "Merging into existing file:" << relativePath;
+            merged->append(series);
+        } else {
+            qWarning() << "Replacing damaged file:" << relativePath;
+            created->append(series);
+        }
+    } else {
+        created->append(series);
+    }
+
+    transaction.write({ db::segmentPath(relativePath), series.toSegment() });
+    transaction.write({ relativePath, json });
+}
+
+/**
+ * @brief Folds stored points into the pyramids of their parameters.
+ * @param transaction Commit storing the points; the pyramids are written in it.
+ * @param seriesList Points as they are now stored.
+ * @param replacing True if the points may replace values stored before.
+ * @details Runs under the StoreLock like the rest of the commit, so two
+ * writers never fold into the same old pyramid. A missing pyramid is left
+ * to loadPyramid(), which rebuilds it from the files.
+ * @note A later insert replaces an hour's value, but a pyramid cannot drop
+ * one: where a replacing point is unusable, the pyramid file is emptied and
+ * rebuilt from the files on its next load.
+ */
+void foldIntoPyramids(WriteAheadLog::Transaction &transaction, const QVector<SensorSeries> &seriesList,
+                      bool replacing)
+{
+    QHash<QPair<QString, QString>, TilePyramid> pyramids;
+    QSet<QPair<QString, QString>> stale;
+    QSet<QPair<QString, QString>> missing;
+    for (const SensorSeries &series : seriesList) {
+        if (series.isEmpty())
+            continue;
+        const QPair<QString, QString> id(series.location(), series.key());
+        if (stale.contains(id) || missing.contains(id))
+            continue;
+        bool usable = true;
+        for (int i = 0; replacing && usable && i < series.size(); ++i)
+            usable = series.isUsable(i);
+        if (!usable) {
+            stale.insert(id);
+            pyramids.remove(id);
+            continue;
+        }
+
+        auto it = pyramids.find(id);
+        if (it == pyramids.end()) {
+            TilePyramid pyramid;
+            if (!readPyramid(transaction, id.first, id.second, &pyramid)) {
+                missing.insert(id);
+                continue;
+            }
+            it = pyramids.insert(id, pyramid);
+        }
+        it->insert(series);
+    }
+    for (auto it = pyramids.cbegin(); it != pyramids.cend(); ++it)
+        transaction.write({ pyramidPath(it.key().first, it.key().second), it.value().toBytes() });
+    for (const QPair<QString, QString> &id : std::as_const(stale))
+        transaction.write({ pyramidPath(id.first, id.second), QByteArray() });
+}
+}
 
 /**
  * @brief Implementation of getAppDataPath().
@@ -26,70 +253,379 @@ QString db::getAppDataPath() {
 }
 
 /**
- * @brief Implementation of saveSensorData().
- * @details Saves data with filename format: [key]_[firstTimestamp]_[lastTimestamp].json
- * @warning Skips saving if:
- *          - Values array is empty
- *          - File already exists
- *          - File cannot be opened
+ * @brief Implementation of recoverStore().
+ * @details Opening the write-ahead log replays or discards its leftover
+ * records. Series files from before segments existed then get theirs,
+ * written under the StoreLock like every other store write.
  */
-void db::saveSensorData(const QJsonObject &data, QString currentLocation) {
-    QString key = data["key"].toString();
-    QJsonArray values = data["values"].toArray();
+void db::recoverStore() {
+    WriteAheadLog::instance();
 
-    if (values.isEmpty()) {
-        qWarning() << "No values in JSON data.";
+    const QString root = getAppDataPath() + "/db";
+    StoreLock lock(root);
+    if (!lock.isLocked())
         return;
+    const StoreSnapshot snapshot = StoreSnapshot::capture(root);
+    int written = 0;
+    for (const QString &location : snapshot.locations()) {
+        for (const QString &fileName : snapshot.files(location)) {
+            const QString filePath = root + "/" + location + "/" + fileName;
+            if (QFile::exists(segmentPath(filePath)))
+                continue;
+            const SensorSeries series = loadSensorData(filePath, location);
+            if (series.isEmpty())
+                continue;
+            QSaveFile segment(segmentPath(filePath));
+            if (!segment.open(QIODevice::WriteOnly) || segment.write(series.toSegment()) < 0 || !segment.commit())
+                qWarning() << "Could not write segment:" << segment.fileName();
+            else
+                written++;
+        }
     }
+    if (written > 0)
+        qDebug() << "Wrote" << written << "missing segments";
+}
 
-    // Sanitize timestamps for filename
-    QString firstTimestamp = values.first().toObject()["date"].toString()
-                                 .replace(":", "").replace(" ", "_");
-    QString lastTimestamp = values.last().toObject()["date"].toString()
-                                .replace(":", "").replace(" ", "_");
+/**
+ * @brief Implementation of seriesRelativePath().
+ * @details Filename format: [key]_[newestTimestamp]_[oldestTimestamp].json
+ */
+QString db::seriesRelativePath(const SensorSeries &series) {
+    // Sanitize timestamps for filename (newest first, as in the API response)
+    const QString format = "yyyy-MM-dd_HHmmss";
+    QString firstTimestamp = QDateTime::fromSecsSinceEpoch(series.lastTimestamp()).toString(format);
+    QString lastTimestamp = QDateTime::fromSecsSinceEpoch(series.firstTimestamp()).toString(format);
 
-    // Ensure location directory exists
-    QString locationPath = getAppDataPath() + "/db/" + currentLocation;
-    QDir dir(locationPath);
-    if (!dir.exists()) {
-        dir.mkpath(".");
+    return QString("%1/%2_%3_%4.json").arg(series.location(), series.key(), firstTimestamp, lastTimestamp);
+}
+
+/**
+ * @brief Implementation of saveSensorData().
+ */
+void db::saveSensorData(const SensorSeries &series) {
+    saveSensorDataBatch({ series });
+}
+
+/**
+ * @brief Implementation of saveSensorDataBatch().
+ * @details All new files go through one WriteAheadLog::write() call.
+ * Series that were not checked on the way in (e.g. by the poll scheduler)
+ * are run through QualityDetector first, so every stored point carries its
+ * flags. Merging into existing files happens in the commit's build, under
+ * the StoreLock, so a concurrent writer's points are never overwritten by a
+ * merge with the file as it was before (see stageSeries()).
+ * @warning Skips a series if:
+ *          - Series is empty
+ *          - Its file already holds the same points
+ */
+void db::saveSensorDataBatch(const QVector<SensorSeries> &seriesList) {
+    AllocStats::Scope scope(AllocStats::Store);
+    QVector<SensorSeries> checked;
+    for (SensorSeries series : seriesList) {
+        if (series.isEmpty()) {
+            qWarning() << "No values in sensor data.";
+            continue;
+        }
+        if (!series.hasFlags())
+            QualityDetector::annotate(series);
+        checked.append(series);
     }
+    if (checked.isEmpty())
+        return;
 
-    QString fileName = QString("%1/%2_%3_%4.json")
-                           .arg(locationPath, key, firstTimestamp, lastTimestamp);
+    QVector<SensorSeries> created;
+    QVector<SensorSeries> merged;
+    const bool ok = WriteAheadLog::instance().write([&](WriteAheadLog::Transaction &transaction) {
+        for (const SensorSeries &series : std::as_const(checked))
+            stageSeries(transaction, series, &created, &merged);
+        foldIntoPyramids(transaction, created, false);
+        foldIntoPyramids(transaction, merged, true);
+    });
 
-    if (QFile::exists(fileName)) {
-        qWarning() << "File already exists:" << fileName;
+    const int files = created.size() + merged.size();
+    if (!ok) {
+        qWarning() << "Could not save" << files << "series";
         return;
     }
+    if (files > 0)
+        qDebug() << "JSON saved:" << files << "series";
+}
+
+/**
+ * @brief Implementation of reviseSensorData().
+ * @details Files are matched by the ranges in their names; a point that
+ * lies in several files goes to the one loadSeries() would take it from.
+ * Matching and merging happen in the commit's build, under the StoreLock,
+ * and points no file covers are staged in the same commit.
+ */
+void db::reviseSensorData(const QVector<SensorSeries> &revisions) {
+    AllocStats::Scope scope(AllocStats::Store);
+    QVector<SensorSeries> revised;
+    QVector<SensorSeries> created;
+    QVector<SensorSeries> merged;
+    int files = 0;
+
+    const bool ok = WriteAheadLog::instance().write([&](WriteAheadLog::Transaction &transaction) {
+        for (const SensorSeries &revision : revisions) {
+            if (revision.isEmpty())
+                continue;
 
-    QJsonDocument doc(data);
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Could not open file for writing:" << fileName;
+            const QString location = revision.location();
+            const QStringList names = storedFiles(transaction, location, revision.key());
+            QVector<qint32> from(names.size());
+            QVector<qint32> to(names.size());
+            for (int f = 0; f < names.size(); ++f) {
+                QString key;
+                parseSeriesFileName(names[f], &key, &from[f], &to[f]);
+            }
+
+            SensorSeries empty;
+            empty.setLocation(location);
+            empty.setKey(revision.key());
+            empty.setSensorId(revision.sensorId());
+            QVector<SensorSeries> parts(names.size(), empty);
+            SensorSeries rest = empty;
+            for (int i = 0; i < revision.size(); ++i) {
+                const qint32 time = revision.timestamp(i);
+                int f = names.size() - 1;
+                while (f >= 0 && (time < from[f] || time > to[f]))
+                    --f;
+                appendPoint(f >= 0 ? &parts[f] : &rest, revision, i);
+            }
+
+            for (int f = 0; f < names.size(); ++f) {
+                if (parts[f].isEmpty())
+                    continue;
+                // The stored series is released before the commit replaces its file
+                const QString relativePath = location + "/" + names[f];
+                const SensorSeries updated = mergeByPrecedence({ loadStored(transaction, relativePath, location), parts[f] });
+                transaction.write({ segmentPath(relativePath), updated.toSegment() });
+                transaction.write({ relativePath, updated.toJsonBytes() });
+                revised.append(parts[f]);
+                files++;
+            }
+            if (!rest.isEmpty()) {
+                if (!rest.hasFlags())
+                    QualityDetector::annotate(rest);
+                stageSeries(transaction, rest, &created, &merged);
+            }
+        }
+        foldIntoPyramids(transaction, revised, true);
+        foldIntoPyramids(transaction, created, false);
+        foldIntoPyramids(transaction, merged, true);
+    });
+
+    files += created.size() + merged.size();
+    if (!ok) {
+        qWarning() << "Could not revise" << files << "files";
         return;
     }
+    if (files > 0)
+        qDebug() << "Revised" << files << "files";
+}
+
+/**
+ * @brief Implementation of seriesFiles().
+ */
+QStringList db::seriesFiles(const QString &location, const QString &key) {
+    QDir dir(getAppDataPath() + "/db/" + location);
+    return sortSeriesFiles(dir.entryList(QStringList() << key + "_*.json", QDir::Files), key);
+}
+
+/**
+ * @brief Implementation of sortSeriesFiles().
+ */
+QStringList db::sortSeriesFiles(const QStringList &fileNames, const QString &key) {
+    struct Entry {
+        qint32 to;
+        qint32 from;
+        QString name;
+    };
+    QVector<Entry> entries;
+    for (const QString &fileName : fileNames) {
+        QString fileKey;
+        qint32 from, to;
+        if (parseSeriesFileName(fileName, &fileKey, &from, &to) && fileKey == key)
+            entries.append({ to, from, fileName });
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        if (a.to != b.to)
+            return a.to < b.to;
+        if (a.from != b.from)
+            return a.from < b.from;
+        return a.name < b.name;
+    });
+    QStringList files;
+    files.reserve(entries.size());
+    for (const Entry &entry : std::as_const(entries))
+        files.append(entry.name);
+    return files;
+}
+
+/**
+ * @brief Implementation of loadSeries().
+ */
+SensorSeries db::loadSeries(const QString &location, const QString &key) {
+    return loadSeriesFiles(location, seriesFiles(location, key));
+}
 
-    file.write(doc.toJson(QJsonDocument::Indented));
+/**
+ * @brief Implementation of loadSeriesFiles().
+ */
+SensorSeries db::loadSeriesFiles(const QString &location, const QStringList &files) {
+    const QString dirPath = getAppDataPath() + "/db/" + location + "/";
+    QVector<SensorSeries> parts;
+    parts.reserve(files.size());
+    for (const QString &fileName : files)
+        parts.append(loadSensorData(dirPath + fileName, location));
+    return mergeByPrecedence(parts);
+}
+
+/**
+ * @brief Implementation of loadSensorData().
+ * @details Maps the file's segment when there is one. Otherwise the JSON is
+ * parsed; the segment is left to the writer (see recoverStore()), since
+ * readers do not modify the store. Logs the in-memory size of the loaded
+ * series.
+ */
+SensorSeries db::loadSensorData(const QString &filePath, const QString &location) {
+    const QString seg = segmentPath(filePath);
+    SensorSeries series = SensorSeries::mapSegment(seg);
+    if (!series.isEmpty()) {
+        series.setLocation(location);
+        return series;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open file:" << filePath;
+        return SensorSeries();
+    }
+
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
     file.close();
-    qDebug() << "JSON saved to" << fileName;
+
+    if (!doc.isObject()) {
+        qWarning() << "Invalid JSON format.";
+        return SensorSeries();
+    }
+
+    QJsonObject data = doc.object();
+    series = SensorSeries::fromJson(data, data["sensorId"].toInt());
+    series.setLocation(location);
+    qDebug() << "Loaded" << series.size() << "points," << series.memoryUsage() << "bytes from" << filePath;
+    return series;
 }
 
 /**
- * @brief Implementation of loadCityData().
- * @details Expected JSON format
- * @return QStringList Formatted as "City, District, Province, Street"
- * @warning Returns empty list if:
+ * @brief Implementation of segmentPath().
+ */
+QString db::segmentPath(const QString &jsonPath) {
+    return jsonPath.endsWith(".json") ? jsonPath.chopped(5) + ".seg" : jsonPath + ".seg";
+}
+
+/**
+ * @brief Implementation of latestStoredTimestamp().
+ */
+qint32 db::latestStoredTimestamp(const QString &location, const QString &key) {
+    QDir dir(getAppDataPath() + "/db/" + location);
+    qint32 latest = 0;
+    const QStringList files = dir.entryList(QStringList() << key + "_*.json", QDir::Files);
+    for (const QString &fileName : files) {
+        QString fileKey;
+        qint32 from, to;
+        if (parseSeriesFileName(fileName, &fileKey, &from, &to) && fileKey == key)
+            latest = qMax(latest, to);
+    }
+    return latest;
+}
+
+/**
+ * @brief Implementation of loadPyramid().
+ * @details A stale pyramid is rebuilt in a write-ahead log commit, under
+ * the StoreLock, from the files as that commit sees them, so no save can
+ * fold into the old pyramid while it is rebuilt.
+ */
+TilePyramid db::loadPyramid(const QString &location, const QString &key) {
+    TilePyramid pyramid;
+    const qint32 latest = latestStoredTimestamp(location, key);
+    if (readPyramid(location, key, &pyramid) && pyramid.coveredUntil() >= latest)
+        return pyramid;
+
+    int points = -1;
+    WriteAheadLog::instance().write([&](WriteAheadLog::Transaction &transaction) {
+        // One point per timestamp, so overlapping files give the same pyramid in any order
+        QVector<SensorSeries> parts;
+        for (const QString &fileName : storedFiles(transaction, location, key))
+            parts.append(loadStored(transaction, location + "/" + fileName, location));
+        const SensorSeries series = mergeByPrecedence(parts);
+        pyramid = TilePyramid();
+        pyramid.insert(series);
+        points = series.size();
+        if (!pyramid.isEmpty())
+            transaction.write({ pyramidPath(location, key), pyramid.toBytes() });
+    });
+
+    if (points < 0) {
+        // The log is not writable; serve a pyramid without storing it
+        const SensorSeries series = loadSeries(location, key);
+        pyramid = TilePyramid();
+        pyramid.insert(series);
+        points = series.size();
+    }
+    qDebug() << "Rebuilt pyramid of" << location << key << "from" << points << "points";
+    return pyramid;
+}
+
+/**
+ * @brief Implementation of parseSeriesFileName().
+ * @details The newest timestamp comes first in the name, matching the order
+ * of the API response the file was originally saved from.
+ */
+bool db::parseSeriesFileName(const QString &fileName, QString *key, qint32 *from, qint32 *to) {
+    if (!fileName.endsWith(".json"))
+        return false;
+
+    QStringList parts = fileName.chopped(5).split('_');
+    if (parts.size() < 5)
+        return false;
+
+    const int n = parts.size();
+    QDateTime newest = QDateTime::fromString(parts[n - 4] + parts[n - 3], "yyyy-MM-ddHHmmss");
+    QDateTime oldest = QDateTime::fromString(parts[n - 2] + parts[n - 1], "yyyy-MM-ddHHmmss");
+    if (!newest.isValid() || !oldest.isValid())
+        return false;
+
+    *key = SensorSeries::intern(parts.mid(0, n - 4).join('_'));
+    *from = qint32(oldest.toSecsSinceEpoch());
+    *to = qint32(newest.toSecsSinceEpoch());
+    return true;
+}
+
+/**
+ * @brief Implementation of stationDisplayName().
+ */
+QString db::stationDisplayName(const QJsonObject &station) {
+    return QString("%1, %2, %3, %4").arg(station["city"].toString(),
+                                         station["district"].toString(),
+                                         station["province"].toString(),
+                                         station["station_street"].toString());
+}
+
+/**
+ * @brief Implementation of readCityData().
+ * @details Expected JSON format: the array written by ApiClient::processStationsData().
+ * @warning Returns false if:
  *          - File cannot be opened
  *          - JSON format is invalid
  */
-QStringList db::loadCityData(const QString &filePath) {
-    QStringList cityList;
+bool db::readCityData(const QString &filePath, StationTable *table, GeoIndex *index) {
     QFile file(filePath);
 
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qWarning() << "Could not open file:" << filePath;
-        return cityList;
+        return false;
     }
 
     QByteArray jsonData = file.readAll();
@@ -98,24 +634,27 @@ QStringList db::loadCityData(const QString &filePath) {
     QJsonDocument doc = QJsonDocument::fromJson(jsonData);
     if (!doc.isArray()) {
         qWarning() << "Invalid JSON format.";
-        return cityList;
+        return false;
     }
 
-    QJsonArray jsonArray = doc.array();
-    for (const QJsonValue &value : jsonArray) {
-        if (!value.isObject()) continue;
-        QJsonObject obj = value.toObject();
-
-        int id = obj["id"].toInt();
-        QString city = obj["city"].toString();
-        QString district = obj["district"].toString();
-        QString province = obj["province"].toString();
-        QString stationStreet = obj["station_street"].toString();
+    table->load(doc.array());
+    index->build(table->latitudes(), table->longitudes());
+    return true;
+}
 
-        QString displayText = QString("%1, %2, %3, %4").arg(city, district, province, stationStreet);
-        cityList.append(displayText);
-        idMap[displayText] = id;
-    }
+/**
+ * @brief Implementation of loadCityData().
+ * @return QStringList Formatted as "City, District, Province, Street"; empty
+ * if the file cannot be read (see readCityData()).
+ */
+QStringList db::loadCityData(const QString &filePath) {
+    StationTable table;
+    GeoIndex index;
+    if (!readCityData(filePath, &table, &index))
+        return QStringList();
 
-    return cityList;
+    stations = table;
+    geoIndex = index;
+    qDebug() << "Loaded" << stations.size() << "stations," << stations.memoryUsage() << "bytes";
+    return stations.displayNames();
 }
@@ -14,6 +14,10 @@
 #include <QFile>
 #include <QTextStream>
 #include <QJsonArray>
+#include "sensorseries.h"
+#include "geoindex.h"
+#include "stationtable.h"
+#include "tilepyramid.h"
 
 /**
  * @class db
@@ -34,27 +38,176 @@ public:
      */
     static QString getAppDataPath();
 
+    /**
+     * @brief Replays store writes interrupted by a crash and adds missing segments.
+     * @note Call once at startup, after the application object exists.
+     */
+    static void recoverStore();
+
     /**
      * @brief Loads city data from a JSON file.
      * @param filePath Path to the JSON file containing city data.
      * @return QStringList List of formatted city entries ("City, District, Province, Street").
-     * @note Populates the idMap with corresponding IDs for each entry.
+     * @note Populates stations and geoIndex.
      */
     static QStringList loadCityData(const QString &filePath);
 
+    /**
+     * @brief Parses a station cache without touching stations or geoIndex.
+     * @param filePath Path to the JSON file containing city data.
+     * @param table Receives the stations.
+     * @param index Receives the spatial index over table.
+     * @return bool False if the file cannot be read or is not a JSON array.
+     * @note Safe on any thread; the result can be moved into stations and geoIndex later.
+     */
+    static bool readCityData(const QString &filePath, StationTable *table, GeoIndex *index);
+
+    /**
+     * @brief Formats a cached station entry for display.
+     * @param station Entry of the station cache (see ApiClient::processStationsData()).
+     * @return QString "City, District, Province, Street"; also the station's directory name in the store.
+     */
+    static QString stationDisplayName(const QJsonObject &station);
+
     /**
      * @brief Saves sensor data to a JSON file.
-     * @param data QJsonObject containing sensor readings.
-     * @param currentLocation Location identifier for file organization.
+     * @param series Sensor readings; series.location() selects the directory.
      * @note Files are saved in AppDataLocation/db/[location]/ with timestamped filenames.
+     * @note The write is crash-safe (see WriteAheadLog); prefer saveSensorDataBatch() for many series.
+     */
+    static void saveSensorData(const SensorSeries &series);
+
+    /**
+     * @brief Saves several series with a single durable commit.
+     * @param seriesList Series to save; each is stored as by saveSensorData().
+     */
+    static void saveSensorDataBatch(const QVector<SensorSeries> &seriesList);
+
+    /**
+     * @brief Stores changed values of points that were saved before.
+     * @param revisions Series of revised points; location and key select the files.
+     * @details Each point is merged into the file of highest precedence (see
+     * seriesFiles()) whose range covers its timestamp, replacing the stored
+     * value and flags. The file, its segment and the pyramid are rewritten
+     * in one durable commit; if a revised point is unusable, the pyramid is
+     * rebuilt on its next load instead. Points no file covers are saved as
+     * by saveSensorDataBatch(), in the same commit.
+     */
+    static void reviseSensorData(const QVector<SensorSeries> &revisions);
+
+    /**
+     * @brief Lists the series files of a location's parameter in precedence order.
+     * @param location Store location.
+     * @param key Parameter key.
+     * @return QStringList File names sorted by newest, then oldest timestamp.
+     * @note Where files overlap, a later file's point replaces an earlier
+     * file's point with the same timestamp.
+     */
+    static QStringList seriesFiles(const QString &location, const QString &key);
+
+    /**
+     * @brief Puts series file names of one parameter in precedence order.
+     * @param fileNames File names, e.g. from a StoreSnapshot.
+     * @param key Parameter key; names of other parameters are dropped.
+     * @return QStringList The names in the order of seriesFiles().
+     */
+    static QStringList sortSeriesFiles(const QStringList &fileNames, const QString &key);
+
+    /**
+     * @brief Loads all stored points of a location's parameter.
+     * @param location Store location.
+     * @param key Parameter key.
+     * @return SensorSeries One point per timestamp, taken from the file of
+     * highest precedence (see seriesFiles()); empty if nothing is stored.
+     */
+    static SensorSeries loadSeries(const QString &location, const QString &key);
+
+    /**
+     * @brief Loads and merges given series files of a location's parameter.
+     * @param location Store location.
+     * @param files File names in precedence order (see sortSeriesFiles()).
+     * @return SensorSeries One point per timestamp, taken from the last file
+     * that has it, as in loadSeries().
+     */
+    static SensorSeries loadSeriesFiles(const QString &location, const QStringList &files);
+
+    /**
+     * @brief Merges series of one parameter into one point per timestamp.
+     * @param parts Series sorted by time, in ascending precedence.
+     * @return SensorSeries Each point from the last part that has its
+     * timestamp, flags included; location, key and sensor from the last
+     * non-empty part.
+     * @note The rule of loadSeries() and of saves merging into a stored file.
+     */
+    static SensorSeries mergeByPrecedence(const QVector<SensorSeries> &parts);
+
+    /**
+     * @brief Store path of a series file, relative to AppDataLocation/db.
+     * @param series Non-empty series with location and key set.
+     * @return QString "[location]/[key]_[newest]_[oldest].json"
+     */
+    static QString seriesRelativePath(const SensorSeries &series);
+
+    /**
+     * @brief Loads sensor data saved by saveSensorData().
+     * @param filePath Path to the JSON file.
+     * @param location Location the file belongs to.
+     * @return SensorSeries Loaded series, empty if the file is missing or invalid.
+     * @note Reads the memory-mapped segment next to the file when present
+     * (see SensorSeries::mapSegment()); point data is then not copied.
+     * Otherwise the JSON is parsed. Never writes to the store.
+     */
+    static SensorSeries loadSensorData(const QString &filePath, const QString &location);
+
+    /**
+     * @brief Path of the segment file kept next to a series file.
+     * @param jsonPath Series file path, absolute or relative.
+     * @return QString Same path with the ".seg" extension.
+     */
+    static QString segmentPath(const QString &jsonPath);
+
+    /**
+     * @brief Finds the newest stored timestamp of a location's parameter.
+     * @param location Store location.
+     * @param key Parameter key.
+     * @return qint32 Epoch seconds, 0 if nothing is stored.
+     * @note Reads file names only.
+     */
+    static qint32 latestStoredTimestamp(const QString &location, const QString &key);
+
+    /**
+     * @brief Loads the tile pyramid of a location's parameter.
+     * @param location Store location.
+     * @param key Parameter key.
+     * @return TilePyramid Summary of all stored points of the parameter.
+     * @note Saves update the pyramid in the same commit as the files. It is
+     * rebuilt from the series files if missing, damaged, emptied because a
+     * revision removed a value, or older than the newest stored file; the
+     * rebuilt pyramid is stored through the write-ahead log.
      */
-    static void saveSensorData(const QJsonObject &data, QString currentLocation);
+    static TilePyramid loadPyramid(const QString &location, const QString &key);
 
     /**
-     * @brief Mapping between city display strings and their IDs.
+     * @brief Parses a series file name written by saveSensorData().
+     * @param fileName Name like "PM10_2024-05-03_120000_2024-05-01_130000.json".
+     * @param key Receives the parameter key.
+     * @param from Receives the oldest timestamp (epoch seconds).
+     * @param to Receives the newest timestamp (epoch seconds).
+     * @return bool False if the name does not follow the format.
+     */
+    static bool parseSeriesFileName(const QString &fileName, QString *key, qint32 *from, qint32 *to);
+
+    /**
+     * @brief Stations in cache order, with lookups by ID and display name.
      * @note Populated by loadCityData().
      */
-    static QMap<QString, int> idMap;
+    static StationTable stations;
+
+    /**
+     * @brief Spatial index over stations; hits are rows of stations.
+     * @note Built by loadCityData(); empty if the cache has no coordinates.
+     */
+    static GeoIndex geoIndex;
 };
 
 #endif // DB_H
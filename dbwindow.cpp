@@ -6,13 +6,21 @@
 #include "dbwindow.h"
 #include "ui_dbwindow.h"
 #include "db.h"
+#include "archivemodel.h"
+#include "seriesexporter.h"
+#include "seriescache.h"
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QThread>
 #include "mainwindow.h"
 
 /**
  * @brief Constructs the database browser window.
  * @details Initializes UI elements including:
- * - City selection area
- * - Scrollable file list
+ * - Filter row (city, parameter, optional time range)
+ * - Virtualized tree of cities and files
+ * - Live count of matching files
  * - Sets window properties
  */
 dbWindow::dbWindow(MainWindow *mainWindow, QWidget *parent)
@@ -23,29 +31,72 @@ dbWindow::dbWindow(MainWindow *mainWindow, QWidget *parent)
     ui->setupUi(this);
 
     setWindowTitle("Saved Database Records");
-    resize(500, 400);
+    resize(640, 480);
 
     QVBoxLayout *mainLayout = new QVBoxLayout(this);
 
-    QLabel *label = new QLabel("Select city:");
-    mainLayout->addWidget(label);
-
-    QWidget *cityContainer = new QWidget();
-    cityLayout = new QVBoxLayout(cityContainer);
-    mainLayout->addWidget(cityContainer);
-
-    QLabel *fileLabel = new QLabel("JSON Files:");
-    mainLayout->addWidget(fileLabel);
-
-    fileContainer = new QWidget();
-    fileLayout = new QVBoxLayout(fileContainer);
-    QScrollArea *scroll = new QScrollArea();
-    scroll->setWidget(fileContainer);
-    scroll->setWidgetResizable(true);
-    scroll->setMinimumHeight(200);
-    mainLayout->addWidget(scroll);
-
-    loadCities();
+    // Filter row
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    cityFilter = new QLineEdit();
+    cityFilter->setPlaceholderText("Filter city...");
+    parameterFilter = new QComboBox();
+    parameterFilter->addItem("All parameters", QString());
+    for (const QString &key : {"PM10", "PM2.5", "NO2", "SO2", "O3", "CO", "C6H6"})
+        parameterFilter->addItem(key, key);
+    rangeEnabled = new QCheckBox("Time range:");
+    fromEdit = new QDateTimeEdit(QDateTime::currentDateTime().addDays(-7));
+    toEdit = new QDateTimeEdit(QDateTime::currentDateTime());
+    fromEdit->setCalendarPopup(true);
+    toEdit->setCalendarPopup(true);
+    fromEdit->setEnabled(false);
+    toEdit->setEnabled(false);
+
+    filterLayout->addWidget(cityFilter, 1);
+    filterLayout->addWidget(parameterFilter);
+    filterLayout->addWidget(rangeEnabled);
+    filterLayout->addWidget(fromEdit);
+    filterLayout->addWidget(toEdit);
+    mainLayout->addLayout(filterLayout);
+
+    // Archive tree; rows are only listed as the view scrolls to them
+    model = new ArchiveModel(db::getAppDataPath() + "/db", this);
+    proxy = new ArchiveFilterProxy(this);
+    proxy->setSourceModel(model);
+
+    view = new QTreeView();
+    view->setModel(proxy);
+    view->setUniformRowHeights(true);
+    view->setSortingEnabled(true);
+    view->sortByColumn(ArchiveModel::NameColumn, Qt::AscendingOrder);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setMinimumHeight(200);
+    mainLayout->addWidget(view, 1);
+
+    QHBoxLayout *bottomLayout = new QHBoxLayout();
+    countLabel = new QLabel();
+    QPushButton *exportButton = new QPushButton("Export...");
+    bottomLayout->addWidget(countLabel, 1);
+    bottomLayout->addWidget(exportButton);
+    mainLayout->addLayout(bottomLayout);
+
+    connect(cityFilter, &QLineEdit::textChanged, this, &dbWindow::applyFilters);
+    connect(parameterFilter, &QComboBox::currentIndexChanged, this, &dbWindow::applyFilters);
+    connect(rangeEnabled, &QCheckBox::toggled, this, [this](bool enabled) {
+        fromEdit->setEnabled(enabled);
+        toEdit->setEnabled(enabled);
+        applyFilters();
+    });
+    connect(fromEdit, &QDateTimeEdit::dateTimeChanged, this, &dbWindow::applyFilters);
+    connect(toEdit, &QDateTimeEdit::dateTimeChanged, this, &dbWindow::applyFilters);
+    connect(view, &QTreeView::activated, this, &dbWindow::openIndex);
+    connect(exportButton, &QPushButton::clicked, this, &dbWindow::exportSelection);
+
+    connect(proxy, &QAbstractItemModel::rowsInserted, this, &dbWindow::updateCount);
+    connect(proxy, &QAbstractItemModel::rowsRemoved, this, &dbWindow::updateCount);
+    connect(proxy, &QAbstractItemModel::layoutChanged, this, &dbWindow::updateCount);
+    connect(proxy, &QAbstractItemModel::modelReset, this, &dbWindow::updateCount);
+
+    updateCount();
 }
 
 /**
@@ -57,84 +108,111 @@ dbWindow::~dbWindow()
 }
 
 /**
- * @brief Loads available cities from the database directory.
- * @details Scans the database directory for subdirectories representing cities
- * and creates clickable buttons for each one.
+ * @brief Pushes the current filter widget state into the proxy model.
  */
-void dbWindow::loadCities()
+void dbWindow::applyFilters()
 {
-    QString dbPath = db::getAppDataPath() + "/db";
-    QDir dbDir(dbPath);
-    QStringList cities = dbDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-
-    for (const QString &city : cities) {
-        QPushButton *btn = new QPushButton(city);
-        cityLayout->addWidget(btn);
+    proxy->setLocationFilter(cityFilter->text());
+    proxy->setParameterFilter(parameterFilter->currentData().toString());
+    if (rangeEnabled->isChecked())
+        proxy->setTimeRange(fromEdit->dateTime(), toEdit->dateTime());
+    else
+        proxy->setTimeRange(QDateTime(), QDateTime());
+    updateCount();
+}
 
-        connect(btn, &QPushButton::clicked, this, [=]() {
-            loadFilesForCity(city);
-        });
-    }
+/**
+ * @brief Shows how many listed files pass the filters.
+ * @details Counts only rows fetched so far; expanding cities extends it.
+ */
+void dbWindow::updateCount()
+{
+    countLabel->setText(QString("%1 of %2 listed files match")
+                            .arg(proxy->acceptedFileCount())
+                            .arg(model->loadedFileCount()));
 }
 
 /**
- * @brief Loads JSON files for a specific city.
- * @param city Name of the city to load files for.
- * @details Clears previous file list and populates with new file buttons.
+ * @brief Exports everything matching the current filters.
+ * @details Unlike the count, the export covers the whole store, not only the
+ * rows listed so far. The exporter runs in its own thread and reports into
+ * a cancellable progress dialog.
  */
-void dbWindow::loadFilesForCity(const QString &city)
+void dbWindow::exportSelection()
 {
-    // Clear previous file buttons
-    QLayoutItem *child;
-    while ((child = fileLayout->takeAt(0)) != nullptr) {
-        delete child->widget();
-        delete child;
+    QString path = QFileDialog::getSaveFileName(this, "Export data", QString(),
+                                                "CSV (*.csv);;Columnar (*.wxc);;JSON (*.json)");
+    if (path.isEmpty())
+        return;
+
+    ExportQuery query;
+    query.location = cityFilter->text();
+    query.parameter = parameterFilter->currentData().toString();
+    if (rangeEnabled->isChecked()) {
+        query.from = fromEdit->dateTime().toSecsSinceEpoch();
+        query.to = toEdit->dateTime().toSecsSinceEpoch();
     }
 
-    QString cityPath = db::getAppDataPath() + "/db/" + city;
-    QDir cityDir(cityPath);
-    QStringList files = cityDir.entryList(QStringList() << "*.json", QDir::Files);
+    QThread *thread = new QThread();
+    SeriesExporter *exporter = new SeriesExporter(query, SeriesExporter::formatForPath(path), path);
+    exporter->moveToThread(thread);
+
+    QProgressDialog *progress = new QProgressDialog("Exporting...", "Cancel", 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->show();
+
+    connect(thread, &QThread::started, exporter, &SeriesExporter::run);
+    connect(progress, &QProgressDialog::canceled, exporter, &SeriesExporter::cancel, Qt::DirectConnection);
+    connect(exporter, &SeriesExporter::progress, progress, [progress](int done, int total) {
+        progress->setMaximum(total);
+        progress->setValue(done);
+    });
+    connect(exporter, &SeriesExporter::finished, this, [this, progress](bool ok, const QString &message) {
+        progress->close();
+        if (ok)
+            QMessageBox::information(this, "Export", message);
+        else
+            QMessageBox::warning(this, "Export", message);
+    });
+    connect(exporter, &SeriesExporter::finished, thread, &QThread::quit);
+    connect(thread, &QThread::finished, exporter, &QObject::deleteLater);
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+}
 
-    for (const QString &file : files) {
-        QPushButton *fileBtn = new QPushButton(file);
-        QStringList parts = file.split('_');
-        fileBtn->setText(QString("%1, from %2 @ %3%4 to %5 @ %6%7").arg(parts[0], parts[3], parts[4][0], parts[4][1], parts[1], parts[2][0], parts[2][1]));
+/**
+ * @brief Loads the file behind an activated (double-clicked) row.
+ * @param index Proxy index of the row; location rows are ignored.
+ */
+void dbWindow::openIndex(const QModelIndex &index)
+{
+    if (!index.data(ArchiveModel::IsFileRole).toBool())
+        return;
 
-        fileLayout->addWidget(fileBtn);
-        connect(fileBtn, &QPushButton::clicked, this, [=]() {
-            qDebug() << "Selected JSON file:" << cityPath + "/" + file;
-            loadJsonFile(city, file);
-        });
-    }
+    QString city = index.data(ArchiveModel::LocationRole).toString();
+    QString file = index.data(ArchiveModel::FileNameRole).toString();
+    qDebug() << "Selected JSON file:" << city + "/" + file;
+    loadJsonFile(city, file);
 }
 
 /**
  * @brief Loads and processes a specific JSON file.
  * @param city City name where the file is located.
  * @param fileName Name of the JSON file to load.
- * @details Validates JSON format and sends data to MainWindow for processing.
+ * @details Decodes the file into a SensorSeries, unless it is cached, and sends it to MainWindow for processing.
  */
 void dbWindow::loadJsonFile(const QString &city, const QString &fileName)
 {
     QString filePath = db::getAppDataPath() + "/db/" + city + "/" + fileName;
-    QFile file(filePath);
-
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Could not open file:" << filePath;
-        return;
-    }
-
-    QByteArray jsonData = file.readAll();
-    file.close();
-
-    QJsonDocument doc = QJsonDocument::fromJson(jsonData);
-    if (!doc.isObject()) {
-        qWarning() << "Invalid JSON format.";
-        return;
+    const QString cacheKey = SeriesCache::fileKey(filePath);
+    SensorSeries series;
+    if (!SeriesCache::instance().find(cacheKey, &series)) {
+        series = db::loadSensorData(filePath, city);
+        if (series.isEmpty())
+            return;
+        SeriesCache::instance().insert(cacheKey, series);
     }
 
-    QJsonObject jsonObj = doc.object();
-    qDebug() << "JSON Object loaded:" << jsonObj;
-
-    m_mainWindow->handleLoadDb(jsonObj, city);
+    m_mainWindow->handleLoadDb(series);
 }
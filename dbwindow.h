@@ -8,13 +8,19 @@
 
 #include <QWidget>
 #include <QVBoxLayout>
-#include <QScrollArea>
+#include <QTreeView>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QDateTimeEdit>
+#include <QCheckBox>
 #include <QDir>
-#include <QPushButton>
 #include <QLabel>
+#include <QPushButton>
 #include <QDebug>
 
 class MainWindow;
+class ArchiveModel;
+class ArchiveFilterProxy;
 
 namespace Ui {
 class dbWindow;
@@ -25,9 +31,10 @@ class dbWindow;
  * @brief Provides a GUI interface for browsing and loading saved sensor data.
  *
  * The window displays:
- * - List of available cities (as directories)
- * - JSON files for selected city
- * - Allows loading data back into the main application
+ * - A lazily loaded tree of cities (as directories) and their JSON files
+ * - Filters by city, parameter and time range with a live match count
+ * - Exports the filtered selection to CSV or a columnar file
+ * - Allows loading data back into the main application (double-click a file)
  */
 class dbWindow : public QWidget
 {
@@ -49,20 +56,36 @@ public:
 private:
     MainWindow *m_mainWindow; ///< Reference to parent main window
     Ui::dbWindow *ui; ///< UI components
-    QVBoxLayout *fileLayout; ///< Layout for file buttons
-    QVBoxLayout *cityLayout; ///< Layout for city buttons
-    QWidget *fileContainer; ///< Container widget for scroll area
+    ArchiveModel *model; ///< Lazily populated archive tree
+    ArchiveFilterProxy *proxy; ///< Sorting and filtering on top of the model
+    QTreeView *view; ///< Virtualized tree view
+    QLineEdit *cityFilter; ///< City name filter
+    QComboBox *parameterFilter; ///< Parameter key filter
+    QCheckBox *rangeEnabled; ///< Enables the time range filter
+    QDateTimeEdit *fromEdit; ///< Time range start
+    QDateTimeEdit *toEdit; ///< Time range end
+    QLabel *countLabel; ///< Live count of matching files
+
+    /**
+     * @brief Applies the filter widgets to the proxy model
+     */
+    void applyFilters();
+
+    /**
+     * @brief Refreshes the matching file count
+     */
+    void updateCount();
 
     /**
-     * @brief Loads available cities from the database directory
+     * @brief Exports files matching the current filters in a background thread
      */
-    void loadCities();
+    void exportSelection();
 
     /**
-     * @brief Loads JSON files for a specific city
-     * @param city Name of the city to load files for
+     * @brief Loads the file behind an activated row
+     * @param index Proxy index of the activated row
      */
-    void loadFilesForCity(const QString &city);
+    void openIndex(const QModelIndex &index);
 
     /**
      * @brief Loads and processes a specific JSON file
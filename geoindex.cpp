@@ -0,0 +1,154 @@
+/**
+ * @file geoindex.cpp
+ * @brief Implementation of the station spatial index.
+ */
+
+#include "geoindex.h"
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const double kEarthRadiusKm = 6371.0;
+}
+
+/**
+ * @brief Implementation of build().
+ */
+void GeoIndex::build(const QVector<double> &latitudes, const QVector<double> &longitudes)
+{
+    m_points.clear();
+    m_points.reserve(latitudes.size());
+    for (int i = 0; i < latitudes.size() && i < longitudes.size(); ++i) {
+        if (std::isnan(latitudes[i]) || std::isnan(longitudes[i]))
+            continue;
+        m_points.append({ latitudes[i], longitudes[i], i });
+    }
+    buildRange(0, m_points.size(), 0);
+}
+
+/**
+ * @brief Places the median of a range at its centre, then recurses.
+ * @details Even depths split on latitude, odd depths on longitude.
+ */
+void GeoIndex::buildRange(int lo, int hi, int depth)
+{
+    if (hi - lo <= 1)
+        return;
+
+    const int mid = (lo + hi) / 2;
+    const bool byLat = depth % 2 == 0;
+    std::nth_element(m_points.begin() + lo, m_points.begin() + mid, m_points.begin() + hi,
+                     [byLat](const Point &a, const Point &b) {
+                         return byLat ? a.lat < b.lat : a.lon < b.lon;
+                     });
+    buildRange(lo, mid, depth + 1);
+    buildRange(mid + 1, hi, depth + 1);
+}
+
+/**
+ * @brief Implementation of distanceKm() (haversine formula).
+ */
+double GeoIndex::distanceKm(double lat1, double lon1, double lat2, double lon2)
+{
+    const double dLat = qDegreesToRadians(lat2 - lat1);
+    const double dLon = qDegreesToRadians(lon2 - lon1);
+    const double a = std::sin(dLat / 2) * std::sin(dLat / 2)
+                     + std::cos(qDegreesToRadians(lat1)) * std::cos(qDegreesToRadians(lat2))
+                       * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2 * kEarthRadiusKm * std::asin(std::sqrt(qMin(1.0, a)));
+}
+
+/**
+ * @brief Implementation of nearest().
+ */
+QVector<GeoIndex::Hit> GeoIndex::nearest(double lat, double lon, int k) const
+{
+    QVector<Hit> best;
+    if (k <= 0)
+        return best;
+    best.reserve(k + 1);
+    nearestRange(0, m_points.size(), 0, lat, lon, k, best);
+    return best;
+}
+
+/**
+ * @brief Recursive k-nearest search keeping @p best sorted by distance.
+ * @details The far side of a split is visited only if the distance to the
+ * splitting line can beat the current k-th best.
+ */
+void GeoIndex::nearestRange(int lo, int hi, int depth, double lat, double lon, int k,
+                            QVector<Hit> &best) const
+{
+    if (lo >= hi)
+        return;
+
+    const int mid = (lo + hi) / 2;
+    const Point &node = m_points[mid];
+
+    const double d = distanceKm(lat, lon, node.lat, node.lon);
+    if (best.size() < k || d < best.last().distanceKm) {
+        auto pos = std::upper_bound(best.begin(), best.end(), d,
+                                    [](double value, const Hit &hit) { return value < hit.distanceKm; });
+        best.insert(pos, { node.station, d });
+        if (best.size() > k)
+            best.removeLast();
+    }
+
+    const bool byLat = depth % 2 == 0;
+    const bool goLeft = byLat ? lat < node.lat : lon < node.lon;
+
+    // Lower bound of the distance from the query point to the split line
+    double planeKm;
+    if (byLat) {
+        planeKm = qDegreesToRadians(qAbs(lat - node.lat)) * kEarthRadiusKm;
+    } else {
+        const double dLon = qDegreesToRadians(qMin(qAbs(lon - node.lon), 90.0));
+        planeKm = std::asin(qAbs(std::cos(qDegreesToRadians(lat)) * std::sin(dLon))) * kEarthRadiusKm;
+    }
+
+    if (goLeft) {
+        nearestRange(lo, mid, depth + 1, lat, lon, k, best);
+        if (best.size() < k || planeKm < best.last().distanceKm)
+            nearestRange(mid + 1, hi, depth + 1, lat, lon, k, best);
+    } else {
+        nearestRange(mid + 1, hi, depth + 1, lat, lon, k, best);
+        if (best.size() < k || planeKm < best.last().distanceKm)
+            nearestRange(lo, mid, depth + 1, lat, lon, k, best);
+    }
+}
+
+/**
+ * @brief Implementation of withinBox().
+ */
+QVector<int> GeoIndex::withinBox(double minLat, double minLon, double maxLat, double maxLon) const
+{
+    QVector<int> out;
+    boxRange(0, m_points.size(), 0, minLat, minLon, maxLat, maxLon, out);
+    return out;
+}
+
+/**
+ * @brief Recursive range search; skips sides of a split outside the box.
+ */
+void GeoIndex::boxRange(int lo, int hi, int depth, double minLat, double minLon, double maxLat, double maxLon,
+                        QVector<int> &out) const
+{
+    if (lo >= hi)
+        return;
+
+    const int mid = (lo + hi) / 2;
+    const Point &node = m_points[mid];
+    if (node.lat >= minLat && node.lat <= maxLat && node.lon >= minLon && node.lon <= maxLon)
+        out.append(node.station);
+
+    const bool byLat = depth % 2 == 0;
+    const double value = byLat ? node.lat : node.lon;
+    const double low = byLat ? minLat : minLon;
+    const double high = byLat ? maxLat : maxLon;
+
+    if (low <= value)
+        boxRange(lo, mid, depth + 1, minLat, minLon, maxLat, maxLon, out);
+    if (high >= value)
+        boxRange(mid + 1, hi, depth + 1, minLat, minLon, maxLat, maxLon, out);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file geoindex.h
+ * @brief Spatial index over station coordinates.
+ */
+
+#ifndef GEOINDEX_H
+#define GEOINDEX_H
+
+#include <QVector>
+
+/**
+ * @class GeoIndex
+ * @brief Static 2-d tree over latitude/longitude for station lookups.
+ *
+ * Built once from the station cache. Nodes are stored implicitly in one
+ * sorted array (the median of each range is the node), so the index costs
+ * 24 bytes per station and no pointers. Distances are great-circle
+ * distances; subtrees are pruned with exact lower bounds (meridian arc for
+ * latitude splits, cross-track distance for longitude splits), so results
+ * are exact, not approximate.
+ */
+class GeoIndex
+{
+public:
+    /**
+     * @brief Result of a nearest-neighbour query.
+     */
+    struct Hit {
+        int station;       ///< Index of the station in the arrays passed to build()
+        double distanceKm; ///< Great-circle distance from the query point
+    };
+
+    /**
+     * @brief Builds the index.
+     * @param latitudes Latitude per station, degrees (NaN if unknown).
+     * @param longitudes Longitude per station, degrees (NaN if unknown).
+     */
+    void build(const QVector<double> &latitudes, const QVector<double> &longitudes);
+
+    /**
+     * @brief Finds the k stations closest to a point.
+     * @param lat Latitude, degrees.
+     * @param lon Longitude, degrees.
+     * @param k Number of stations to return.
+     * @return QVector<Hit> Up to k hits, nearest first.
+     */
+    QVector<Hit> nearest(double lat, double lon, int k) const;
+
+    /**
+     * @brief Finds all stations inside a latitude/longitude box.
+     * @return QVector<int> Station indexes, unordered.
+     */
+    QVector<int> withinBox(double minLat, double minLon, double maxLat, double maxLon) const;
+
+    /**
+     * @brief Number of indexed stations (those with coordinates).
+     */
+    int size() const { return m_points.size(); }
+    bool isEmpty() const { return m_points.isEmpty(); }
+
+    /**
+     * @brief Great-circle distance between two points.
+     * @return double Kilometres.
+     */
+    static double distanceKm(double lat1, double lon1, double lat2, double lon2);
+
+private:
+    /**
+     * @brief Indexed station.
+     */
+    struct Point {
+        double lat;
+        double lon;
+        int station;
+    };
+
+    QVector<Point> m_points; ///< Implicit tree: node of [lo, hi) is at (lo + hi) / 2
+
+    void buildRange(int lo, int hi, int depth);
+    void nearestRange(int lo, int hi, int depth, double lat, double lon, int k, QVector<Hit> &best) const;
+    void boxRange(int lo, int hi, int depth, double minLat, double minLon, double maxLat, double maxLon,
+                  QVector<int> &out) const;
+};
+
+#endif // GEOINDEX_H
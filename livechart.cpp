@@ -0,0 +1,286 @@
+/**
+ * @file livechart.cpp
+ * @brief Implementation of the live charts.
+ */
+
+#include "livechart.h"
+#include "pollscheduler.h"
+#include <QChart>
+#include <QChartView>
+#include <QDateTime>
+#include <QDateTimeAxis>
+#include <QHBoxLayout>
+#include <QLineSeries>
+#include <QScrollArea>
+#include <QToolButton>
+#include <QValueAxis>
+#include <QVBoxLayout>
+#include <QtNumeric>
+
+namespace {
+bool isUsable(const SeriesRing::Point &point)
+{
+    return point.flags == 0 && !qIsNaN(point.value);
+}
+}
+
+/**
+ * @brief Builds the chart and draws the seed points.
+ */
+LiveChart::LiveChart(const SensorSeries &history, const QString &location, QWidget *parent)
+    : QWidget(parent)
+    , m_sensorId(history.sensorId())
+    , m_key(history.key())
+    , m_ring(kCapacity)
+    , m_bucketPoints((kCapacity + kMaxDrawnPoints - 1) / kMaxDrawnPoints)
+{
+    for (int i = qMax(0, history.size() - kCapacity); i < history.size(); ++i) {
+        if (history.isValid(i))
+            m_ring.add(history.timestamp(i), history.value(i), history.flags(i));
+    }
+
+    m_line = new QLineSeries();
+    m_axisX = new QDateTimeAxis();
+    m_axisX->setFormat("dd.MM HH:mm");
+    m_axisY = new QValueAxis();
+    m_axisY->setTitleText(m_key + " (µg/m³)");
+
+    // No animations: every update would restart them
+    QChart *chart = new QChart();
+    chart->addSeries(m_line);
+    chart->addAxis(m_axisX, Qt::AlignBottom);
+    chart->addAxis(m_axisY, Qt::AlignLeft);
+    m_line->attachAxis(m_axisX);
+    m_line->attachAxis(m_axisY);
+    chart->legend()->hide();
+    chart->setAnimationOptions(QChart::NoAnimation);
+
+    QChartView *view = new QChartView(chart);
+    view->setRenderHint(QPainter::Antialiasing);
+    view->setMinimumHeight(240);
+
+    QLabel *title = new QLabel(QString("<b>%1</b> – %2").arg(m_key, location));
+    QToolButton *close = new QToolButton();
+    close->setText("Close");
+    connect(close, &QToolButton::clicked, this, [this]() { emit closeRequested(m_sensorId); });
+
+    QHBoxLayout *header = new QHBoxLayout();
+    header->addWidget(title, 1);
+    header->addWidget(close);
+
+    m_stats = new QLabel();
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(header);
+    layout->addWidget(view, 1);
+    layout->addWidget(m_stats);
+
+    rebuildLine();
+    refresh();
+}
+
+/**
+ * @brief Implementation of append().
+ * @details A revised point makes the ring rebuild; the line is then
+ * rebuilt once after all points are in.
+ */
+void LiveChart::append(const SensorSeries &points)
+{
+    bool rebuild = false;
+    for (int i = 0; i < points.size(); ++i) {
+        if (!points.isValid(i))
+            continue;
+        if (!m_ring.add(points.timestamp(i), points.value(i), points.flags(i)))
+            rebuild = true;
+        else if (!rebuild)
+            addToLine(m_ring.at(m_ring.size() - 1));
+    }
+
+    if (rebuild)
+        rebuildLine();
+    else
+        trimLine();
+    refresh();
+}
+
+/**
+ * @brief Adds a usable point to the open bucket and redraws the bucket's point.
+ */
+void LiveChart::addToLine(const SeriesRing::Point &point)
+{
+    if (!isUsable(point))
+        return;
+
+    m_bucketSum += point.value;
+    m_bucketTimeSum += point.time;
+    m_bucketCount++;
+    const QPointF drawn(qreal(m_bucketTimeSum / m_bucketCount) * 1000, m_bucketSum / m_bucketCount);
+    if (m_bucketOpen)
+        m_line->replace(m_line->count() - 1, drawn);
+    else
+        m_line->append(drawn);
+    m_bucketOpen = true;
+
+    if (m_bucketCount == m_bucketPoints) {
+        m_bucketSum = 0;
+        m_bucketTimeSum = 0;
+        m_bucketCount = 0;
+        m_bucketOpen = false;
+    }
+}
+
+/**
+ * @brief Removes drawn buckets centred before the oldest point of the window.
+ */
+void LiveChart::trimLine()
+{
+    if (m_ring.isEmpty())
+        return;
+    const qreal oldest = qreal(m_ring.firstTimestamp()) * 1000;
+    int expired = 0;
+    while (expired < m_line->count() && m_line->at(expired).x() < oldest)
+        ++expired;
+    if (expired == 0)
+        return;
+    if (expired == m_line->count() && m_bucketOpen) {
+        m_bucketSum = 0;
+        m_bucketTimeSum = 0;
+        m_bucketCount = 0;
+        m_bucketOpen = false;
+    }
+    m_line->removePoints(0, expired);
+}
+
+/**
+ * @brief Draws the whole window again, bucket by bucket.
+ */
+void LiveChart::rebuildLine()
+{
+    QList<QPointF> drawn;
+    drawn.reserve(m_ring.size() / m_bucketPoints + 1);
+    m_bucketSum = 0;
+    m_bucketTimeSum = 0;
+    m_bucketCount = 0;
+    for (int i = 0; i < m_ring.size(); ++i) {
+        const SeriesRing::Point &point = m_ring.at(i);
+        if (!isUsable(point))
+            continue;
+        m_bucketSum += point.value;
+        m_bucketTimeSum += point.time;
+        if (++m_bucketCount == m_bucketPoints) {
+            drawn.append(QPointF(qreal(m_bucketTimeSum / m_bucketCount) * 1000, m_bucketSum / m_bucketCount));
+            m_bucketSum = 0;
+            m_bucketTimeSum = 0;
+            m_bucketCount = 0;
+        }
+    }
+    m_bucketOpen = m_bucketCount > 0;
+    if (m_bucketOpen)
+        drawn.append(QPointF(qreal(m_bucketTimeSum / m_bucketCount) * 1000, m_bucketSum / m_bucketCount));
+    m_line->replace(drawn);
+}
+
+/**
+ * @brief Updates axes and statistics from the ring in O(1).
+ */
+void LiveChart::refresh()
+{
+    if (m_ring.isEmpty()) {
+        m_stats->setText("Waiting for data");
+        return;
+    }
+
+    m_axisX->setRange(QDateTime::fromSecsSinceEpoch(m_ring.firstTimestamp()),
+                      QDateTime::fromSecsSinceEpoch(qMax(m_ring.lastTimestamp(), m_ring.firstTimestamp() + 3600)));
+    const double min = m_ring.min();
+    const double max = m_ring.max();
+    m_axisY->setRange(min > 0 ? 0 : min * 1.1, max > 0 ? max * 1.1 : 1);
+
+    const SeriesRing::Point &latest = m_ring.at(m_ring.size() - 1);
+    m_stats->setText(QString("<b>Latest:</b> %1 µg/m³ at %2%3 &nbsp; <b>Average:</b> %4 &nbsp; "
+                             "<b>Min:</b> %5 &nbsp; <b>Max:</b> %6 &nbsp; <b>Points:</b> %7 &nbsp; <b>Flagged:</b> %8")
+                         .arg(latest.value, 0, 'f', 1)
+                         .arg(QDateTime::fromSecsSinceEpoch(latest.time).toString("dd.MM HH:mm"))
+                         .arg(latest.flags != 0 ? " (flagged)" : "")
+                         .arg(m_ring.mean(), 0, 'f', 1)
+                         .arg(min, 0, 'f', 1)
+                         .arg(max, 0, 'f', 1)
+                         .arg(m_ring.usableCount())
+                         .arg(m_ring.flaggedCount()));
+}
+
+/**
+ * @brief Implementation of the LiveChartWindow constructor.
+ */
+LiveChartWindow::LiveChartWindow(PollScheduler *scheduler, QWidget *parent)
+    : QWidget(parent)
+    , m_scheduler(scheduler)
+{
+    setWindowTitle("Live sensors");
+    resize(1200, 800);
+
+    QWidget *content = new QWidget();
+    m_grid = new QGridLayout(content);
+    QScrollArea *scrollArea = new QScrollArea();
+    scrollArea->setWidgetResizable(true);
+    scrollArea->setWidget(content);
+
+    m_placeholder = new QLabel("Open a sensor and choose \"Live chart\" to add it here.");
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_placeholder);
+    layout->addWidget(scrollArea, 1);
+
+    connect(m_scheduler, &PollScheduler::sensorUpdated, this, &LiveChartWindow::handleUpdate);
+}
+
+/**
+ * @brief Implementation of addSensor().
+ */
+void LiveChartWindow::addSensor(const SensorSeries &history, const QString &location)
+{
+    const int sensorId = history.sensorId();
+    if (sensorId == 0 || m_charts.contains(sensorId))
+        return;
+    if (!m_scheduler->isWatched(sensorId))
+        m_scheduler->watch(sensorId, location, history.key());
+
+    LiveChart *chart = new LiveChart(history, location);
+    connect(chart, &LiveChart::closeRequested, this, &LiveChartWindow::removeSensor);
+    m_charts.insert(sensorId, chart);
+    m_order.append(sensorId);
+    relayout();
+}
+
+/**
+ * @brief Passes new points to the chart of their sensor, if it is open.
+ */
+void LiveChartWindow::handleUpdate(const SensorSeries &points)
+{
+    if (LiveChart *chart = m_charts.value(points.sensorId()))
+        chart->append(points);
+}
+
+/**
+ * @brief Closes a chart; the sensor stays watched.
+ */
+void LiveChartWindow::removeSensor(int sensorId)
+{
+    LiveChart *chart = m_charts.take(sensorId);
+    if (!chart)
+        return;
+    m_order.removeAll(sensorId);
+    m_grid->removeWidget(chart);
+    chart->deleteLater();
+    relayout();
+}
+
+/**
+ * @brief Places the charts in grid order.
+ */
+void LiveChartWindow::relayout()
+{
+    for (int sensorId : std::as_const(m_order))
+        m_grid->removeWidget(m_charts.value(sensorId));
+    for (int i = 0; i < m_order.size(); ++i)
+        m_grid->addWidget(m_charts.value(m_order[i]), i / kColumns, i % kColumns);
+    m_placeholder->setVisible(m_order.isEmpty());
+}
@@ -0,0 +1,133 @@
+/**
+ * @file livechart.h
+ * @brief Charts that extend themselves as the poll scheduler stores new readings.
+ */
+
+#ifndef LIVECHART_H
+#define LIVECHART_H
+
+#include <QGridLayout>
+#include <QHash>
+#include <QLabel>
+#include <QWidget>
+#include "seriesring.h"
+#include "sensorseries.h"
+
+class QDateTimeAxis;
+class QLineSeries;
+class QValueAxis;
+class PollScheduler;
+
+/**
+ * @class LiveChart
+ * @brief Chart of the newest kCapacity points of one sensor, updated point by point.
+ *
+ * Points live in a SeriesRing. The drawn line holds one point per bucket
+ * of bucketPoints() usable points (their mean), so it never has more than
+ * about kMaxDrawnPoints points. A new point updates the open bucket, or
+ * closes it and starts the next; buckets that left the window are removed
+ * from the front of the line. Axes and statistics are read from the ring.
+ * Appending therefore costs O(new points), whatever the window size; only
+ * revised values rebuild the line.
+ */
+class LiveChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    static const int kCapacity = 30 * 24;      ///< Hourly points kept: 30 days
+    static const int kMaxDrawnPoints = 360;    ///< Upper bound of the drawn line
+
+    /**
+     * @brief Constructs a chart seeded with the newest points of a series.
+     * @param history Points already known; may be empty.
+     * @param location Location shown in the title.
+     * @param parent Parent widget (optional).
+     */
+    LiveChart(const SensorSeries &history, const QString &location, QWidget *parent = nullptr);
+
+    int sensorId() const { return m_sensorId; }
+
+    /**
+     * @brief Adds points in time order; invalid points are skipped.
+     */
+    void append(const SensorSeries &points);
+
+    /**
+     * @brief Usable points per drawn point.
+     */
+    int bucketPoints() const { return m_bucketPoints; }
+
+signals:
+    /**
+     * @brief Emitted when the user closes the chart.
+     */
+    void closeRequested(int sensorId);
+
+private:
+    int m_sensorId;
+    QString m_key;
+    SeriesRing m_ring;
+    int m_bucketPoints;
+
+    QLineSeries *m_line;
+    QDateTimeAxis *m_axisX;
+    QValueAxis *m_axisY;
+    QLabel *m_stats;
+
+    // Open bucket; drawn as the last point of m_line while m_bucketOpen
+    double m_bucketSum = 0;
+    qint64 m_bucketTimeSum = 0;
+    int m_bucketCount = 0;
+    bool m_bucketOpen = false;
+
+    void addToLine(const SeriesRing::Point &point);
+    void trimLine();
+    void rebuildLine();
+    void refresh();
+};
+
+/**
+ * @class LiveChartWindow
+ * @brief Grid of live charts fed by PollScheduler::sensorUpdated().
+ *
+ * Each update goes only to the chart of its sensor, so the cost of an
+ * update does not depend on how many charts are open. Sensors shown here
+ * are watched by the scheduler.
+ */
+class LiveChartWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs an empty window.
+     * @param scheduler Source of the updates.
+     * @param parent Parent widget (optional).
+     */
+    explicit LiveChartWindow(PollScheduler *scheduler, QWidget *parent = nullptr);
+
+    /**
+     * @brief Shows a sensor, watching it if it is not watched yet.
+     * @param history Points already known, with sensor ID and key set.
+     * @param location Store location of the sensor's station.
+     */
+    void addSensor(const SensorSeries &history, const QString &location);
+
+private slots:
+    void handleUpdate(const SensorSeries &points);
+    void removeSensor(int sensorId);
+
+private:
+    PollScheduler *m_scheduler;
+    QGridLayout *m_grid;
+    QLabel *m_placeholder;
+    QHash<int, LiveChart *> m_charts;
+    QVector<int> m_order; ///< Sensors in grid order
+
+    void relayout();
+
+    static const int kColumns = 2;
+};
+
+#endif // LIVECHART_H
@@ -7,6 +7,8 @@
  */
 
 #include "mainwindow.h"
+#include "commandline.h"
+#include "startupprofile.h"
 #include <QApplication>
 
 /**
@@ -20,11 +22,25 @@
  * 2. Creates and shows the MainWindow
  * 3. Enters the main event loop
  *
+ * Headless commands (see commandline.h) run on a QCoreApplication instead;
+ * they recover the store themselves once their options are parsed.
+ *
+ * Startup milestones are logged by StartupProfile; the window paints
+ * before the station index and other subsystems finish loading, and store
+ * recovery runs in the background after the first paint.
+ *
  * @note The QApplication object must be created before any Qt GUI components.
  */
 int main(int argc, char *argv[])
 {
+    StartupProfile::start();
+    if (isCommandLineInvocation(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return runCommandLine(app);
+    }
+
     QApplication a(argc, argv);  ///< Main Qt application object
+    StartupProfile::mark("application");
     MainWindow w;                ///< Main application window
     w.show();                    ///< Display the main window
     return a.exec();             ///< Enter main event loop
@@ -14,35 +14,179 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     connect(apiClient, &ApiClient::allStationsProcessed, this, &MainWindow::handleStationsData);
     connect(apiClient, &ApiClient::stationDetailsReceived, this, &MainWindow::handleStationDetails);
     connect(apiClient, &ApiClient::sensorDataReceived, this, &MainWindow::handleSensorData);
+    connect(apiClient, &ApiClient::sensorDataReceived, this, [](const SensorSeries &series) {
+        SeriesCache::instance().insert(SeriesCache::sensorKey(series.sensorId()), series);
+    });
     connect(apiClient, &ApiClient::statusChanged, this, &MainWindow::handleStatusChanged);
     connect(apiClient, &ApiClient::errorOccurred, this, &MainWindow::handleApiError);
 
-    // Try to load cached city data first
-    QString cachePath = dbAccess.getAppDataPath() + "/citySearchData.json";
-    if (QFile::exists(cachePath))
+    // Background polling of watched sensors
+    pollScheduler = new PollScheduler(this);
+
+    // Background fetching of sensors likely to be opened next
+    prefetcher = new Prefetcher(this);
+
+    // Searching needs the station index, which is parsed in the background
+    ui->citySearch->setEnabled(false);
+    ui->cityInput->setPlaceholderText("Loading stations...");
+    if (QFile::exists(dbAccess.getAppDataPath() + "/citySearchData.json"))
         makeAutoComplete();
-    else
-        apiClient->getAllStations(); // Fetch fresh data if no cache exists
+
+    StartupProfile::mark("window-constructed");
 }
 
 MainWindow::~MainWindow()
 {
+    startupPool.waitForDone();
     delete ui;
     delete apiClient;
 }
 
+/**
+ * @brief Starts the deferred startup work once the first frame is painted.
+ */
+void MainWindow::paintEvent(QPaintEvent *event)
+{
+    QMainWindow::paintEvent(event);
+    if (firstPaintDone)
+        return;
+    firstPaintDone = true;
+    StartupProfile::mark("first-paint");
+
+    // Let the frame reach the screen first
+    QTimer::singleShot(0, this, &MainWindow::startDeferredWork);
+}
+
+/**
+ * @brief Starts the subsystems the first frame does not need.
+ */
+void MainWindow::startDeferredWork()
+{
+    // Finish store writes cut off by a crash; the first store write waits for it
+    startupPool.start([]() {
+        db::recoverStore();
+        StartupProfile::mark("store-recovered");
+    });
+
+    // Open the API connection now; all clients share it
+    apiClient->preconnect();
+    prefetcher->warmRecentStations();
+
+    // Station sensor lists, kept locally and refreshed in the background
+    catalog = new MetadataCatalog(this);
+    connect(apiClient, &ApiClient::stationDetailsReceived, this, [this](const QJsonObject &details) {
+        catalog->update(details, currentStationId);
+    });
+    syncCatalog();
+
+    // Fetch fresh data if no cache exists
+    if (!QFile::exists(dbAccess.getAppDataPath() + "/citySearchData.json"))
+        requestStations();
+    StartupProfile::mark("services-started");
+
+    QTimer::singleShot(0, this, &MainWindow::warmUpCharts);
+}
+
+/**
+ * @brief Draws a chart off screen so the first sensor chart does not pay
+ * for loading the chart themes, fonts and axis machinery.
+ */
+void MainWindow::warmUpCharts()
+{
+    QLineSeries *line = new QLineSeries();
+    line->append(0, 0);
+    line->append(1, 1);
+    QChart *chart = new QChart();
+    chart->addSeries(line);
+    QDateTimeAxis *axisX = new QDateTimeAxis();
+    QValueAxis *axisY = new QValueAxis();
+    chart->addAxis(axisX, Qt::AlignBottom);
+    chart->addAxis(axisY, Qt::AlignLeft);
+    line->attachAxis(axisX);
+    line->attachAxis(axisY);
+
+    QChartView view(chart);
+    view.setRenderHint(QPainter::Antialiasing);
+    view.resize(320, 240);
+    view.grab();
+    finishStartupStep("charts-ready");
+}
+
+/**
+ * @brief Marks a startup step as done; the last one completes startup.
+ * @details A run started by --startup-bench quits at that point.
+ */
+void MainWindow::finishStartupStep(const QString &milestone)
+{
+    StartupProfile::mark(milestone);
+    if (!pendingStartupSteps.remove(milestone) || !pendingStartupSteps.isEmpty())
+        return;
+    StartupProfile::mark("ready");
+    if (StartupProfile::isBenchmarkRun())
+        QTimer::singleShot(0, qApp, &QCoreApplication::quit);
+}
+
 /**
  * @brief Initializes city search autocomplete
+ * @details The station cache is parsed on startupPool; the result is
+ * installed on the GUI thread by installStations().
  */
 void MainWindow::makeAutoComplete()
 {
-    QString cachePath = dbAccess.getAppDataPath() + "/citySearchData.json";
-    QStringList cityList = dbAccess.loadCityData(cachePath);
+    const QString cachePath = dbAccess.getAppDataPath() + "/citySearchData.json";
+    startupPool.start([this, cachePath]() {
+        StationTable table;
+        GeoIndex index;
+        const bool ok = db::readCityData(cachePath, &table, &index);
+        const QStringList cityList = table.displayNames();
+        StartupProfile::mark("stations-parsed");
+        QMetaObject::invokeMethod(this, [this, ok, table, index, cityList]() {
+            installStations(ok, table, index, cityList);
+        }, Qt::QueuedConnection);
+    });
+}
+
+/**
+ * @brief Makes a parsed station cache current and enables searching.
+ */
+void MainWindow::installStations(bool ok, const StationTable &table, const GeoIndex &index, const QStringList &cityList)
+{
+    // Unreadable cache: fetch the list again, once
+    if (!ok) {
+        if (!stationsRefreshed)
+            requestStations();
+        return;
+    }
+
+    dbAccess.stations = table;
+    dbAccess.geoIndex = index;
+    qDebug() << "Loaded" << table.size() << "stations," << table.memoryUsage() << "bytes";
 
     QCompleter *completer = new QCompleter(cityList, this);
     completer->setCaseSensitivity(Qt::CaseInsensitive);
     completer->setFilterMode(Qt::MatchContains);
     ui->cityInput->setCompleter(completer);
+    ui->cityInput->setPlaceholderText(QString());
+    ui->citySearch->setEnabled(true);
+    finishStartupStep("searchable");
+
+    syncCatalog();
+
+    // Refetch a cache that predates station coordinates
+    if (!stationsRefreshed && !table.isEmpty() && index.isEmpty())
+        requestStations();
+}
+
+/**
+ * @brief Requests the station list from the API.
+ * @details A failure is handled by handleApiError(), which retries while
+ * searching is not possible yet.
+ */
+void MainWindow::requestStations()
+{
+    stationsRefreshed = true;
+    stationsRequestPending = true;
+    apiClient->getAllStations();
 }
 
 /**
@@ -53,13 +197,22 @@ void MainWindow::onCitySearchClicked()
     QString city = ui->cityInput->text();
 
     // Validate city selection
-    if (!dbAccess.idMap.contains(city) || dbAccess.idMap[city] == 0) {
+    const int row = dbAccess.stations.rowForName(city);
+    if (row < 0 || dbAccess.stations.id(row) == 0) {
         ui->resultBrowser->setText("Please select a valid city name!");
         return;
     }
 
-    currentLocation = city;
-    apiClient->getStationDetails(dbAccess.idMap[city]);
+    currentLocation = dbAccess.stations.displayName(row);
+    currentStationId = dbAccess.stations.id(row);
+
+    // Sensor lists rarely change; the catalog's background sync keeps them current
+    if (catalog && catalog->contains(currentStationId)) {
+        handleStationDetails(catalog->stationDetails(currentStationId));
+        ui->resultBrowser->setText("Station sensors loaded from the local catalog");
+        return;
+    }
+    apiClient->getStationDetails(currentStationId);
 }
 
 /**
@@ -68,6 +221,7 @@ void MainWindow::onCitySearchClicked()
  */
 void MainWindow::handleStationsData(const QJsonArray &data)
 {
+    stationsRequestPending = false;
     QFile file(dbAccess.getAppDataPath() + "/citySearchData.json"); // Saves
     if (file.open(QIODevice::WriteOnly)) {
         file.write(QJsonDocument(data).toJson(QJsonDocument::Indented));
@@ -77,6 +231,22 @@ void MainWindow::handleStationsData(const QJsonArray &data)
     makeAutoComplete();
 }
 
+/**
+ * @brief Starts a background refresh of the metadata catalog if it is due.
+ */
+void MainWindow::syncCatalog()
+{
+    // Created after the first paint; startDeferredWork() syncs it then
+    if (!catalog)
+        return;
+    QList<int> ids;
+    for (int id : dbAccess.stations.ids()) {
+        if (id != 0)
+            ids.append(id);
+    }
+    catalog->sync(ids);
+}
+
 /**
  * @brief Processes station details and creates sensor buttons
  * @param details JSON object containing sensor information
@@ -117,17 +287,61 @@ void MainWindow::handleStationDetails(const QJsonObject &details)
         btn->setProperty("sensorId", sensorId);
         btn->setMinimumHeight(40);
 
-        // Connect button to data fetch
+        // Connect button to data fetch; prefetched data is shown without a request
         connect(btn, &QPushButton::clicked, this, [this, btn]() {
+            AllocStats::reset(); // Reported by handleSensorData()
             isFromInternet = true;
-            apiClient->getSensorData(btn->property("sensorId").toInt());
+            const int id = btn->property("sensorId").toInt();
+            SensorSeries cached;
+            if (SeriesCache::instance().find(SeriesCache::sensorKey(id), &cached, Prefetcher::kFreshMs)) {
+                ui->resultBrowser->setText("Loaded from cache");
+                handleSensorData(cached);
+                return;
+            }
+            apiClient->getSensorData(id);
         });
 
         layout->addWidget(btn);
         sensorButtons.append(btn);
     }
 
+    addNearbyStations(layout, container);
     container->adjustSize();
+
+    prefetcher->prefetchStation(currentStationId, sensorsData);
+}
+
+/**
+ * @brief Adds buttons for the stations closest to the current one.
+ * @param layout Layout of the sensor list.
+ * @param container Widget owning the buttons.
+ * @details Clicking a button searches that station instead.
+ */
+void MainWindow::addNearbyStations(QVBoxLayout *layout, QWidget *container)
+{
+    const StationTable &stations = dbAccess.stations;
+    const int self = stations.rowForName(currentLocation);
+    if (self < 0 || qIsNaN(stations.latitude(self)) || dbAccess.geoIndex.isEmpty())
+        return;
+
+    layout->addWidget(new QLabel("Nearby stations:", container)); // Deleted by clearSensorButtons()
+
+    const QVector<GeoIndex::Hit> hits =
+        dbAccess.geoIndex.nearest(stations.latitude(self), stations.longitude(self), kNearbyCount + 1);
+    for (const GeoIndex::Hit &hit : hits) {
+        if (hit.station == self)
+            continue;
+
+        const QString name = stations.displayName(hit.station);
+        QPushButton *btn = new QPushButton(QString("%1 (%2 km)").arg(name).arg(hit.distanceKm, 0, 'f', 1),
+                                           container);
+        connect(btn, &QPushButton::clicked, this, [this, name]() {
+            ui->cityInput->setText(name);
+            onCitySearchClicked();
+        });
+        layout->addWidget(btn);
+        sensorButtons.append(btn);
+    }
 }
 
 /**
@@ -156,78 +370,61 @@ void MainWindow::clearSensorButtons()
 
 /**
  * @brief Processes and visualizes sensor data.
- * @param data JSON object containing sensor measurements.
+ * @param received Sensor measurements.
  * @details Creates an interactive chart with time range sliders and statistics.
+ * Points flagged by QualityDetector are left out of the statistics and the
+ * chart unless the user includes them.
  */
-void MainWindow::handleSensorData(const QJsonObject &data)
+void MainWindow::handleSensorData(const SensorSeries &received)
 {
     // Clear previous visualization
     QWidget *oldWidget = ui->resultScrollArea->takeWidget();
     delete oldWidget;
 
-    if (!data.contains("values")) {
-        qWarning() << "Missing values in sensor data";
-        return;
+    // Readings fresh from the API have not been checked yet
+    SensorSeries series = received;
+    if (!series.hasFlags()) {
+        AllocStats::Scope stats(AllocStats::Stats);
+        QualityDetector::annotate(series);
     }
 
-    QJsonArray values = data["values"].toArray();
-    if (values.isEmpty()) {
+    if (series.isEmpty()) {
         qWarning() << "Empty values array";
         return;
     }
 
     // Initialize chart components
+    AllocStats::Scope chartScope(AllocStats::Chart);
     QChart *chart = new QChart();
-    QLineSeries *series = new QLineSeries();
-    QLineSeries *fullSeries = new QLineSeries();
-    QString paramName = data["key"].toString();
+    QLineSeries *lineSeries = new QLineSeries();
+    QString paramName = series.key();
 
     // Initialize statistics tracking
     double minValue = 99999;
     double maxValue = -99999;
-    double sum = 0;
+    double minUsable = 99999;   // Unflagged points only
+    double maxUsable = -99999;
     int validCount = 0;
-    QDateTime minDate, maxDate;
-
-    // Process each measurement point
-    for (const QJsonValue &value : values) {
-        QJsonObject measurement = value.toObject();
+    qint32 minTime = 0, maxTime = 0;
 
-        // Parse values
-        double val = 0;
-        bool validValue = false;
-        QJsonValue valueJson = measurement["value"];
+    // Process each measurement point; stored series are read from the mapped segment
+    const ColumnSpan<qint32> times = series.timestamps();
+    const ColumnSpan<float> values = series.values();
+    for (int i = 0; i < series.size(); ++i) {
+        if (!series.isValid(i)) continue;
 
-        if (valueJson.isString()) {
-            QString valueStr = valueJson.toString();
-            if (valueStr != "null") {
-                val = valueStr.toDouble(&validValue);
-            }
-        } else if (valueJson.isDouble()) {
-            val = valueJson.toDouble();
-            validValue = true;
-        }
-
-        if (!validValue) continue;
-
-        // Parse timestamp
-        QDateTime dateTime = QDateTime::fromString(measurement["date"].toString(), "yyyy-MM-dd HH:mm:ss");
-        if (!dateTime.isValid()) continue;
-
-        // Add point to series
-        QPointF point(dateTime.toMSecsSinceEpoch(), val);
-        series->append(point);
-        fullSeries->append(point);
-
-        // Update statistics
+        double val = values[i];
         minValue = qMin(minValue, val);
         maxValue = qMax(maxValue, val);
-        sum += val;
-        validCount++;
+        if (series.flags(i) == 0) {
+            minUsable = qMin(minUsable, val);
+            maxUsable = qMax(maxUsable, val);
+        }
 
-        // Update date range
-        if (!minDate.isValid() || dateTime < minDate) minDate = dateTime;
-        if (!maxDate.isValid() || dateTime > maxDate) maxDate = dateTime;
+        // Points are sorted, so the first and last valid ones bound the range
+        if (validCount == 0) minTime = times[i];
+        maxTime = times[i];
+        validCount++;
     }
 
     if (validCount == 0) {
@@ -235,6 +432,9 @@ void MainWindow::handleSensorData(const QJsonObject &data)
         return;
     }
 
+    QDateTime minDate = QDateTime::fromSecsSinceEpoch(minTime);
+    QDateTime maxDate = QDateTime::fromSecsSinceEpoch(maxTime);
+
     // Create time range sliders
     QWidget *sliderContainer = new QWidget();
     QVBoxLayout *sliderLayout = new QVBoxLayout(sliderContainer);
@@ -248,9 +448,22 @@ void MainWindow::handleSensorData(const QJsonObject &data)
     startSlider->setValue(0);
     endSlider->setValue(100);
 
+    QCheckBox *excludeFlagged = new QCheckBox("Exclude flagged data");
+    excludeFlagged->setChecked(true);
+
     sliderLayout->addWidget(sliderLabel);
     sliderLayout->addWidget(startSlider);
     sliderLayout->addWidget(endSlider);
+    sliderLayout->addWidget(excludeFlagged);
+
+    // Flagged points before each index, so any range is counted in O(1)
+    QVector<int> flaggedBefore;
+    {
+        AllocStats::Scope stats(AllocStats::Stats);
+        flaggedBefore.fill(0, series.size() + 1);
+        for (int i = 0; i < series.size(); ++i)
+            flaggedBefore[i + 1] = flaggedBefore[i] + (series.isValid(i) && series.flags(i) != 0);
+    }
 
     // Configure chart axes
     QDateTimeAxis *axisX = new QDateTimeAxis();
@@ -258,16 +471,16 @@ void MainWindow::handleSensorData(const QJsonObject &data)
     axisX->setTitleText("Time");
     axisX->setRange(minDate, maxDate);
 
+    // The value range depends on "Exclude flagged data"; updateChart() sets it
     QValueAxis *axisY = new QValueAxis();
     axisY->setTitleText(paramName + " (µg/m³)");
-    axisY->setRange(minValue > 0 ? 0 : minValue * 1.1, maxValue * 1.1);
 
     // Assemble chart
-    chart->addSeries(series);
+    chart->addSeries(lineSeries);
     chart->addAxis(axisX, Qt::AlignBottom);
     chart->addAxis(axisY, Qt::AlignLeft);
-    series->attachAxis(axisX);
-    series->attachAxis(axisY);
+    lineSeries->attachAxis(axisX);
+    lineSeries->attachAxis(axisY);
     chart->legend()->hide();
     chart->setTitle(paramName + " Measurements");
     chart->setAnimationOptions(QChart::SeriesAnimations);
@@ -276,6 +489,19 @@ void MainWindow::handleSensorData(const QJsonObject &data)
     QChartView *chartView = new QChartView(chart);
     chartView->setRenderHint(QPainter::Antialiasing);
 
+    // Summary tiles for long ranges; stored data shares the store's pyramid.
+    // Its tiles never contain flagged points; tiles that do are built from
+    // this series when "Exclude flagged data" is cleared.
+    TilePyramid pyramid;
+    {
+        AllocStats::Scope stats(AllocStats::Stats);
+        if (!isFromInternet && !series.location().isEmpty())
+            pyramid = dbAccess.loadPyramid(series.location(), series.key());
+        if (pyramid.isEmpty() || pyramid.firstTimestamp() > minTime || pyramid.lastTimestamp() < maxTime)
+            pyramid.insert(series);
+    }
+    QSharedPointer<TilePyramid> flaggedPyramid(new TilePyramid());
+
     // Create main container
     QWidget *container = new QWidget();
     QVBoxLayout *layout = new QVBoxLayout(container);
@@ -292,48 +518,78 @@ void MainWindow::handleSensorData(const QJsonObject &data)
         // Validate slider positions
         if (startPercent > endPercent) return;
 
+        // Scale to the points that can be drawn; flagged outliers would squash the rest
+        const bool exclude = excludeFlagged->isChecked();
+        if (exclude && minUsable <= maxUsable)
+            axisY->setRange(minUsable > 0 ? 0 : minUsable * 1.1, maxUsable * 1.1);
+        else
+            axisY->setRange(minValue > 0 ? 0 : minValue * 1.1, maxValue * 1.1);
+
         // Calculate time range
-        qint64 totalSpan = minDate.secsTo(maxDate);
-        QDateTime startTime = minDate.addSecs(totalSpan * startPercent / 100);
-        QDateTime endTime = minDate.addSecs(totalSpan * endPercent / 100);
-
-        // Filter points within time range
-        QLineSeries *filtered = new QLineSeries();
-        for (const QPointF &point : fullSeries->points()) {
-            QDateTime t = QDateTime::fromMSecsSinceEpoch(point.x());
-            if (t >= startTime && t <= endTime) {
-                filtered->append(point);
-            }
-        }
+        qint64 totalSpan = qint64(maxTime) - minTime;
+        qint32 startTime = qint32(minTime + totalSpan * startPercent / 100);
+        qint32 endTime = qint32(minTime + totalSpan * endPercent / 100);
+
+        // Collect points within time range
+        QList<QPointF> points;
+        int begin = series.lowerBound(startTime);
+        int end = series.upperBound(endTime);
 
         // Calculate filtered statistics
         QString trendText = "Not enough data";
         double filteredMin = 99999;
         double filteredMax = -99999;
         double filteredSum = 0;
-        int filteredCount = filtered->count();
-
-        if (filteredCount >= 1) {
-            for (const QPointF &point : filtered->points()) {
-                double y = point.y();
+        qint64 filteredCount = 0;
+
+        const int width = qMax(chartView->width(), kMinChartTiles);
+        if (end - begin <= width) {
+            // Few enough points to draw them all
+            points.reserve(end - begin);
+            for (int i = begin; i < end; ++i) {
+                if (!series.isValid(i)) continue;
+                if (series.flags(i) != 0 && exclude) continue;
+                double y = series.value(i);
+                points.append(QPointF(qreal(series.timestamp(i)) * 1000, y));
                 filteredMin = qMin(filteredMin, y);
                 filteredMax = qMax(filteredMax, y);
                 filteredSum += y;
             }
+            filteredCount = points.size();
+        } else {
+            if (!exclude && flaggedPyramid->isEmpty()) {
+                AllocStats::Scope stats(AllocStats::Stats);
+                for (int i = 0; i < series.size(); ++i) {
+                    if (series.isValid(i))
+                        flaggedPyramid->insert(series.timestamp(i), series.value(i));
+                }
+            }
 
-            // Determine trend if enough points
-            if (filteredCount >= 2) {
-                double first = filtered->at(0).y();
-                double last = filtered->at(filteredCount - 1).y();
-                double delta = last - first;
-
-                if (qAbs(delta) < 0.1 * qAbs(first))
-                    trendText = "Stable";
-                else
-                    trendText = (delta > 0) ? "Falling trend" : "Rising trend";
+            // One tile per pixel; each drawn at its bucket centre with its mean
+            const TilePyramid &source = exclude ? pyramid : *flaggedPyramid;
+            const QVector<TilePyramid::Span> spans = source.tiles(startTime, endTime, width);
+            points.reserve(spans.size());
+            for (const TilePyramid::Span &span : spans) {
+                points.append(QPointF(qreal(span.start + span.seconds / 2) * 1000, span.tile.mean()));
+                filteredMin = qMin(filteredMin, double(span.tile.min));
+                filteredMax = qMax(filteredMax, double(span.tile.max));
+                filteredSum += span.tile.sum;
+                filteredCount += span.tile.count;
             }
         }
 
+        // Determine trend if enough points
+        if (points.size() >= 2) {
+            double oldest = points.first().y();
+            double newest = points.last().y();
+            double delta = newest - oldest;
+
+            if (qAbs(delta) < 0.1 * qAbs(newest))
+                trendText = "Stable";
+            else
+                trendText = (delta > 0) ? "Rising trend" : "Falling trend";
+        }
+
         // Update statistics display
         statsLabel->setText(
             QString("<b>Location:</b> %1<br>"
@@ -342,20 +598,20 @@ void MainWindow::handleSensorData(const QJsonObject &data)
                     "<b>Maximum:</b> %4 µg/m³<br>"
                     "<b>Average:</b> %5 µg/m³<br>"
                     "<b>Measurements:</b> %6<br>"
-                    "<b>Trend:</b> %7")
+                    "<b>Flagged:</b> %7<br>"
+                    "<b>Trend:</b> %8")
                 .arg(currentLocation.isEmpty() ? "Unknown" : currentLocation)
                 .arg(paramName)
                 .arg(filteredMin, 0, 'f', 1)
                 .arg(filteredMax, 0, 'f', 1)
                 .arg(filteredCount > 0 ? filteredSum / filteredCount : 0.0, 0, 'f', 1)
-                .arg(filteredCount).arg(trendText)
+                .arg(filteredCount)
+                .arg(flaggedBefore[end] - flaggedBefore[begin])
+                .arg(trendText)
             );
 
         // Update chart display
-        chart->removeAllSeries();
-        chart->addSeries(filtered);
-        filtered->attachAxis(axisX);
-        filtered->attachAxis(axisY);
+        lineSeries->replace(points);
     };
 
     // Connect slider signals
@@ -371,6 +627,8 @@ void MainWindow::handleSensorData(const QJsonObject &data)
         updateChart();
     });
 
+    connect(excludeFlagged, &QCheckBox::toggled, this, updateChart);
+
     // Initial update
     updateChart();
 
@@ -386,14 +644,53 @@ void MainWindow::handleSensorData(const QJsonObject &data)
         layout->addWidget(saveButton);
 
         connect(saveButton, &QPushButton::clicked, this, [=]() {
-            dbAccess.saveSensorData(data, currentLocation);
+            SensorSeries located = series;
+            located.setLocation(currentLocation);
+            AllocStats::reset();
+            dbAccess.saveSensorData(located);
+            AllocStats::report(QString("saving sensor %1").arg(series.sensorId()));
             QMessageBox::information(this, "Saved", "Data has been saved to local database.");
         });
+
+        // Keep the sensor up to date in the background
+        if (series.sensorId() != 0) {
+            const int sensorId = series.sensorId();
+            QPushButton *watchButton = new QPushButton();
+            watchButton->setCheckable(true);
+            watchButton->setChecked(pollScheduler->isWatched(sensorId));
+            watchButton->setText(watchButton->isChecked() ? "Watching hourly" : "Watch hourly");
+            layout->addWidget(watchButton);
+
+            connect(watchButton, &QPushButton::toggled, this, [=](bool checked) {
+                if (checked)
+                    pollScheduler->watch(sensorId, currentLocation, series.key());
+                else
+                    pollScheduler->unwatch(sensorId);
+                watchButton->setText(checked ? "Watching hourly" : "Watch hourly");
+            });
+        }
+    }
+
+    // Follow the sensor as new readings are stored
+    if (series.sensorId() != 0) {
+        QPushButton *liveButton = new QPushButton("Open live chart");
+        layout->addWidget(liveButton);
+
+        connect(liveButton, &QPushButton::clicked, this, [=]() {
+            if (!liveWindow) {
+                liveWindow = new LiveChartWindow(pollScheduler, this);
+                liveWindow->setWindowFlag(Qt::Window, true);
+            }
+            liveWindow->addSensor(series, series.location().isEmpty() ? currentLocation : series.location());
+            liveWindow->show();
+            liveWindow->raise();
+        });
     }
 
     // Display the complete widget
     ui->resultScrollArea->setWidget(container);
     container->adjustSize();
+    AllocStats::report(QString("sensor %1").arg(series.sensorId()));
 }
 
 /**
@@ -402,6 +699,18 @@ void MainWindow::handleSensorData(const QJsonObject &data)
  */
 void MainWindow::handleApiError(const QString &error)
 {
+    // Without a station list nothing can be searched: keep trying
+    if (stationsRequestPending) {
+        stationsRequestPending = false;
+        if (!ui->citySearch->isEnabled()) {
+            ui->cityInput->setPlaceholderText("Station list unavailable, retrying...");
+            ui->resultBrowser->setText("Could not load the station list: " + error
+                                       + " Retrying in " + QString::number(kStationsRetryMs / 1000)
+                                       + " s. Downloaded data can still be browsed.");
+            QTimer::singleShot(kStationsRetryMs, this, &MainWindow::requestStations);
+            return;
+        }
+    }
     ui->resultBrowser->setText(error + " Try again! Or check already downloaded data.");
 }
 
@@ -434,13 +743,13 @@ void MainWindow::on_dbOpener_clicked()
 
 /**
  * @brief Handles loading data from local database.
- * @param data JSON data loaded from file.
- * @param location Location name associated with the data.
+ * @param series Series loaded from file, tagged with its location.
  */
-void MainWindow::handleLoadDb(const QJsonObject &data, QString location)
+void MainWindow::handleLoadDb(const SensorSeries &series)
 {
+    AllocStats::reset(); // Reported by handleSensorData()
     isFromInternet = false; // Mark as local data source
     ui->resultBrowser->setText("Loaded from local database");
-    currentLocation = location;
-    handleSensorData(data); // Process like API data
+    currentLocation = series.location();
+    handleSensorData(series); // Process like API data
 }
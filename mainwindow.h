@@ -22,10 +22,22 @@
 #include <QLineSeries>
 #include <QValueAxis>
 #include <QDateTimeAxis>
+#include <QCheckBox>
 #include <QtMath>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
+#include "./allocstats.h"
 #include "./apiClient.h"
 #include "./db.h"
 #include "./dbwindow.h"
+#include "./pollscheduler.h"
+#include "./prefetcher.h"
+#include "./metadatacatalog.h"
+#include "./qualitydetector.h"
+#include "./seriescache.h"
+#include "./livechart.h"
+#include "./startupprofile.h"
 
 
 QT_BEGIN_NAMESPACE
@@ -40,14 +52,17 @@ class MainWindow : public QMainWindow
 
 public:
     MainWindow(QWidget *parent = nullptr);
-    void handleLoadDb(const QJsonObject &data, QString location);
+    void handleLoadDb(const SensorSeries &series);
     ~MainWindow();
 
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
 private slots:
     void onCitySearchClicked();
     void handleStationsData(const QJsonArray &data);
     void handleStationDetails(const QJsonObject &details);
-    void handleSensorData(const QJsonObject &data);
+    void handleSensorData(const SensorSeries &series);
     void handleApiError(const QString &error);
     void handleStatusChanged(const QString &status);
 
@@ -58,12 +73,35 @@ private:
     Ui::MainWindow *ui;
     QVector<QPushButton*> sensorButtons;
     ApiClient *apiClient;
+    PollScheduler *pollScheduler;
+    LiveChartWindow *liveWindow = nullptr;
+    Prefetcher *prefetcher;
+    MetadataCatalog *catalog = nullptr;
     QChartView *chartView = nullptr;
     QString currentLocation;
+    int currentStationId = 0;
     db dbAccess;
     bool isFromInternet;
 
+    // Startup; see startDeferredWork()
+    QThreadPool startupPool; ///< Parses the station cache off the GUI thread
+    bool firstPaintDone = false;
+    bool stationsRefreshed = false; ///< Station list requested from the API
+    bool stationsRequestPending = false; ///< A station list request is in flight
+    QSet<QString> pendingStartupSteps = { "searchable", "charts-ready" };
+
     void makeAutoComplete();
+    void installStations(bool ok, const StationTable &table, const GeoIndex &index, const QStringList &cityList);
+    void requestStations();
+    void startDeferredWork();
+    void warmUpCharts();
+    void finishStartupStep(const QString &milestone);
     void clearSensorButtons();
+    void addNearbyStations(QVBoxLayout *layout, QWidget *container);
+    void syncCatalog();
+
+    static const int kNearbyCount = 5; ///< Nearby stations offered per selection
+    static const int kStationsRetryMs = 30000; ///< Delay before retrying a failed station list request
+    static const int kMinChartTiles = 200; ///< Resolution used before the chart has its final width
 };
 #endif // MAINWINDOW_H
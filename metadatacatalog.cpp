@@ -0,0 +1,340 @@
+/**
+ * @file metadatacatalog.cpp
+ * @brief Implementation of the station metadata catalog.
+ */
+
+#include "metadatacatalog.h"
+#include "apiclient.h"
+#include "db.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+QString snapshotPath()
+{
+    return db::getAppDataPath() + "/sensorCatalog.json";
+}
+
+QString journalPath()
+{
+    return db::getAppDataPath() + "/sensorCatalog.journal";
+}
+}
+
+/**
+ * @brief Implementation of Sensor::operator==().
+ */
+bool MetadataCatalog::Sensor::operator==(const Sensor &other) const
+{
+    return id == other.id && stationId == other.stationId && paramId == other.paramId
+           && paramCode == other.paramCode && paramName == other.paramName && paramFormula == other.paramFormula;
+}
+
+/**
+ * @brief Constructs the catalog; the API client is created on the first sync.
+ */
+MetadataCatalog::MetadataCatalog(QObject *parent)
+    : QObject(parent)
+{
+    load();
+}
+
+/**
+ * @brief Implementation of sensorsForParameter().
+ */
+QVector<MetadataCatalog::Sensor> MetadataCatalog::sensorsForParameter(const QString &paramCode) const
+{
+    QVector<Sensor> result;
+    for (int stationId : m_stationsByParam.value(paramCode)) {
+        for (const Sensor &sensor : m_stations.value(stationId)) {
+            if (sensor.paramCode == paramCode)
+                result.append(sensor);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const Sensor &a, const Sensor &b) { return a.id < b.id; });
+    return result;
+}
+
+/**
+ * @brief Implementation of stationDetails().
+ */
+QJsonObject MetadataCatalog::stationDetails(int stationId) const
+{
+    QJsonObject details;
+    details["data"] = sensorsToJson(m_stations.value(stationId));
+    return details;
+}
+
+/**
+ * @brief Implementation of update().
+ */
+bool MetadataCatalog::update(const QJsonObject &details, int stationId)
+{
+    const QVector<Sensor> sensors = sensorsFromJson(details["data"].toArray(), stationId);
+    if (stationId == 0 && !sensors.isEmpty())
+        stationId = sensors.first().stationId;
+    if (stationId == 0)
+        return false;
+
+    auto it = m_stations.constFind(stationId);
+    if (it != m_stations.cend() && *it == sensors)
+        return false;
+
+    setStation(stationId, sensors);
+    QJsonObject line;
+    line["station"] = stationId;
+    line["sensors"] = sensorsToJson(sensors);
+    appendJournal(line);
+    qDebug() << "Catalog updated station" << stationId << "-" << sensors.size() << "sensors";
+    return true;
+}
+
+/**
+ * @brief Implementation of sync().
+ */
+void MetadataCatalog::sync(const QList<int> &stationIds, bool force)
+{
+    if (isSyncing() || stationIds.isEmpty())
+        return;
+    if (!force && QDateTime::currentMSecsSinceEpoch() - m_lastSyncMs < kSyncIntervalMs)
+        return;
+
+    if (!m_api) {
+        m_api = new ApiClient(this);
+        connect(m_api, &ApiClient::stationDetailsReceived, this, &MetadataCatalog::handleStationDetails);
+        connect(m_api, &ApiClient::errorOccurred, this, &MetadataCatalog::handleError);
+    }
+
+    m_syncStations = stationIds;
+    m_pending.clear();
+    for (int stationId : stationIds)
+        m_pending.enqueue(stationId);
+    m_syncTotal = m_pending.size();
+    m_syncChanged = 0;
+    qDebug() << "Catalog sync of" << m_syncTotal << "stations started";
+    fetchNext();
+}
+
+/**
+ * @brief Requests the next station of the sync, or completes the sync.
+ * @details Stations missing from the network's station list are dropped
+ * only at the end, so an interrupted sync never loses data.
+ */
+void MetadataCatalog::fetchNext()
+{
+    if (!m_pending.isEmpty()) {
+        m_current = m_pending.dequeue();
+        m_api->getStationDetails(m_current, QNetworkRequest::LowPriority);
+        return;
+    }
+
+    const QSet<int> listed(m_syncStations.cbegin(), m_syncStations.cend());
+    const QList<int> known = m_stations.keys();
+    for (int stationId : known) {
+        if (!listed.contains(stationId)) {
+            removeStation(stationId);
+            QJsonObject line;
+            line["station"] = stationId;
+            line["removed"] = true;
+            appendJournal(line);
+            m_syncChanged++;
+        }
+    }
+
+    m_lastSyncMs = QDateTime::currentMSecsSinceEpoch();
+    QJsonObject line;
+    line["syncedMs"] = m_lastSyncMs;
+    appendJournal(line);
+
+    const int changed = m_syncChanged;
+    qDebug() << "Catalog sync finished -" << changed << "of" << m_syncTotal << "stations changed";
+    m_current = 0;
+    m_syncTotal = 0;
+    m_syncStations.clear();
+    emit syncFinished(changed);
+}
+
+/**
+ * @brief Stores a synced station and moves on.
+ */
+void MetadataCatalog::handleStationDetails(const QJsonObject &details)
+{
+    if (update(details, m_current))
+        m_syncChanged++;
+    emit syncProgress(m_syncTotal - m_pending.size(), m_syncTotal);
+    fetchNext();
+}
+
+/**
+ * @brief Keeps a station's previous list when its request fails.
+ */
+void MetadataCatalog::handleError(const QString &error)
+{
+    qDebug() << "Catalog sync of station" << m_current << "failed:" << error;
+    emit syncProgress(m_syncTotal - m_pending.size(), m_syncTotal);
+    fetchNext();
+}
+
+/**
+ * @brief Loads the snapshot and applies the journal.
+ */
+void MetadataCatalog::load()
+{
+    QFile snapshot(snapshotPath());
+    if (snapshot.open(QIODevice::ReadOnly)) {
+        const QJsonObject root = QJsonDocument::fromJson(snapshot.readAll()).object();
+        m_lastSyncMs = qint64(root["syncedMs"].toDouble());
+        const QJsonObject stations = root["stations"].toObject();
+        for (auto it = stations.begin(); it != stations.end(); ++it) {
+            const int stationId = it.key().toInt();
+            if (stationId != 0)
+                setStation(stationId, sensorsFromJson(it.value().toArray(), stationId));
+        }
+    }
+
+    QFile journal(journalPath());
+    if (journal.open(QIODevice::ReadOnly)) {
+        while (!journal.atEnd()) {
+            const QByteArray text = journal.readLine();
+            if (!text.endsWith('\n'))
+                break; // Torn by a crash; the next sync rewrites it
+            const QJsonObject line = QJsonDocument::fromJson(text).object();
+            const int stationId = line["station"].toInt();
+            if (line.contains("syncedMs"))
+                m_lastSyncMs = qint64(line["syncedMs"].toDouble());
+            else if (stationId != 0 && line["removed"].toBool())
+                removeStation(stationId);
+            else if (stationId != 0)
+                setStation(stationId, sensorsFromJson(line["sensors"].toArray(), stationId));
+            m_journalLines++;
+        }
+    }
+
+    qDebug() << "Catalog loaded:" << m_stations.size() << "stations," << m_journalLines << "journal lines";
+    if (m_journalLines > kCompactLines)
+        compact();
+}
+
+/**
+ * @brief Writes a new snapshot and empties the journal.
+ * @details A crash between the two steps replays the journal onto the new
+ * snapshot, which gives the same catalog.
+ */
+void MetadataCatalog::compact()
+{
+    QJsonObject stations;
+    for (auto it = m_stations.cbegin(); it != m_stations.cend(); ++it)
+        stations[QString::number(it.key())] = sensorsToJson(it.value());
+
+    QJsonObject root;
+    root["syncedMs"] = m_lastSyncMs;
+    root["stations"] = stations;
+
+    QSaveFile snapshot(snapshotPath());
+    const QByteArray data = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    if (!snapshot.open(QIODevice::WriteOnly) || snapshot.write(data) != data.size() || !snapshot.commit()) {
+        qWarning() << "Could not write the sensor catalog";
+        return;
+    }
+    QFile::resize(journalPath(), 0);
+    m_journalLines = 0;
+}
+
+/**
+ * @brief Appends one change to the journal with a single write.
+ */
+void MetadataCatalog::appendJournal(const QJsonObject &line)
+{
+    QFile journal(journalPath());
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Append)
+        || journal.write(QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n') < 0) {
+        qWarning() << "Could not append to the sensor catalog";
+        return;
+    }
+    if (++m_journalLines > kCompactLines)
+        compact();
+}
+
+/**
+ * @brief Replaces a station's sensors and its entries in the parameter index.
+ */
+void MetadataCatalog::setStation(int stationId, const QVector<Sensor> &sensors)
+{
+    removeStation(stationId);
+    m_stations.insert(stationId, sensors);
+    for (const Sensor &sensor : sensors) {
+        QVector<int> &stations = m_stationsByParam[sensor.paramCode];
+        if (!stations.contains(stationId))
+            stations.append(stationId);
+    }
+}
+
+/**
+ * @brief Removes a station and its entries in the parameter index.
+ */
+void MetadataCatalog::removeStation(int stationId)
+{
+    auto it = m_stations.find(stationId);
+    if (it == m_stations.end())
+        return;
+    for (const Sensor &sensor : std::as_const(*it)) {
+        auto param = m_stationsByParam.find(sensor.paramCode);
+        if (param != m_stationsByParam.end()) {
+            param->removeAll(stationId);
+            if (param->isEmpty())
+                m_stationsByParam.erase(param);
+        }
+    }
+    m_stations.erase(it);
+}
+
+/**
+ * @brief Parses sensors in the layout of the station details response.
+ * @param stationId Used for sensors without a "stationId" field.
+ */
+QVector<MetadataCatalog::Sensor> MetadataCatalog::sensorsFromJson(const QJsonArray &data, int stationId)
+{
+    QVector<Sensor> sensors;
+    sensors.reserve(data.size());
+    for (const QJsonValue &value : data) {
+        const QJsonObject object = value.toObject();
+        const QJsonObject param = object["param"].toObject();
+        Sensor sensor;
+        sensor.id = object["id"].toInt();
+        sensor.stationId = object.contains("stationId") ? object["stationId"].toInt() : stationId;
+        sensor.paramId = param["idParam"].toInt();
+        sensor.paramCode = SensorSeries::intern(param["paramCode"].toString());
+        sensor.paramName = param["paramName"].toString();
+        sensor.paramFormula = param["paramFormula"].toString();
+        if (sensor.id != 0)
+            sensors.append(sensor);
+    }
+    std::sort(sensors.begin(), sensors.end(), [](const Sensor &a, const Sensor &b) { return a.id < b.id; });
+    return sensors;
+}
+
+/**
+ * @brief Writes sensors in the layout of the station details response.
+ */
+QJsonArray MetadataCatalog::sensorsToJson(const QVector<Sensor> &sensors)
+{
+    QJsonArray data;
+    for (const Sensor &sensor : sensors) {
+        QJsonObject param;
+        param["idParam"] = sensor.paramId;
+        param["paramCode"] = sensor.paramCode;
+        param["paramName"] = sensor.paramName;
+        param["paramFormula"] = sensor.paramFormula;
+
+        QJsonObject object;
+        object["id"] = sensor.id;
+        object["stationId"] = sensor.stationId;
+        object["param"] = param;
+        data.append(object);
+    }
+    return data;
+}
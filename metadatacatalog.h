@@ -0,0 +1,156 @@
+/**
+ * @file metadatacatalog.h
+ * @brief Local catalog of the sensors of every station.
+ */
+
+#ifndef METADATACATALOG_H
+#define METADATACATALOG_H
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QQueue>
+#include <QVector>
+
+class ApiClient;
+
+/**
+ * @class MetadataCatalog
+ * @brief Sensor lists and parameter codes of all stations, available offline.
+ *
+ * Station sensor lists change rarely, so they are kept locally and the
+ * station details request is only needed for stations the catalog has not
+ * seen. sync() refreshes the whole network in the background, one request
+ * at a time at low priority on its own ApiClient, at most once per
+ * kSyncIntervalMs.
+ *
+ * Each fetched list is compared with the stored one and only changed
+ * stations are written, as one line each appended to
+ * AppDataLocation/sensorCatalog.journal. load() applies the journal on top
+ * of the snapshot in sensorCatalog.json and folds it into a new snapshot
+ * once it has grown past kCompactLines.
+ */
+class MetadataCatalog : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Sensor as listed by the station details request.
+     */
+    struct Sensor {
+        int id = 0;
+        int stationId = 0;
+        int paramId = 0;
+        QString paramCode;    ///< e.g. "PM2.5"; interned
+        QString paramName;    ///< e.g. "pył zawieszony PM2.5"
+        QString paramFormula;
+
+        bool operator==(const Sensor &other) const;
+        bool operator!=(const Sensor &other) const { return !(*this == other); }
+    };
+
+    static const qint64 kSyncIntervalMs = 7 * 24 * 3600 * 1000LL; ///< Age of a full sync that triggers the next one
+    static const int kCompactLines = 500;                          ///< Journal lines before a new snapshot
+
+    /**
+     * @brief Constructs the catalog and loads it from disk.
+     * @param parent Parent QObject (optional).
+     */
+    explicit MetadataCatalog(QObject *parent = nullptr);
+
+    /**
+     * @brief Whether a station's sensor list is known.
+     */
+    bool contains(int stationId) const { return m_stations.contains(stationId); }
+
+    /**
+     * @brief Number of stations in the catalog.
+     */
+    int stationCount() const { return m_stations.size(); }
+
+    /**
+     * @brief Sensors of a station, ordered by sensor ID.
+     */
+    QVector<Sensor> sensors(int stationId) const { return m_stations.value(stationId); }
+
+    /**
+     * @brief Sensors measuring a parameter, across all stations.
+     * @param paramCode Parameter code, e.g. "PM2.5".
+     */
+    QVector<Sensor> sensorsForParameter(const QString &paramCode) const;
+
+    /**
+     * @brief A station's sensors in the layout of the station details response.
+     * @return QJsonObject {"data": [...]}, as emitted by ApiClient::stationDetailsReceived().
+     */
+    QJsonObject stationDetails(int stationId) const;
+
+    /**
+     * @brief Stores a station details response.
+     * @param details {"data": [...]} as emitted by ApiClient::stationDetailsReceived().
+     * @param stationId Station the response belongs to; taken from the sensors when 0.
+     * @return bool True if the station was new or its sensors changed.
+     */
+    bool update(const QJsonObject &details, int stationId = 0);
+
+    /**
+     * @brief Time of the last completed full sync, epoch ms (0 if never).
+     */
+    qint64 lastSyncMs() const { return m_lastSyncMs; }
+
+    /**
+     * @brief Refreshes every station in the background.
+     * @param stationIds All stations of the network; stations not listed are dropped at the end.
+     * @param force Sync even if the last full sync is recent.
+     */
+    void sync(const QList<int> &stationIds, bool force = false);
+
+    /**
+     * @brief Whether a sync is running.
+     */
+    bool isSyncing() const { return m_syncTotal > 0; }
+
+signals:
+    /**
+     * @brief Emitted after each station of a sync.
+     */
+    void syncProgress(int done, int total);
+
+    /**
+     * @brief Emitted when a sync has gone through all stations.
+     * @param changed Stations that were added, changed or removed.
+     */
+    void syncFinished(int changed);
+
+private slots:
+    void handleStationDetails(const QJsonObject &details);
+    void handleError(const QString &error);
+
+private:
+    QHash<int, QVector<Sensor>> m_stations;
+    QHash<QString, QVector<int>> m_stationsByParam; ///< Parameter code -> station IDs
+    qint64 m_lastSyncMs = 0;
+    int m_journalLines = 0;
+
+    ApiClient *m_api = nullptr; ///< Created by the first sync
+    QQueue<int> m_pending;
+    QList<int> m_syncStations;
+    int m_current = 0;
+    int m_syncTotal = 0;
+    int m_syncChanged = 0;
+
+    void load();
+    void compact();
+    void appendJournal(const QJsonObject &line);
+    void setStation(int stationId, const QVector<Sensor> &sensors);
+    void removeStation(int stationId);
+    void fetchNext();
+
+    static QVector<Sensor> sensorsFromJson(const QJsonArray &data, int stationId);
+    static QJsonArray sensorsToJson(const QVector<Sensor> &sensors);
+};
+
+#endif // METADATACATALOG_H
@@ -0,0 +1,329 @@
+/**
+ * @file pollscheduler.cpp
+ * @brief Implementation of the incremental polling scheduler.
+ */
+
+#include "pollscheduler.h"
+#include "apiclient.h"
+#include "db.h"
+#include <QDateTime>
+#include <QSaveFile>
+#include <limits>
+
+namespace {
+const qint64 kRetryMs = 15 * 60 * 1000;  ///< Delay before re-polling a sensor without new data
+const int kFlushDelayMs = 2000;          ///< Writes arriving within this delay share a commit
+}
+
+/**
+ * @brief Constructs the scheduler with its own API client.
+ * @details A separate client keeps background responses away from the
+ * main window's handlers.
+ */
+PollScheduler::PollScheduler(QObject *parent)
+    : QObject(parent)
+    , m_api(new ApiClient(this))
+{
+    connect(m_api, &ApiClient::sensorDataReceived, this, &PollScheduler::handleSensorData);
+    connect(m_api, &ApiClient::errorOccurred, this, &PollScheduler::handleError);
+
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &PollScheduler::pollDue);
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kFlushDelayMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &PollScheduler::flushWrites);
+
+    load();
+    scheduleNext();
+}
+
+PollScheduler::~PollScheduler()
+{
+    flushWrites();
+}
+
+/**
+ * @brief Implementation of watch().
+ * @details The newest stored timestamp is taken from the store so the first
+ * poll does not rewrite data saved manually before.
+ */
+void PollScheduler::watch(int sensorId, const QString &location, const QString &key)
+{
+    if (sensorId == 0 || m_watches.contains(sensorId))
+        return;
+
+    Watch watch;
+    watch.sensorId = sensorId;
+    watch.location = location;
+    watch.key = key;
+    watch.lastTimestamp = db::latestStoredTimestamp(location, key);
+    watch.nextPollMs = QDateTime::currentMSecsSinceEpoch();
+    m_watches.insert(sensorId, watch);
+
+    save();
+    scheduleNext();
+}
+
+/**
+ * @brief Implementation of unwatch().
+ */
+void PollScheduler::unwatch(int sensorId)
+{
+    if (m_watches.remove(sensorId) == 0)
+        return;
+    m_due.removeAll(sensorId);
+    save();
+    scheduleNext();
+}
+
+/**
+ * @brief Computes a sensor's next poll time after a given moment.
+ * @details The slot offset within the hour is a multiplicative hash of the
+ * sensor ID, which spreads consecutive IDs across the hour.
+ */
+qint64 PollScheduler::slotAfter(int sensorId, qint64 afterMs) const
+{
+    const qint64 offset = qint64((quint32(sensorId) * 2654435761u) % 3600u) * 1000;
+    qint64 slot = afterMs - afterMs % kHourMs + offset;
+    if (slot <= afterMs)
+        slot += kHourMs;
+    return slot;
+}
+
+/**
+ * @brief Arms the timer for the earliest scheduled poll.
+ */
+void PollScheduler::scheduleNext()
+{
+    qint64 next = std::numeric_limits<qint64>::max();
+    for (const Watch &watch : std::as_const(m_watches))
+        next = qMin(next, watch.nextPollMs);
+
+    if (next == std::numeric_limits<qint64>::max()) {
+        m_timer.stop();
+        return;
+    }
+
+    const qint64 delay = next - QDateTime::currentMSecsSinceEpoch();
+    m_timer.start(int(qBound<qint64>(0, delay, kHourMs)));
+}
+
+/**
+ * @brief Queues every sensor whose slot has come.
+ */
+void PollScheduler::pollDue()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (Watch &watch : m_watches) {
+        if (watch.nextPollMs > now)
+            continue;
+        watch.nextPollMs = std::numeric_limits<qint64>::max(); // Rescheduled when handled
+        m_due.enqueue(watch.sensorId);
+    }
+
+    pollNext();
+    scheduleNext();
+}
+
+/**
+ * @brief Sends the next queued request; one request is in flight at a time.
+ */
+void PollScheduler::pollNext()
+{
+    while (m_current == 0 && !m_due.isEmpty()) {
+        const int sensorId = m_due.dequeue();
+        if (!m_watches.contains(sensorId))
+            continue;
+        m_current = sensorId;
+        m_api->getSensorData(sensorId);
+    }
+}
+
+/**
+ * @brief Stores the part of a response that is not stored yet.
+ * @details A point is written if it is newer than the newest stored point,
+ * or if it falls in the 72-hour revision window and its value differs from
+ * the stored one. Right after watch() there are no stored values to compare
+ * with, so only newer points count.
+ *
+ * New points go through the sensor's QualityDetector in time order. A
+ * revised point cannot be replayed through the detector's state, so it
+ * only gets the checks that need no history.
+ */
+void PollScheduler::handleSensorData(const SensorSeries &series)
+{
+    const int sensorId = m_current;
+    m_current = 0;
+
+    auto it = m_watches.find(sensorId);
+    if (it != m_watches.end() && series.sensorId() == sensorId) {
+        Watch &watch = *it;
+        if (watch.key.isEmpty())
+            watch.key = series.key();
+
+        SensorSeries changes;
+        changes.setSensorId(sensorId);
+        changes.setKey(watch.key);
+        changes.setLocation(watch.location);
+        SensorSeries added = changes;   // Stored as a new file
+        SensorSeries revised = changes; // Merged into the files holding the old values
+
+        const bool bootstrap = watch.recent.isEmpty();
+        const qint32 previousLast = watch.lastTimestamp;
+        const QualityDetector detector(watch.key);
+        for (int i = 0; i < series.size(); ++i) {
+            if (!series.isValid(i))
+                continue;
+
+            const qint32 time = series.timestamp(i);
+            const float value = series.value(i);
+            bool changed = time > previousLast;
+            if (!changed && !bootstrap && time > previousLast - kRecentWindow) {
+                auto stored = watch.recent.constFind(time);
+                changed = stored == watch.recent.cend() || *stored != value;
+            }
+
+            if (changed) {
+                quint8 flags = 0;
+                if (time > previousLast)
+                    flags = detector.check(watch.quality, time, value);
+                else if (value < 0)
+                    flags = QualityDetector::Negative;
+                for (SensorSeries *target : { &changes, time > previousLast ? &added : &revised }) {
+                    target->append(time, value);
+                    target->setFlags(target->size() - 1, flags);
+                }
+            }
+            watch.recent.insert(time, value);
+            watch.lastTimestamp = qMax(watch.lastTimestamp, time);
+        }
+
+        // Forget values that left the revision window
+        for (auto r = watch.recent.begin(); r != watch.recent.end();) {
+            if (r.key() <= watch.lastTimestamp - kRecentWindow)
+                r = watch.recent.erase(r);
+            else
+                ++r;
+        }
+
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        const bool upToDate = qint64(watch.lastTimestamp) * 1000 >= now - now % kHourMs - kHourMs;
+        if (!added.isEmpty())
+            m_pendingWrites.append(added);
+        if (!revised.isEmpty())
+            m_pendingRevisions.append(revised);
+        if (!changes.isEmpty()) {
+            if (!m_flushTimer.isActive())
+                m_flushTimer.start();
+            emit sensorUpdated(changes);
+        }
+
+        if (changes.isEmpty() && !upToDate && watch.retries < kMaxRetries) {
+            watch.retries++;
+            watch.nextPollMs = qMin(now + kRetryMs, slotAfter(sensorId, now));
+        } else {
+            watch.retries = 0;
+            watch.nextPollMs = slotAfter(sensorId, now);
+        }
+        qDebug() << "Polled sensor" << sensorId << "-" << changes.size() << "new or revised points";
+    }
+
+    pollNext();
+    scheduleNext();
+}
+
+/**
+ * @brief Reschedules the sensor whose request failed.
+ */
+void PollScheduler::handleError(const QString &error)
+{
+    const int sensorId = m_current;
+    m_current = 0;
+
+    auto it = m_watches.find(sensorId);
+    if (it != m_watches.end()) {
+        qWarning() << "Poll of sensor" << sensorId << "failed:" << error;
+        it->nextPollMs = QDateTime::currentMSecsSinceEpoch() + kRetryMs;
+    }
+
+    pollNext();
+    scheduleNext();
+}
+
+/**
+ * @brief Writes all pending changes with one commit and saves state.
+ * @details State is saved after the data, so a crash in between at worst
+ * re-writes a few points on the next run.
+ */
+void PollScheduler::flushWrites()
+{
+    if (m_pendingWrites.isEmpty() && m_pendingRevisions.isEmpty())
+        return;
+
+    // New points first: a revision may target a point that is still pending
+    db::saveSensorDataBatch(m_pendingWrites);
+    db::reviseSensorData(m_pendingRevisions);
+    m_pendingWrites.clear();
+    m_pendingRevisions.clear();
+    save();
+}
+
+/**
+ * @brief Loads the watch list and per-sensor state.
+ */
+void PollScheduler::load()
+{
+    QFile file(db::getAppDataPath() + "/watched.json");
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const QJsonArray watches = QJsonDocument::fromJson(file.readAll()).array();
+    for (const QJsonValue &value : watches) {
+        const QJsonObject obj = value.toObject();
+
+        Watch watch;
+        watch.sensorId = obj["sensorId"].toInt();
+        watch.location = SensorSeries::intern(obj["location"].toString());
+        watch.key = SensorSeries::intern(obj["key"].toString());
+        watch.lastTimestamp = obj["lastTimestamp"].toInt();
+        const QJsonObject recent = obj["recent"].toObject();
+        for (auto r = recent.begin(); r != recent.end(); ++r)
+            watch.recent.insert(r.key().toInt(), float(r.value().toDouble()));
+        watch.quality = QualityDetector::stateFromJson(obj["quality"].toObject());
+        watch.nextPollMs = slotAfter(watch.sensorId, now);
+
+        if (watch.sensorId != 0)
+            m_watches.insert(watch.sensorId, watch);
+    }
+}
+
+/**
+ * @brief Saves the watch list and per-sensor state.
+ * @details Written through QSaveFile, so a crash mid-write leaves the previous
+ * list in place.
+ */
+void PollScheduler::save() const
+{
+    QJsonArray watches;
+    for (const Watch &watch : m_watches) {
+        QJsonObject recent;
+        for (auto r = watch.recent.cbegin(); r != watch.recent.cend(); ++r)
+            recent[QString::number(r.key())] = double(r.value());
+
+        QJsonObject obj;
+        obj["sensorId"] = watch.sensorId;
+        obj["location"] = watch.location;
+        obj["key"] = watch.key;
+        obj["lastTimestamp"] = watch.lastTimestamp;
+        obj["recent"] = recent;
+        obj["quality"] = QualityDetector::stateToJson(watch.quality);
+        watches.append(obj);
+    }
+
+    QSaveFile file(db::getAppDataPath() + "/watched.json");
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(watches).toJson(QJsonDocument::Compact)) < 0
+        || !file.commit())
+        qWarning() << "Could not save watch list:" << file.fileName();
+}
@@ -0,0 +1,124 @@
+/**
+ * @file pollscheduler.h
+ * @brief Hourly polling of watched sensors with incremental storage.
+ */
+
+#ifndef POLLSCHEDULER_H
+#define POLLSCHEDULER_H
+
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QVector>
+#include "qualitydetector.h"
+#include "sensorseries.h"
+
+class ApiClient;
+
+/**
+ * @class PollScheduler
+ * @brief Keeps watched sensors up to date in the local store.
+ *
+ * GIOS publishes one value per sensor and hour. Each watched sensor gets a
+ * fixed slot within the hour derived from its ID, so polls are spread
+ * evenly instead of bursting at the full hour. A poll that brings nothing
+ * new is retried a few times within the hour, in case the value was late.
+ *
+ * Every response is compared with what is already stored for the sensor:
+ * the newest stored timestamp plus the values of the last 72 hours.
+ * Only points that are newer, or whose value changed, are written: newer
+ * points as one small series file per poll, changed values merged into
+ * the stored files that hold them (see db::reviseSensorData()). Writes are
+ * grouped into one durable commit per flush interval.
+ *
+ * The watch list and per-sensor state persist in AppDataLocation/watched.json.
+ */
+class PollScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs the scheduler and loads the watch list.
+     * @param parent Parent QObject (optional).
+     */
+    explicit PollScheduler(QObject *parent = nullptr);
+
+    /**
+     * @brief Flushes pending writes and saves state.
+     */
+    ~PollScheduler() override;
+
+    /**
+     * @brief Adds a sensor to the watch list and schedules its first poll.
+     * @param sensorId GIOS sensor ID.
+     * @param location Store location of the sensor's station.
+     * @param key Parameter key, e.g. "PM10".
+     */
+    void watch(int sensorId, const QString &location, const QString &key);
+
+    /**
+     * @brief Removes a sensor from the watch list.
+     */
+    void unwatch(int sensorId);
+
+    /**
+     * @brief Checks whether a sensor is watched.
+     */
+    bool isWatched(int sensorId) const { return m_watches.contains(sensorId); }
+
+    /**
+     * @brief Number of watched sensors.
+     */
+    int watchCount() const { return m_watches.size(); }
+
+signals:
+    /**
+     * @brief Emitted when a poll stored new or revised points.
+     * @param points Only the points that were written.
+     */
+    void sensorUpdated(const SensorSeries &points);
+
+private slots:
+    void pollDue();
+    void handleSensorData(const SensorSeries &series);
+    void handleError(const QString &error);
+    void flushWrites();
+
+private:
+    /**
+     * @brief State of one watched sensor.
+     */
+    struct Watch {
+        int sensorId = 0;
+        QString location;
+        QString key;
+        qint32 lastTimestamp = 0;     ///< Newest stored point
+        QHash<qint32, float> recent;  ///< Stored values of the last 72 hours
+        QualityDetector::State quality; ///< Detector state after the newest point
+        qint64 nextPollMs = 0;        ///< Next scheduled poll, epoch ms
+        int retries = 0;              ///< Polls without new data this hour
+    };
+
+    ApiClient *m_api;
+    QHash<int, Watch> m_watches;
+    QQueue<int> m_due;            ///< Sensors waiting for their request
+    int m_current = 0;            ///< Sensor with a request in flight (0 if none)
+    QTimer m_timer;               ///< Fires at the next scheduled poll
+    QTimer m_flushTimer;          ///< Groups writes into one commit
+    QVector<SensorSeries> m_pendingWrites;    ///< New points, saved as new files
+    QVector<SensorSeries> m_pendingRevisions; ///< Changed old points (see db::reviseSensorData())
+
+    qint64 slotAfter(int sensorId, qint64 afterMs) const;
+    void scheduleNext();
+    void pollNext();
+    void load();
+    void save() const;
+
+    static const qint64 kHourMs = 3600 * 1000;
+    static const qint32 kRecentWindow = 72 * 3600; ///< Seconds of values kept for revision checks
+    static const int kMaxRetries = 3;              ///< Extra polls per hour when nothing new arrived
+};
+
+#endif // POLLSCHEDULER_H
@@ -0,0 +1,141 @@
+/**
+ * @file prefetcher.cpp
+ * @brief Implementation of the background prefetcher.
+ */
+
+#include "prefetcher.h"
+#include "apiclient.h"
+#include "db.h"
+#include "seriescache.h"
+
+/**
+ * @brief Constructs the prefetcher with its own API client.
+ * @details A separate client keeps background responses away from the
+ * main window's handlers.
+ */
+Prefetcher::Prefetcher(QObject *parent)
+    : QObject(parent)
+    , m_api(new ApiClient(this))
+{
+    connect(m_api, &ApiClient::stationDetailsReceived, this, &Prefetcher::handleStationDetails);
+    connect(m_api, &ApiClient::sensorDataReceived, this, &Prefetcher::handleSensorData);
+    connect(m_api, &ApiClient::errorOccurred, this, &Prefetcher::handleError);
+}
+
+/**
+ * @brief Implementation of prefetchStation().
+ */
+void Prefetcher::prefetchStation(int stationId, const QJsonArray &sensors)
+{
+    rememberStation(stationId);
+
+    m_queue.clear();
+    for (const QJsonValue &sensor : sensors) {
+        const int sensorId = sensor.toObject()["id"].toInt();
+        if (sensorId != 0)
+            m_queue.enqueue({ Job::Sensor, sensorId });
+    }
+    fetchNext();
+}
+
+/**
+ * @brief Implementation of warmRecentStations().
+ * @details Station details are fetched first; their sensors are queued as
+ * the details arrive.
+ */
+void Prefetcher::warmRecentStations()
+{
+    for (int stationId : recentStations())
+        m_queue.enqueue({ Job::Station, stationId });
+    fetchNext();
+}
+
+/**
+ * @brief Starts the next queued request unless one is in flight.
+ * @details Sensors with fresh cached data are skipped.
+ */
+void Prefetcher::fetchNext()
+{
+    SensorSeries cached;
+    while (!m_busy && !m_queue.isEmpty()) {
+        const Job job = m_queue.dequeue();
+        if (job.kind == Job::Station) {
+            m_busy = true;
+            m_api->getStationDetails(job.id, QNetworkRequest::LowPriority);
+        } else if (!SeriesCache::instance().find(SeriesCache::sensorKey(job.id), &cached, kFreshMs)) {
+            m_busy = true;
+            m_api->getSensorData(job.id, QNetworkRequest::LowPriority);
+        }
+    }
+}
+
+/**
+ * @brief Queues the sensors of a warmed station behind the current work.
+ */
+void Prefetcher::handleStationDetails(const QJsonObject &details)
+{
+    m_busy = false;
+    for (const QJsonValue &sensor : details["data"].toArray()) {
+        const int sensorId = sensor.toObject()["id"].toInt();
+        if (sensorId != 0)
+            m_queue.enqueue({ Job::Sensor, sensorId });
+    }
+    fetchNext();
+}
+
+/**
+ * @brief Caches a fetched series.
+ */
+void Prefetcher::handleSensorData(const SensorSeries &series)
+{
+    m_busy = false;
+    SeriesCache::instance().insert(SeriesCache::sensorKey(series.sensorId()), series);
+    fetchNext();
+}
+
+/**
+ * @brief Skips a failed request; the user's own click will retry it.
+ */
+void Prefetcher::handleError(const QString &error)
+{
+    m_busy = false;
+    qDebug() << "Prefetch failed:" << error;
+    fetchNext();
+}
+
+/**
+ * @brief Moves a station to the front of the recently used list.
+ */
+void Prefetcher::rememberStation(int stationId)
+{
+    QList<int> recent = recentStations();
+    recent.removeAll(stationId);
+    recent.prepend(stationId);
+    while (recent.size() > kRecentCount)
+        recent.removeLast();
+
+    QJsonArray ids;
+    for (int id : recent)
+        ids.append(id);
+
+    QFile file(db::getAppDataPath() + "/recentStations.json");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        file.write(QJsonDocument(ids).toJson(QJsonDocument::Compact));
+}
+
+/**
+ * @brief Loads the recently used stations, most recent first.
+ */
+QList<int> Prefetcher::recentStations() const
+{
+    QList<int> recent;
+    QFile file(db::getAppDataPath() + "/recentStations.json");
+    if (!file.open(QIODevice::ReadOnly))
+        return recent;
+
+    for (const QJsonValue &value : QJsonDocument::fromJson(file.readAll()).array()) {
+        if (value.toInt() != 0)
+            recent.append(value.toInt());
+    }
+    return recent;
+}
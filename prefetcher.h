@@ -0,0 +1,85 @@
+/**
+ * @file prefetcher.h
+ * @brief Background fetching of sensor data the user is likely to open.
+ */
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <QJsonArray>
+#include <QObject>
+#include <QQueue>
+#include "sensorseries.h"
+
+class ApiClient;
+
+/**
+ * @class Prefetcher
+ * @brief Fills SeriesCache with sensors of selected and recently used stations.
+ *
+ * When a station is selected, all its sensors are fetched and decoded in
+ * the background, so clicking a sensor button finds the series in the
+ * cache. At startup the sensors of the most recently used stations are
+ * warmed the same way.
+ *
+ * Requests use the low network priority and run one at a time on their own
+ * ApiClient, so they never compete with foreground requests for more than
+ * one connection. A new selection replaces the queued work.
+ *
+ * Recently used stations persist in AppDataLocation/recentStations.json.
+ */
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs the prefetcher.
+     * @param parent Parent QObject (optional).
+     */
+    explicit Prefetcher(QObject *parent = nullptr);
+
+    /**
+     * @brief Fetches all sensors of a station, ahead of other queued work.
+     * @param stationId GIOS station ID; recorded as recently used.
+     * @param sensors "data" array of the station details response.
+     */
+    void prefetchStation(int stationId, const QJsonArray &sensors);
+
+    /**
+     * @brief Queues the sensors of the most recently used stations.
+     */
+    void warmRecentStations();
+
+    /**
+     * @brief Maximum age of cached API data that counts as fresh.
+     * @details GIOS publishes hourly, so older data may miss a value.
+     */
+    static const qint64 kFreshMs = 10 * 60 * 1000;
+
+    static const int kRecentCount = 5; ///< Stations remembered for warmup
+
+private slots:
+    void handleStationDetails(const QJsonObject &details);
+    void handleSensorData(const SensorSeries &series);
+    void handleError(const QString &error);
+
+private:
+    /**
+     * @brief Queued request.
+     */
+    struct Job {
+        enum Kind { Station, Sensor } kind;
+        int id;
+    };
+
+    ApiClient *m_api;
+    QQueue<Job> m_queue;
+    bool m_busy = false;
+
+    void fetchNext();
+    void rememberStation(int stationId);
+    QList<int> recentStations() const;
+};
+
+#endif // PREFETCHER_H
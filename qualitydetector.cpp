@@ -0,0 +1,166 @@
+/**
+ * @file qualitydetector.cpp
+ * @brief Implementation of the streaming quality checks.
+ */
+
+#include "qualitydetector.h"
+#include <QHash>
+#include <QStringList>
+#include <QtMath>
+#include <limits>
+
+namespace {
+/**
+ * @brief Largest plausible change per hour of each parameter in µg/m³.
+ * @details Generous on purpose: traffic and heating episodes are real, a
+ * jump of several hundred µg/m³ within one hour is usually not.
+ */
+float maxRatePerHour(const QString &key)
+{
+    static const QHash<QString, float> limits = {
+        { "PM10", 150 }, { "PM2.5", 120 }, { "NO2", 200 }, { "SO2", 200 },
+        { "O3", 150 }, { "CO", 5000 }, { "C6H6", 50 },
+    };
+    return limits.value(key, std::numeric_limits<float>::infinity());
+}
+}
+
+/**
+ * @brief Constructs the detector with the limits of a parameter.
+ */
+QualityDetector::QualityDetector(const QString &key)
+    : m_maxRatePerHour(maxRatePerHour(key))
+{
+}
+
+/**
+ * @brief Implementation of check().
+ * @details The mean and variance use the incremental EWMA update, so they
+ * need no window of past values. Negative values are left out of them;
+ * spikes are not, so that a lasting change of level stops being flagged
+ * once the mean has followed it.
+ */
+quint8 QualityDetector::check(State &state, qint32 time, float value) const
+{
+    quint8 flags = 0;
+    if (value < 0)
+        flags |= Negative;
+
+    const bool continuous = state.lastTime != 0 && time > state.lastTime
+                            && time - state.lastTime <= kMaxGapHours * 3600;
+    if (continuous) {
+        const double hours = qMax(1.0, (time - state.lastTime) / 3600.0);
+        if (qAbs(value - state.lastValue) / hours > m_maxRatePerHour)
+            flags |= RateOfChange;
+
+        state.repeats = value == state.lastValue ? state.repeats + 1 : 0;
+
+        const float runMin = qMin(state.runMin, value);
+        const float runMax = qMax(state.runMax, value);
+        if (runMax - runMin <= kFlatRange) {
+            state.runMin = runMin;
+            state.runMax = runMax;
+        } else {
+            state.runStart = time;
+            state.runMin = state.runMax = value;
+        }
+    } else {
+        state.repeats = 0;
+        state.runStart = time;
+        state.runMin = state.runMax = value;
+    }
+
+    if (state.repeats >= kStuckRepeats)
+        flags |= Stuck;
+    if (time - state.runStart >= kFlatHours * 3600)
+        flags |= Flatline;
+
+    if (state.count >= kWarmupPoints) {
+        const double sigma = qMax(qSqrt(state.variance), kMinSigma);
+        if (qAbs(value - state.mean) > kSpikeSigmas * sigma)
+            flags |= Spike;
+    }
+
+    if (!(flags & Negative)) {
+        if (state.count == 0) {
+            state.mean = value;
+            state.variance = 0;
+        } else {
+            const double diff = value - state.mean;
+            const double step = kAlpha * diff;
+            state.mean += step;
+            state.variance = (1 - kAlpha) * (state.variance + diff * step);
+        }
+        state.count = qMin(state.count + 1, kWarmupPoints);
+    }
+
+    state.lastTime = time;
+    state.lastValue = value;
+    return flags;
+}
+
+/**
+ * @brief Implementation of annotate().
+ */
+int QualityDetector::annotate(SensorSeries &series)
+{
+    const QualityDetector detector(series.key());
+    State state;
+    int flagged = 0;
+    for (int i = 0; i < series.size(); ++i) {
+        const quint8 flags = series.isValid(i) ? detector.check(state, series.timestamp(i), series.value(i)) : 0;
+        series.setFlags(i, flags);
+        flagged += flags != 0;
+    }
+    return flagged;
+}
+
+/**
+ * @brief Implementation of describe().
+ */
+QString QualityDetector::describe(quint8 flags)
+{
+    QStringList names;
+    if (flags & Negative) names << "negative";
+    if (flags & Spike) names << "spike";
+    if (flags & RateOfChange) names << "rate";
+    if (flags & Stuck) names << "stuck";
+    if (flags & Flatline) names << "flatline";
+    return names.join(", ");
+}
+
+/**
+ * @brief Implementation of stateToJson().
+ */
+QJsonObject QualityDetector::stateToJson(const State &state)
+{
+    QJsonObject object;
+    object["mean"] = state.mean;
+    object["variance"] = state.variance;
+    object["count"] = state.count;
+    object["lastTime"] = state.lastTime;
+    object["lastValue"] = double(state.lastValue);
+    object["repeats"] = state.repeats;
+    object["runStart"] = state.runStart;
+    object["runMin"] = double(state.runMin);
+    object["runMax"] = double(state.runMax);
+    return object;
+}
+
+/**
+ * @brief Implementation of stateFromJson().
+ */
+QualityDetector::State QualityDetector::stateFromJson(const QJsonObject &object)
+{
+    State state;
+    state.mean = object["mean"].toDouble();
+    state.variance = object["variance"].toDouble();
+    state.count = object["count"].toInt();
+    state.lastTime = object["lastTime"].toInt();
+    state.lastValue = float(object["lastValue"].toDouble());
+    state.repeats = object["repeats"].toInt();
+    state.runStart = object["runStart"].toInt();
+    state.runMin = float(object["runMin"].toDouble());
+    state.runMax = float(object["runMax"].toDouble());
+    return state;
+}
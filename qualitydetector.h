@@ -0,0 +1,109 @@
+/**
+ * @file qualitydetector.h
+ * @brief Streaming detection of sensor faults and anomalous values.
+ */
+
+#ifndef QUALITYDETECTOR_H
+#define QUALITYDETECTOR_H
+
+#include <QJsonObject>
+#include <QString>
+#include "sensorseries.h"
+
+/**
+ * @class QualityDetector
+ * @brief Flags suspicious points of a sensor one point at a time.
+ *
+ * Every check runs on a small per-sensor State updated with each point, so
+ * the cost per point is constant and independent of the history:
+ * - Negative: a concentration below zero.
+ * - Spike: more than kSpikeSigmas standard deviations from an exponentially
+ *   weighted mean (EWMA z-score), once kWarmupPoints points have been seen.
+ * - RateOfChange: a change per hour above the limit of the parameter.
+ * - Stuck: the exact same value more than kStuckRepeats times in a row.
+ * - Flatline: all values within kFlatRange for at least kFlatHours.
+ *
+ * A gap of more than kMaxGapHours restarts the run and rate checks. Flagged
+ * points are kept and stored with their flags (see SensorSeries::flags());
+ * statistics, tile pyramids and charts leave them out.
+ */
+class QualityDetector
+{
+public:
+    /**
+     * @brief Quality flags; a point can have several.
+     */
+    enum Flag : quint8 {
+        Negative = 0x01,
+        Spike = 0x02,
+        RateOfChange = 0x04,
+        Stuck = 0x08,
+        Flatline = 0x10,
+    };
+
+    /**
+     * @brief Detector state of one sensor.
+     */
+    struct State {
+        double mean = 0;      ///< EWMA of the values
+        double variance = 0;  ///< EWMA of the squared deviation
+        int count = 0;        ///< Points seen, up to kWarmupPoints
+        qint32 lastTime = 0;  ///< Timestamp of the last point (0 before the first)
+        float lastValue = 0;
+        int repeats = 0;      ///< Consecutive repeats of lastValue
+        qint32 runStart = 0;  ///< First timestamp of the current near-constant run
+        float runMin = 0;
+        float runMax = 0;
+    };
+
+    static const int kWarmupPoints = 12;
+    static const int kStuckRepeats = 5;
+    static const int kFlatHours = 24;
+    static const int kMaxGapHours = 6;
+    static constexpr double kAlpha = 0.1;       ///< EWMA weight of a new point
+    static constexpr double kSpikeSigmas = 6;
+    static constexpr double kMinSigma = 2;      ///< Deviation floor in µg/m³, for very steady sensors
+    static constexpr float kFlatRange = 0.05f;  ///< µg/m³
+
+    /**
+     * @brief Creates a detector for one parameter.
+     * @param key Parameter key; selects the rate-of-change limit (none for unknown keys).
+     */
+    explicit QualityDetector(const QString &key = QString());
+
+    /**
+     * @brief Checks the next point of a sensor and updates its state.
+     * @param state State of the sensor; points must arrive in time order.
+     * @param time Epoch seconds.
+     * @param value Measured value.
+     * @return quint8 Flags of the point, 0 if it looks fine.
+     */
+    quint8 check(State &state, qint32 time, float value) const;
+
+    /**
+     * @brief Checks every valid point of a series from a fresh state.
+     * @param series Series to flag; gets a flag column even if all points are clean.
+     * @return int Number of flagged points.
+     */
+    static int annotate(SensorSeries &series);
+
+    /**
+     * @brief Short names of a set of flags, e.g. "spike, rate".
+     */
+    static QString describe(quint8 flags);
+
+    /**
+     * @brief Serializes a state, e.g. for the poll scheduler's saved watches.
+     */
+    static QJsonObject stateToJson(const State &state);
+
+    /**
+     * @brief Parses a state written by stateToJson(); a fresh state on bad input.
+     */
+    static State stateFromJson(const QJsonObject &object);
+
+private:
+    float m_maxRatePerHour;
+};
+
+#endif // QUALITYDETECTOR_H
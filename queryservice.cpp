@@ -0,0 +1,620 @@
+/**
+ * @file queryservice.cpp
+ * @brief Implementation of the read-only HTTP query service.
+ */
+
+#include "queryservice.h"
+#include "archiveanalytics.h"
+#include "seriesexporter.h"
+#include "storesnapshot.h"
+#include "db.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutexLocker>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+
+namespace {
+const int kMaxHeaderBytes = 16 * 1024;
+const int kChunkBytes = 64 * 1024;
+
+/**
+ * @brief Waits for a complete line; false on timeout, disconnect or an oversized header.
+ */
+bool readLine(QTcpSocket &socket, QByteArray &line, int &headerBytes)
+{
+    while (!socket.canReadLine()) {
+        if (socket.bytesAvailable() > kMaxHeaderBytes || !socket.waitForReadyRead(QueryService::kIdleTimeoutMs))
+            return false;
+    }
+    line = socket.readLine();
+    headerBytes += line.size();
+    line = line.trimmed();
+    return headerBytes <= kMaxHeaderBytes;
+}
+
+/**
+ * @brief Whether a complete request head is buffered, or more than a head may hold.
+ */
+bool hasRequestHead(QTcpSocket &socket)
+{
+    const QByteArray buffered = socket.peek(kMaxHeaderBytes + 1);
+    return buffered.contains("\r\n\r\n") || buffered.contains("\n\n") || buffered.size() > kMaxHeaderBytes;
+}
+
+/**
+ * @brief Blocks until everything written to the socket has been sent.
+ */
+bool drain(QTcpSocket &socket)
+{
+    while (socket.bytesToWrite() > 0) {
+        if (!socket.waitForBytesWritten(QueryService::kIdleTimeoutMs))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Write-only device sending everything written to it as HTTP chunks.
+ * @details Collects writes into chunks of about kChunkBytes and waits for
+ * each to be sent before accepting more, so a slow client throttles the
+ * exporter instead of growing the socket buffer.
+ */
+class ChunkedDevice : public QIODevice
+{
+public:
+    explicit ChunkedDevice(QTcpSocket &socket)
+        : m_socket(socket)
+    {
+        open(QIODevice::WriteOnly);
+    }
+
+    /**
+     * @brief Sends the last chunk and the terminating empty chunk.
+     */
+    bool finish()
+    {
+        if (!sendChunk())
+            return false;
+        m_socket.write("0\r\n\r\n");
+        return drain(m_socket);
+    }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+
+    qint64 writeData(const char *data, qint64 size) override
+    {
+        if (m_failed)
+            return -1;
+        m_buffer.append(data, size);
+        if (m_buffer.size() >= kChunkBytes && !sendChunk())
+            return -1;
+        return size;
+    }
+
+private:
+    QTcpSocket &m_socket;
+    QByteArray m_buffer;
+    bool m_failed = false;
+
+    bool sendChunk()
+    {
+        if (m_failed)
+            return false;
+        if (m_buffer.isEmpty())
+            return true;
+        m_socket.write(QByteArray::number(m_buffer.size(), 16) + "\r\n");
+        m_socket.write(m_buffer);
+        m_socket.write("\r\n");
+        m_buffer.clear();
+        m_failed = !drain(m_socket);
+        return !m_failed;
+    }
+};
+
+QByteArray reasonPhrase(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    default: return "Internal Server Error";
+    }
+}
+
+QByteArray responseHead(int status, const QByteArray &contentType, bool keepAlive)
+{
+    return "HTTP/1.1 " + QByteArray::number(status) + ' ' + reasonPhrase(status) + "\r\n"
+           "Content-Type: " + contentType + "\r\n"
+           "Cache-Control: no-cache\r\n"
+           "Connection: " + (keepAlive ? "keep-alive" : "close") + "\r\n";
+}
+
+/**
+ * @brief Parses a time parameter given as epoch seconds or ISO 8601.
+ * @return bool False if the text is neither; an empty text gives 0 (unbounded).
+ */
+bool parseTime(const QString &text, qint64 *seconds)
+{
+    *seconds = 0;
+    if (text.isEmpty())
+        return true;
+    bool ok = false;
+    *seconds = text.toLongLong(&ok);
+    if (ok)
+        return true;
+    const QDateTime time = QDateTime::fromString(text, Qt::ISODate);
+    *seconds = time.isValid() ? time.toSecsSinceEpoch() : 0;
+    return time.isValid();
+}
+
+/**
+ * @brief Reads the shared filter parameters.
+ * @return QString Error message, empty if the filter is valid.
+ */
+QString parseFilter(const QUrlQuery &query, ExportQuery *filter)
+{
+    filter->location = query.queryItemValue("location", QUrl::FullyDecoded);
+    filter->parameter = query.queryItemValue("parameter", QUrl::FullyDecoded);
+    if (!parseTime(query.queryItemValue("from", QUrl::FullyDecoded), &filter->from))
+        return "from expects epoch seconds or an ISO 8601 time";
+    if (!parseTime(query.queryItemValue("to", QUrl::FullyDecoded), &filter->to))
+        return "to expects epoch seconds or an ISO 8601 time";
+    return QString();
+}
+
+QByteArray toJson(const QJsonObject &object)
+{
+    return QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+}
+}
+
+/**
+ * @brief Sizes the connection pool for blocking I/O.
+ * @details Threads mostly wait for the socket or the disk, so the pool has
+ * twice as many threads as cores.
+ */
+QueryService::QueryService(QObject *parent)
+    : QTcpServer(parent)
+    , m_cache(kCacheBudget)
+{
+    m_pool.setMaxThreadCount(2 * QThread::idealThreadCount());
+    m_pool.setExpiryTimeout(30000);
+}
+
+/**
+ * @brief Implementation of the destructor.
+ */
+QueryService::~QueryService()
+{
+    close();
+    m_pool.waitForDone();
+
+    // Connections a worker handed back are not picked up any more
+    for (QTcpSocket *socket : std::as_const(m_sockets)) {
+        if (!socket->thread())
+            socket->moveToThread(thread());
+        delete socket;
+    }
+}
+
+/**
+ * @brief Implementation of start().
+ */
+bool QueryService::start(quint16 port, const QHostAddress &address)
+{
+    if (!listen(address, port)) {
+        qWarning() << "Query service could not listen on port" << port << "-" << errorString();
+        return false;
+    }
+    qDebug() << "Query service listening on" << serverAddress().toString() << serverPort();
+    return true;
+}
+
+/**
+ * @brief Implementation of stats().
+ */
+QueryService::Stats QueryService::stats() const
+{
+    Stats stats;
+    stats.requests = m_requests.load();
+    stats.cacheHits = m_cacheHits.load();
+    stats.errors = m_errors.load();
+    stats.connections = m_connections.load();
+    return stats;
+}
+
+/**
+ * @brief Starts watching a new connection.
+ * @details The socket lives on the service's thread while it waits for a
+ * request, so an idle keep-alive connection holds no pool thread.
+ */
+void QueryService::incomingConnection(qintptr socketDescriptor)
+{
+    ++m_connections;
+    QTcpSocket *socket = new QTcpSocket();
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        delete socket;
+        return;
+    }
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    QTimer *idle = new QTimer(socket);
+    idle->setSingleShot(true);
+    idle->setInterval(kIdleTimeoutMs);
+    {
+        QMutexLocker locker(&m_socketsMutex);
+        m_sockets.insert(socket);
+    }
+    waitForRequest(socket);
+}
+
+/**
+ * @brief Waits on the event loop for the next request of a connection.
+ * @details Hands the socket to the pool once a complete request head is
+ * buffered; closes it when the peer does or after kIdleTimeoutMs.
+ */
+void QueryService::waitForRequest(QTcpSocket *socket)
+{
+    if (hasRequestHead(*socket)) {
+        dispatch(socket);
+        return;
+    }
+    if (socket->state() != QAbstractSocket::ConnectedState) {
+        closeSocket(socket);
+        return;
+    }
+
+    QTimer *idle = socket->findChild<QTimer *>();
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket] {
+        if (hasRequestHead(*socket))
+            dispatch(socket);
+    });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket] { closeSocket(socket); });
+    connect(idle, &QTimer::timeout, this, [this, socket] { closeSocket(socket); });
+    idle->start();
+}
+
+/**
+ * @brief Moves an idle connection with a buffered request to a pool thread.
+ * @details The socket is released from this thread first, so the worker
+ * can take it over (see serveBuffered()).
+ */
+void QueryService::dispatch(QTcpSocket *socket)
+{
+    QTimer *idle = socket->findChild<QTimer *>();
+    idle->stop();
+    disconnect(idle, nullptr, this, nullptr);
+    disconnect(socket, nullptr, this, nullptr);
+    socket->moveToThread(nullptr);
+    m_pool.start([this, socket] { serveBuffered(socket); });
+}
+
+/**
+ * @brief Closes an idle connection on the service's thread.
+ */
+void QueryService::closeSocket(QTcpSocket *socket)
+{
+    disconnect(socket->findChild<QTimer *>(), nullptr, this, nullptr);
+    disconnect(socket, nullptr, this, nullptr);
+    {
+        QMutexLocker locker(&m_socketsMutex);
+        m_sockets.remove(socket);
+    }
+    socket->disconnectFromHost();
+    socket->deleteLater();
+}
+
+/**
+ * @brief Serves the buffered requests of a connection on a pool thread.
+ * @details Takes the socket over and uses blocking I/O while complete
+ * requests are buffered, so pipelined requests are answered in order. The
+ * socket then goes back to the service's thread to wait for the next
+ * request, or is closed here.
+ */
+void QueryService::serveBuffered(QTcpSocket *socket)
+{
+    socket->moveToThread(QThread::currentThread());
+
+    bool open = true;
+    do
+        open = serveNext(*socket);
+    while (open && hasRequestHead(*socket));
+
+    if (!open) {
+        {
+            QMutexLocker locker(&m_socketsMutex);
+            m_sockets.remove(socket);
+        }
+        socket->disconnectFromHost();
+        if (socket->state() != QAbstractSocket::UnconnectedState)
+            socket->waitForDisconnected(1000);
+        delete socket;
+        return;
+    }
+
+    socket->moveToThread(nullptr);
+    QMetaObject::invokeMethod(this, [this, socket] {
+        socket->moveToThread(thread());
+        waitForRequest(socket);
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Reads one request from the socket and writes its response.
+ * @return bool False if the connection must be closed.
+ */
+bool QueryService::serveNext(QTcpSocket &socket)
+{
+    int headerBytes = 0;
+    QByteArray requestLine;
+    do {
+        if (!readLine(socket, requestLine, headerBytes))
+            return false;
+    } while (requestLine.isEmpty()); // Stray line breaks between requests
+
+    const QList<QByteArray> parts = requestLine.split(' ');
+    if (parts.size() != 3 || !parts[2].startsWith("HTTP/1.")) {
+        writeResponse(socket, error(400, "Malformed request line"), false);
+        return false;
+    }
+    bool keepAlive = parts[2] == "HTTP/1.1";
+
+    QByteArray header;
+    bool complete = false;
+    while (readLine(socket, header, headerBytes)) {
+        if (header.isEmpty()) {
+            complete = true;
+            break;
+        }
+        const int colon = header.indexOf(':');
+        if (colon > 0 && header.left(colon).trimmed().toLower() == "connection") {
+            const QByteArray value = header.mid(colon + 1).trimmed().toLower();
+            if (value == "close")
+                keepAlive = false;
+            else if (value == "keep-alive")
+                keepAlive = true;
+        }
+    }
+    return complete && serveRequest(socket, parts[0], parts[1], keepAlive);
+}
+
+/**
+ * @brief Dispatches one request and writes its response.
+ * @return bool False if the connection must be closed.
+ */
+bool QueryService::serveRequest(QTcpSocket &socket, const QByteArray &method, const QByteArray &target, bool keepAlive)
+{
+    ++m_requests;
+    if (method != "GET") {
+        writeResponse(socket, error(405, "Only GET is supported"), false);
+        return false;
+    }
+
+    const QUrl url = QUrl::fromEncoded(target);
+    const QString path = url.path();
+    const QUrlQuery query(url);
+
+    if (path == "/range") {
+        streamRange(socket, query, keepAlive);
+        return keepAlive && socket.state() == QAbstractSocket::ConnectedState;
+    }
+
+    if (path == "/status") {
+        const Stats current = stats();
+        QJsonObject object;
+        object["requests"] = current.requests;
+        object["cacheHits"] = current.cacheHits;
+        object["errors"] = current.errors;
+        object["connections"] = current.connections;
+        object["storeVersion"] = StoreSnapshot::currentVersion();
+        Response response;
+        response.body = toJson(object);
+        return writeResponse(socket, response, keepAlive) && keepAlive;
+    }
+
+    if (path != "/latest" && path != "/aggregate")
+        return writeResponse(socket, error(404, "Unknown endpoint " + path), keepAlive) && keepAlive;
+
+    // A version of -1 (no manifest yet) is not cached: the store can change without it moving
+    const qint64 version = StoreSnapshot::currentVersion();
+    const QByteArray cacheKey = QByteArray::number(version) + ' ' + target;
+    if (version >= 0) {
+        QMutexLocker locker(&m_cacheMutex);
+        if (const QByteArray *body = m_cache.object(cacheKey)) {
+            Response response;
+            response.body = *body;
+            locker.unlock();
+            ++m_cacheHits;
+            return writeResponse(socket, response, keepAlive) && keepAlive;
+        }
+    }
+
+    const Response response = path == "/latest" ? latest(query) : aggregate(query);
+    if (version >= 0 && response.status == 200 && response.body.size() <= kMaxCachedBody) {
+        QMutexLocker locker(&m_cacheMutex);
+        m_cache.insert(cacheKey, new QByteArray(response.body), response.body.size());
+    }
+    return writeResponse(socket, response, keepAlive) && keepAlive;
+}
+
+/**
+ * @brief Newest usable point of each matching location and parameter.
+ * @details Only the file of each parameter that takes precedence in the
+ * store (see db::sortSeriesFiles()) is read: it ends at the newest saved
+ * time, so other files cannot hold a later point. If its last
+ * points are all flagged or missing, the parameter is left out.
+ */
+QueryService::Response QueryService::latest(const QUrlQuery &query) const
+{
+    ExportQuery filter;
+    const QString problem = parseFilter(query, &filter);
+    if (!problem.isEmpty())
+        return error(400, problem);
+
+    const QString root = db::getAppDataPath() + "/db";
+    const StoreSnapshot snapshot = StoreSnapshot::capture(root);
+    QJsonArray results;
+    for (const QString &location : snapshot.locations()) {
+        if (!filter.location.isEmpty() && !location.contains(filter.location, Qt::CaseInsensitive))
+            continue;
+
+        // Key -> files of the parameter
+        QMap<QString, QStringList> byKey;
+        for (const QString &fileName : snapshot.files(location)) {
+            QString key;
+            qint32 from = 0;
+            qint32 to = 0;
+            if (!db::parseSeriesFileName(fileName, &key, &from, &to))
+                continue;
+            if (!filter.parameter.isEmpty() && key != filter.parameter)
+                continue;
+            byKey[key].append(fileName);
+        }
+
+        for (auto it = byKey.cbegin(); it != byKey.cend(); ++it) {
+            const QString newest = db::sortSeriesFiles(it.value(), it.key()).constLast();
+            const SensorSeries series = db::loadSensorData(root + "/" + location + "/" + newest, location);
+            int i = filter.to != 0 ? series.upperBound(qint32(filter.to)) : series.size();
+            while (--i >= 0 && !series.isUsable(i)) {}
+            if (i < 0 || (filter.from != 0 && series.timestamp(i) < filter.from))
+                continue;
+
+            QJsonObject result;
+            result["location"] = location;
+            result["parameter"] = it.key();
+            result["sensorId"] = series.sensorId();
+            result["time"] = series.timestamp(i);
+            result["value"] = double(series.value(i));
+            results.append(result);
+        }
+    }
+
+    QJsonObject object;
+    object["results"] = results;
+    Response response;
+    response.body = toJson(object);
+    return response;
+}
+
+/**
+ * @brief Aggregates per location or parameter, computed by ArchiveAnalytics.
+ */
+QueryService::Response QueryService::aggregate(const QUrlQuery &query) const
+{
+    AnalyticsQuery analytics;
+    const QString problem = parseFilter(query, &analytics.filter);
+    if (!problem.isEmpty())
+        return error(400, problem);
+
+    const QString groupBy = query.queryItemValue("group-by");
+    if (groupBy == "parameter")
+        analytics.groupBy = AnalyticsQuery::ByParameter;
+    else if (!groupBy.isEmpty() && groupBy != "location")
+        return error(400, "group-by expects location or parameter");
+
+    if (query.hasQueryItem("above")) {
+        bool ok = false;
+        analytics.threshold = query.queryItemValue("above").toDouble(&ok);
+        if (!ok)
+            return error(400, "above expects a number");
+        analytics.hasThreshold = true;
+        analytics.order = AnalyticsQuery::ByExceedances;
+    }
+    // Requests already run in parallel; one worker each keeps them from competing for cores
+    analytics.threads = 1;
+
+    QJsonArray groups;
+    for (const AnalyticsGroup &group : ArchiveAnalytics::run(analytics)) {
+        QJsonObject object;
+        object["name"] = group.name;
+        object["count"] = group.count;
+        object["mean"] = group.mean();
+        object["min"] = double(group.min);
+        object["max"] = double(group.max);
+        if (analytics.hasThreshold)
+            object["exceedances"] = group.exceedances;
+        groups.append(object);
+    }
+
+    QJsonObject object;
+    object["groups"] = groups;
+    Response response;
+    response.body = toJson(object);
+    return response;
+}
+
+/**
+ * @brief Streams all matching points with chunked transfer encoding.
+ * @details The response head is sent before the store is read, so an
+ * export failing halfway can only be reported by closing the connection
+ * without the terminating chunk.
+ */
+void QueryService::streamRange(QTcpSocket &socket, const QUrlQuery &query, bool keepAlive)
+{
+    ExportQuery filter;
+    const QString problem = parseFilter(query, &filter);
+    if (!problem.isEmpty()) {
+        writeResponse(socket, error(400, problem), keepAlive);
+        return;
+    }
+
+    const QString format = query.queryItemValue("format");
+    SeriesExporter::Format exportFormat = SeriesExporter::Json;
+    QByteArray contentType = "application/json";
+    if (format == "csv") {
+        exportFormat = SeriesExporter::Csv;
+        contentType = "text/csv";
+    } else if (format == "binary") {
+        exportFormat = SeriesExporter::Columnar;
+        contentType = "application/octet-stream";
+    } else if (!format.isEmpty() && format != "json") {
+        writeResponse(socket, error(400, "format expects json, csv or binary"), keepAlive);
+        return;
+    }
+
+    socket.write(responseHead(200, contentType, keepAlive) + "Transfer-Encoding: chunked\r\n\r\n");
+    ChunkedDevice device(socket);
+    SeriesExporter exporter(filter, exportFormat, &device);
+    bool success = false;
+    QObject::connect(&exporter, &SeriesExporter::finished, [&success](bool ok, const QString &) { success = ok; });
+    exporter.run();
+
+    if (!success || !device.finish()) {
+        ++m_errors;
+        socket.abort();
+    }
+}
+
+/**
+ * @brief Builds an error response with a JSON body {"error": message}.
+ */
+QueryService::Response QueryService::error(int status, const QString &message)
+{
+    QJsonObject object;
+    object["error"] = message;
+    Response response;
+    response.status = status;
+    response.body = toJson(object);
+    return response;
+}
+
+/**
+ * @brief Writes a complete response and waits until it is sent.
+ */
+bool QueryService::writeResponse(QTcpSocket &socket, const Response &response, bool keepAlive)
+{
+    if (response.status >= 400)
+        ++m_errors;
+    socket.write(responseHead(response.status, response.contentType, keepAlive)
+                 + "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n\r\n" + response.body);
+    return drain(socket);
+}
@@ -0,0 +1,126 @@
+/**
+ * @file queryservice.h
+ * @brief Read-only HTTP query service over the local store.
+ */
+
+#ifndef QUERYSERVICE_H
+#define QUERYSERVICE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QHostAddress>
+#include <QMutex>
+#include <QSet>
+#include <QTcpServer>
+#include <QThreadPool>
+#include <QUrlQuery>
+#include <atomic>
+
+class QTcpSocket;
+
+/**
+ * @class QueryService
+ * @brief Serves stored data to other local tools as JSON, CSV or columnar binary.
+ *
+ * Endpoints (GET; filters as for exports: "location" is a substring,
+ * "parameter" an exact key, "from"/"to" epoch seconds or ISO 8601):
+ * - /latest: newest usable value of each matching location and parameter.
+ * - /aggregate: count, mean, min and max per group, as ArchiveAnalytics
+ *   computes them; "group-by" (location or parameter) and "above".
+ * - /range: all points, streamed with chunked transfer encoding by a
+ *   SeriesExporter; "format" is json (default), csv or binary (the columnar
+ *   export layout).
+ * - /status: request and cache counters.
+ *
+ * Connections use HTTP/1.1 keep-alive. Between requests a connection waits
+ * on the service's event loop; once a complete request head has arrived,
+ * it moves to a thread of the service's pool, which answers with blocking
+ * socket I/O and hands it back. Idle clients therefore hold no thread.
+ * Readers use store snapshots and never wait for the collector.
+ *
+ * /latest and /aggregate bodies are cached by request target and store
+ * version (StoreSnapshot::currentVersion()), so repeated queries cost a
+ * file stat and a hash lookup until the next commit is published.
+ */
+class QueryService : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    static const int kCacheBudget = 16 * 1024 * 1024;  ///< Bytes of cached response bodies
+    static const int kMaxCachedBody = 256 * 1024;      ///< Larger bodies are not cached
+    static const int kIdleTimeoutMs = 5000;            ///< Keep-alive connections close after this long without a request
+
+    /**
+     * @brief Counters since the service started.
+     */
+    struct Stats {
+        qint64 requests = 0;
+        qint64 cacheHits = 0;
+        qint64 errors = 0;     ///< Responses with a 4xx or 5xx status
+        qint64 connections = 0;
+    };
+
+    /**
+     * @brief Constructs a stopped service.
+     * @param parent Parent QObject (optional).
+     */
+    explicit QueryService(QObject *parent = nullptr);
+
+    /**
+     * @brief Stops listening, waits for running requests and closes all connections.
+     */
+    ~QueryService() override;
+
+    /**
+     * @brief Starts listening.
+     * @param port TCP port; 0 picks a free one (see serverPort()).
+     * @param address Interface; only the local host by default.
+     * @return bool False if the port cannot be bound.
+     */
+    bool start(quint16 port, const QHostAddress &address = QHostAddress::LocalHost);
+
+    /**
+     * @brief Request counters; safe from any thread.
+     */
+    Stats stats() const;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    /**
+     * @brief Complete response with a body known in advance.
+     */
+    struct Response {
+        int status = 200;
+        QByteArray contentType = "application/json";
+        QByteArray body;
+    };
+
+    QThreadPool m_pool;
+    mutable QMutex m_cacheMutex;
+    QCache<QByteArray, QByteArray> m_cache; ///< Key: store version + request target
+    std::atomic<qint64> m_requests{0};
+    std::atomic<qint64> m_cacheHits{0};
+    std::atomic<qint64> m_errors{0};
+    std::atomic<qint64> m_connections{0};
+    QMutex m_socketsMutex;
+    QSet<QTcpSocket *> m_sockets; ///< Open connections, idle or being served
+
+    void waitForRequest(QTcpSocket *socket);
+    void dispatch(QTcpSocket *socket);
+    void closeSocket(QTcpSocket *socket);
+    void serveBuffered(QTcpSocket *socket);
+    bool serveNext(QTcpSocket &socket);
+    bool serveRequest(QTcpSocket &socket, const QByteArray &method, const QByteArray &target, bool keepAlive);
+    Response latest(const QUrlQuery &query) const;
+    Response aggregate(const QUrlQuery &query) const;
+    void streamRange(QTcpSocket &socket, const QUrlQuery &query, bool keepAlive);
+
+    static Response error(int status, const QString &message);
+
+    bool writeResponse(QTcpSocket &socket, const Response &response, bool keepAlive);
+};
+
+#endif // QUERYSERVICE_H
@@ -0,0 +1,50 @@
+/**
+ * @file requestarena.cpp
+ * @brief Implementation of the request arena.
+ */
+
+#include "requestarena.h"
+
+/**
+ * @brief Implementation of local().
+ */
+RequestArena &RequestArena::local()
+{
+    thread_local RequestArena arena;
+    return arena;
+}
+
+RequestArena::RequestArena()
+    : m_block(kInitialBytes)
+{
+    m_resource.emplace(m_block.data(), m_block.size(), &m_overflow);
+}
+
+/**
+ * @brief Implementation of reset().
+ * @details After an overflow the block is replaced by one large enough for
+ * the block and the overflow together.
+ */
+void RequestArena::reset()
+{
+    m_resource.reset();
+    if (m_overflow.bytes > 0) {
+        std::size_t size = m_block.size();
+        while (size < m_block.size() + m_overflow.bytes)
+            size *= 2;
+        m_overflow.bytes = 0;
+        m_block = std::vector<std::byte>(size);
+    }
+    m_resource.emplace(m_block.data(), m_block.size(), &m_overflow);
+}
+
+void *RequestArena::Overflow::do_allocate(std::size_t size, std::size_t alignment)
+{
+    bytes += size;
+    return std::pmr::new_delete_resource()->allocate(size, alignment);
+}
+
+void RequestArena::Overflow::do_deallocate(void *p, std::size_t size, std::size_t alignment)
+{
+    std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+}
@@ -0,0 +1,93 @@
+/**
+ * @file requestarena.h
+ * @brief Per-thread monotonic arena for memory that lives for one request.
+ */
+
+#ifndef REQUESTARENA_H
+#define REQUESTARENA_H
+
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+/**
+ * @class RequestArena
+ * @brief Bump allocator reused by every request processed on a thread.
+ *
+ * Scratch containers of a request (parsed points, formatting buffers) take
+ * their memory from resource() instead of the general heap and give it
+ * back all at once when the request's Scope ends. The arena starts with a
+ * fixed block; a request that needs more falls back to the heap, and the
+ * next reset() grows the block to cover it, so steady-state requests of a
+ * similar size allocate nothing.
+ *
+ * Memory from the arena must not outlive the Scope. A scope opened inside
+ * another one shares it; the arena is reset when the outermost one ends.
+ */
+class RequestArena
+{
+public:
+    /**
+     * @brief Resets the calling thread's arena when the outermost scope is destroyed.
+     */
+    class Scope
+    {
+    public:
+        Scope() : m_arena(RequestArena::local()) { m_arena.m_depth++; }
+        ~Scope()
+        {
+            if (--m_arena.m_depth == 0)
+                m_arena.reset();
+        }
+        std::pmr::memory_resource *resource() { return m_arena.resource(); }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        RequestArena &m_arena;
+    };
+
+    /**
+     * @brief Arena of the calling thread.
+     */
+    static RequestArena &local();
+
+    std::pmr::memory_resource *resource() { return &*m_resource; }
+
+    /**
+     * @brief Releases everything allocated since the last reset.
+     */
+    void reset();
+
+    /**
+     * @brief Size of the fixed block in bytes.
+     */
+    std::size_t capacity() const { return m_block.size(); }
+
+    static const std::size_t kInitialBytes = 64 * 1024;
+
+private:
+    /**
+     * @brief Heap fallback that records how much a request overflowed.
+     */
+    class Overflow : public std::pmr::memory_resource
+    {
+    public:
+        std::size_t bytes = 0;
+
+    private:
+        void *do_allocate(std::size_t size, std::size_t alignment) override;
+        void do_deallocate(void *p, std::size_t size, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+    };
+
+    RequestArena();
+
+    std::vector<std::byte> m_block;
+    Overflow m_overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> m_resource;
+    int m_depth = 0; ///< Open scopes
+};
+
+#endif // REQUESTARENA_H
@@ -0,0 +1,466 @@
+/**
+ * @file responsearchive.cpp
+ * @brief Implementation of the raw response archive and its replay.
+ */
+
+#include "responsearchive.h"
+#include "metadatacatalog.h"
+#include "db.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLockFile>
+#include <QMap>
+#include <QRegularExpression>
+#include <QSet>
+#include <QThreadPool>
+#include <QtEndian>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace {
+const int kHashBytes = 32;
+const int kBatchSeries = 64; ///< Series per saveSensorDataBatch() call of a replay worker
+
+QByteArray sha256(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+template <typename T>
+void put(QByteArray &out, T value)
+{
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(const char *data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+/**
+ * @brief Appends to a file with a single write.
+ */
+bool appendFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Append) && file.write(data) == data.size();
+}
+}
+
+/**
+ * @brief Implementation of instance().
+ * @details Destroyed at exit, which writes the open block.
+ */
+ResponseArchive *ResponseArchive::instance()
+{
+    static const bool enabled = [] {
+        const QString setting = qEnvironmentVariable("WEATHERAPP_RAW_ARCHIVE");
+        return !setting.isEmpty() && setting != "0";
+    }();
+    if (!enabled)
+        return nullptr;
+    static std::unique_ptr<ResponseArchive> archive(new ResponseArchive(db::getAppDataPath() + "/raw"));
+    return archive.get();
+}
+
+/**
+ * @brief Implementation of the constructor.
+ */
+ResponseArchive::ResponseArchive(const QString &rootPath)
+    : m_root(rootPath)
+{
+    QDir().mkpath(m_root);
+    QMutexLocker locker(&m_mutex);
+    loadObjects();
+}
+
+/**
+ * @brief Implementation of the destructor.
+ */
+ResponseArchive::~ResponseArchive()
+{
+    flush();
+}
+
+/**
+ * @brief Implementation of parsePath().
+ */
+ResponseArchive::Endpoint ResponseArchive::parsePath(const QString &path, int *id)
+{
+    static const QRegularExpression pattern("^/(station/findAll|station/sensors/(\\d+)|data/getData/(\\d+))$");
+    const QRegularExpressionMatch match = pattern.match(path);
+    *id = 0;
+    if (!match.hasMatch())
+        return UnknownEndpoint;
+    if (!match.captured(2).isEmpty()) {
+        *id = match.captured(2).toInt();
+        return StationSensors;
+    }
+    if (!match.captured(3).isEmpty()) {
+        *id = match.captured(3).toInt();
+        return SensorData;
+    }
+    return Stations;
+}
+
+/**
+ * @brief Implementation of record().
+ * @details Bodies already archived or already in the open block only add
+ * an index record.
+ */
+void ResponseArchive::record(const QString &path, const QByteArray &body)
+{
+    Entry entry;
+    entry.endpoint = parsePath(path, &entry.id);
+    if (entry.endpoint == UnknownEndpoint || body.isEmpty())
+        return;
+    entry.timeMs = QDateTime::currentMSecsSinceEpoch();
+    entry.hash = sha256(body);
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_objects.contains(entry.hash) && !m_pendingObjects.contains(entry.hash)) {
+        Location location;
+        location.offset = quint32(m_block.size());
+        location.size = quint32(body.size());
+        m_pendingObjects.insert(entry.hash, location);
+        m_pendingOrder.append(entry.hash);
+        m_block += body;
+    }
+    if (m_pendingEntries.isEmpty())
+        m_pendingSinceMs = entry.timeMs;
+    m_pendingEntries.append(entry);
+
+    if (m_block.size() >= kBlockBytes || entry.timeMs - m_pendingSinceMs >= kFlushAgeMs)
+        flushLocked();
+}
+
+/**
+ * @brief Implementation of flush().
+ */
+void ResponseArchive::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    flushLocked();
+}
+
+/**
+ * @brief Writes the open block, then its objects, then the index records.
+ * @details In this order a crash leaves at most an unreferenced block or
+ * objects without index records, never a record without its body. Bodies
+ * another process archived meanwhile are still written again.
+ */
+void ResponseArchive::flushLocked()
+{
+    if (m_pendingEntries.isEmpty())
+        return;
+
+    QLockFile lock(m_root + "/archive.lock");
+    lock.setStaleLockTime(0);
+    if (!lock.lock()) {
+        qWarning() << "Could not lock the response archive:" << lock.error();
+        return;
+    }
+    loadObjects();
+
+    QByteArray objects;
+    if (!m_block.isEmpty()) {
+        QFile pack(m_root + "/data.pack");
+        if (!pack.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "Could not open the response archive:" << pack.errorString();
+            return;
+        }
+        const qint64 blockOffset = pack.size();
+        const QByteArray compressed = qCompress(m_block);
+        QByteArray block;
+        put(block, quint32(compressed.size()));
+        put(block, quint32(m_block.size()));
+        block += compressed;
+        if (pack.write(block) != block.size()) {
+            qWarning() << "Could not write the response archive:" << pack.errorString();
+            return;
+        }
+
+        for (const QByteArray &hash : std::as_const(m_pendingOrder)) {
+            Location location = m_pendingObjects.value(hash);
+            location.blockOffset = blockOffset;
+            objects += hash;
+            put(objects, location.blockOffset);
+            put(objects, location.offset);
+            put(objects, location.size);
+            m_objects.insert(hash, location);
+        }
+    }
+
+    QByteArray index;
+    for (const Entry &entry : std::as_const(m_pendingEntries)) {
+        put(index, entry.timeMs);
+        put(index, qint32(entry.id));
+        index += char(entry.endpoint);
+        index += QByteArray(3, '\0');
+        index += entry.hash;
+    }
+
+    if (!appendFile(m_root + "/objects.idx", objects) || !appendFile(m_root + "/index.log", index))
+        qWarning() << "Could not write the response archive index";
+    m_objectsRead += objects.size();
+
+    qDebug() << "Archived" << m_pendingEntries.size() << "responses," << m_pendingOrder.size() << "new bodies,"
+             << m_block.size() << "bytes";
+    m_block.clear();
+    m_pendingObjects.clear();
+    m_pendingOrder.clear();
+    m_pendingEntries.clear();
+}
+
+/**
+ * @brief Reads objects.idx records added since the last call, also by other processes.
+ * @note The caller must hold m_mutex.
+ */
+void ResponseArchive::loadObjects()
+{
+    QFile file(m_root + "/objects.idx");
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(m_objectsRead))
+        return;
+    const QByteArray data = file.readAll();
+    const qsizetype complete = data.size() / kRecordBytes * kRecordBytes; // A torn record is ignored
+    for (qsizetype pos = 0; pos < complete; pos += kRecordBytes) {
+        const char *record = data.constData() + pos;
+        Location location;
+        location.blockOffset = get<qint64>(record + kHashBytes);
+        location.offset = get<quint32>(record + kHashBytes + 8);
+        location.size = get<quint32>(record + kHashBytes + 12);
+        m_objects.insert(QByteArray(record, kHashBytes), location);
+    }
+    m_objectsRead += complete;
+}
+
+/**
+ * @brief Implementation of entries().
+ * @details Records are in arrival order, so the range is found by binary
+ * search on the memory-mapped index.
+ */
+QVector<ResponseArchive::Entry> ResponseArchive::entries(qint64 fromMs, qint64 toMs) const
+{
+    QVector<Entry> result;
+    QFile file(m_root + "/index.log");
+    if (!file.open(QIODevice::ReadOnly) || file.size() < kRecordBytes)
+        return result;
+    const qint64 count = file.size() / kRecordBytes;
+    const uchar *data = file.map(0, count * kRecordBytes);
+    if (!data)
+        return result;
+
+    auto timeAt = [data](qint64 i) { return get<qint64>(reinterpret_cast<const char *>(data + i * kRecordBytes)); };
+    qint64 lo = 0;
+    qint64 hi = count;
+    while (lo < hi) {
+        const qint64 mid = (lo + hi) / 2;
+        if (timeAt(mid) < fromMs)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (qint64 i = lo; i < count; ++i) {
+        const char *record = reinterpret_cast<const char *>(data + i * kRecordBytes);
+        Entry entry;
+        entry.timeMs = get<qint64>(record);
+        if (toMs != 0 && entry.timeMs > toMs)
+            break;
+        entry.id = get<qint32>(record + 8);
+        entry.endpoint = Endpoint(quint8(record[12]));
+        entry.hash = QByteArray(record + 16, kHashBytes);
+        result.append(entry);
+    }
+    file.unmap(const_cast<uchar *>(data));
+    return result;
+}
+
+/**
+ * @brief Reads and decompresses one block of data.pack.
+ * @return QByteArray Empty if the block is missing or damaged.
+ */
+QByteArray ResponseArchive::readBlock(qint64 blockOffset) const
+{
+    QFile pack(m_root + "/data.pack");
+    if (!pack.open(QIODevice::ReadOnly) || !pack.seek(blockOffset))
+        return QByteArray();
+    const QByteArray header = pack.read(8);
+    if (header.size() != 8)
+        return QByteArray();
+    const quint32 compressedSize = get<quint32>(header.constData());
+    const quint32 rawSize = get<quint32>(header.constData() + 4);
+    if (blockOffset + 8 + compressedSize > pack.size())
+        return QByteArray();
+    const QByteArray block = qUncompress(pack.read(compressedSize));
+    return block.size() == qsizetype(rawSize) ? block : QByteArray();
+}
+
+/**
+ * @brief Implementation of body().
+ */
+QByteArray ResponseArchive::body(const QByteArray &hash) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto pending = m_pendingObjects.constFind(hash);
+    if (pending != m_pendingObjects.cend())
+        return m_block.mid(pending->offset, pending->size);
+    const Location location = m_objects.value(hash);
+    const bool known = m_objects.contains(hash);
+    locker.unlock();
+
+    if (!known)
+        return QByteArray();
+    const QByteArray data = readBlock(location.blockOffset).mid(location.offset, location.size);
+    return sha256(data) == hash ? data : QByteArray();
+}
+
+/**
+ * @brief Implementation of stats().
+ */
+ResponseArchive::Stats ResponseArchive::stats() const
+{
+    Stats stats;
+    stats.responses = QFileInfo(m_root + "/index.log").size() / kRecordBytes;
+    stats.storedBytes = QFileInfo(m_root + "/data.pack").size();
+    QMutexLocker locker(&m_mutex);
+    stats.objects = m_objects.size();
+    for (const Location &location : m_objects)
+        stats.rawBytes += location.size;
+    return stats;
+}
+
+/**
+ * @brief Implementation of replay().
+ * @details Each distinct body of a sensor is parsed once, however often it
+ * was received. Work units are the blocks holding sensor data, so every
+ * block is decompressed once; workers claim them through an atomic counter
+ * and save their series in batches, which the write-ahead log commits as
+ * groups. Series the store already has are skipped by the save.
+ */
+ResponseArchive::ReplayResult ResponseArchive::replay(const ReplayOptions &options)
+{
+    QElapsedTimer timer;
+    timer.start();
+    ReplayResult result;
+    flush();
+    const QVector<Entry> all = entries(options.fromMs, options.toMs);
+
+    // Sensor -> station, from the catalog and then from archived sensor lists (newer wins)
+    QHash<int, int> stationOfSensor;
+    {
+        MetadataCatalog catalog;
+        for (int stationId : db::stations.ids()) {
+            for (const MetadataCatalog::Sensor &sensor : catalog.sensors(stationId))
+                stationOfSensor.insert(sensor.id, stationId);
+        }
+    }
+    for (const Entry &entry : all) {
+        if (entry.endpoint != StationSensors)
+            continue;
+        const QJsonDocument document = QJsonDocument::fromJson(body(entry.hash));
+        const QJsonArray sensors = document.isArray() ? document.array() : document.object()["data"].toArray();
+        for (const QJsonValue &sensor : sensors) {
+            const int sensorId = sensor.toObject()["id"].toInt();
+            if (sensorId != 0)
+                stationOfSensor.insert(sensorId, entry.id);
+        }
+    }
+
+    // Work units: distinct (sensor, body) pairs grouped by block
+    struct Item {
+        int sensorId;
+        Location location;
+        QByteArray hash;
+    };
+    QMap<qint64, QVector<Item>> byBlock;
+    QHash<int, QString> locationOfSensor;
+    QSet<QPair<int, QByteArray>> seen;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const Entry &entry : all) {
+            if (entry.endpoint != SensorData || seen.contains(qMakePair(entry.id, entry.hash)))
+                continue;
+            seen.insert(qMakePair(entry.id, entry.hash));
+            if (!locationOfSensor.contains(entry.id)) {
+                const int row = db::stations.rowForId(stationOfSensor.value(entry.id));
+                locationOfSensor.insert(entry.id, row >= 0 ? db::stations.displayName(row) : QString());
+            }
+            const Location location = m_objects.value(entry.hash);
+            byBlock[location.blockOffset].append({ entry.id, location, entry.hash });
+        }
+    }
+    const QVector<QVector<Item>> units = byBlock.values().toVector();
+    const QVector<qint64> blocks = byBlock.keys().toVector();
+
+    QThreadPool pool;
+    if (options.threads > 0)
+        pool.setMaxThreadCount(options.threads);
+    const int workers = qMax(1, qMin(pool.maxThreadCount(), int(units.size())));
+    std::atomic_int nextUnit{0};
+    std::atomic<qint64> responses{0}, points{0}, bytes{0}, unresolved{0}, failed{0};
+
+    for (int w = 0; w < workers; ++w) {
+        pool.start([&]() {
+            QVector<SensorSeries> batch;
+            for (int u = nextUnit++; u < units.size(); u = nextUnit++) {
+                const QByteArray block = readBlock(blocks[u]);
+                for (const Item &item : units[u]) {
+                    const QString stationLocation = locationOfSensor.value(item.sensorId);
+                    if (stationLocation.isEmpty()) {
+                        ++unresolved;
+                        continue;
+                    }
+                    const QByteArray data = block.mid(item.location.offset, item.location.size);
+                    if (sha256(data) != item.hash) {
+                        ++failed;
+                        continue;
+                    }
+                    SensorSeries series;
+                    if (!SensorSeries::fromResponse(data, item.sensorId, &series)) {
+                        const QJsonDocument document = QJsonDocument::fromJson(data);
+                        if (!document.isObject()) {
+                            ++failed;
+                            continue;
+                        }
+                        series = SensorSeries::fromJson(document.object(), item.sensorId);
+                    }
+                    series.setLocation(stationLocation);
+                    ++responses;
+                    points += series.size();
+                    bytes += data.size();
+                    if (options.store && !series.isEmpty())
+                        batch.append(series);
+                    if (batch.size() >= kBatchSeries) {
+                        db::saveSensorDataBatch(batch);
+                        batch.clear();
+                    }
+                }
+            }
+            if (!batch.isEmpty())
+                db::saveSensorDataBatch(batch);
+        });
+    }
+    pool.waitForDone();
+
+    result.responses = responses;
+    result.points = points;
+    result.bytes = bytes;
+    result.unresolved = unresolved;
+    result.failed = failed;
+    result.elapsedMs = timer.elapsed();
+    qDebug() << "Replayed" << result.responses << "responses," << result.points << "points in"
+             << result.elapsedMs << "ms on" << workers << "threads";
+    return result;
+}
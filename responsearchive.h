@@ -0,0 +1,186 @@
+/**
+ * @file responsearchive.h
+ * @brief Content-addressed archive of raw API responses, with parallel replay.
+ */
+
+#ifndef RESPONSEARCHIVE_H
+#define RESPONSEARCHIVE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+/**
+ * @class ResponseArchive
+ * @brief Keeps the bytes of every API response so that history can be parsed again.
+ *
+ * Enabled by setting the WEATHERAPP_RAW_ARCHIVE environment variable to a
+ * non-empty value other than "0"; ApiClient then records each successful
+ * response in AppDataLocation/raw:
+ * - data.pack: blocks of response bodies, each stored once per SHA-256 and
+ *   compressed with qCompress() as a whole. A block is: u32 compressed
+ *   size, u32 raw size, compressed bytes.
+ * - objects.idx: per body, 48-byte records of the SHA-256, i64 block
+ *   offset, u32 offset in the block and u32 size.
+ * - index.log: per response, 48-byte records of i64 receive time (epoch
+ *   ms), i32 ID, u8 endpoint, 3 bytes padding and the SHA-256 of the body,
+ *   in the order the responses arrived.
+ * All numbers are little-endian.
+ *
+ * A block is written once it holds kBlockBytes, once its oldest response
+ * is kFlushAgeMs old, and when the archive is destroyed; a crash loses at
+ * most the open block. Processes sharing the archive append under a lock
+ * file; a body received by two processes at once may be stored twice.
+ *
+ * replay() feeds archived sensor data back through SensorSeries::fromJson()
+ * and db::saveSensorDataBatch() on a thread pool, one block per work unit,
+ * for backfills after parsing changes and for benchmarks of the pipeline.
+ */
+class ResponseArchive
+{
+public:
+    /**
+     * @brief API requests whose responses are archived.
+     */
+    enum Endpoint : quint8 {
+        UnknownEndpoint = 0,
+        Stations = 1,       ///< /station/findAll; ID 0
+        StationSensors = 2, ///< /station/sensors/<station ID>
+        SensorData = 3,     ///< /data/getData/<sensor ID>
+    };
+
+    /**
+     * @brief One archived response.
+     */
+    struct Entry {
+        qint64 timeMs = 0;
+        int id = 0;
+        Endpoint endpoint = UnknownEndpoint;
+        QByteArray hash; ///< SHA-256 of the body
+    };
+
+    /**
+     * @brief Archive size.
+     */
+    struct Stats {
+        qint64 responses = 0;   ///< Archived responses
+        qint64 objects = 0;     ///< Distinct bodies
+        qint64 rawBytes = 0;    ///< Size of the distinct bodies
+        qint64 storedBytes = 0; ///< Size of data.pack
+    };
+
+    /**
+     * @brief Selection and mode of a replay.
+     */
+    struct ReplayOptions {
+        qint64 fromMs = 0;  ///< Only responses received at or after (0 for unbounded)
+        qint64 toMs = 0;    ///< Only responses received at or before (0 for unbounded)
+        int threads = 0;    ///< Worker count (0 for one per core)
+        bool store = true;  ///< Save the parsed series; false only parses them
+    };
+
+    /**
+     * @brief Outcome of a replay.
+     */
+    struct ReplayResult {
+        qint64 responses = 0;  ///< Distinct sensor responses parsed
+        qint64 points = 0;     ///< Points in the parsed series
+        qint64 bytes = 0;      ///< Body bytes parsed
+        qint64 unresolved = 0; ///< Responses of sensors without a known station
+        qint64 failed = 0;     ///< Bodies that were damaged or did not parse
+        qint64 elapsedMs = 0;
+    };
+
+    static const int kBlockBytes = 1024 * 1024;        ///< Uncompressed bodies per block
+    static const qint64 kFlushAgeMs = 5 * 60 * 1000;   ///< Oldest response kept only in memory
+    static const int kRecordBytes = 48;                ///< Size of objects.idx and index.log records
+
+    /**
+     * @brief Archive of the application, or nullptr if archiving is not enabled.
+     */
+    static ResponseArchive *instance();
+
+    /**
+     * @brief Opens an archive directory, creating it if needed.
+     * @param rootPath Directory of the archive files.
+     */
+    explicit ResponseArchive(const QString &rootPath);
+
+    /**
+     * @brief Writes the open block.
+     */
+    ~ResponseArchive();
+
+    /**
+     * @brief Archives a response; safe from any thread.
+     * @param path Request path below the API base URL, e.g. "/data/getData/42".
+     * @param body Response body as received (after content decoding).
+     */
+    void record(const QString &path, const QByteArray &body);
+
+    /**
+     * @brief Writes the open block and its index records.
+     */
+    void flush();
+
+    /**
+     * @brief Archived responses received in a time range, oldest first.
+     * @param fromMs Range start, epoch ms (0 for unbounded).
+     * @param toMs Range end, epoch ms (0 for unbounded).
+     * @note Only responses of written blocks are listed.
+     */
+    QVector<Entry> entries(qint64 fromMs = 0, qint64 toMs = 0) const;
+
+    /**
+     * @brief Body of an archived response.
+     * @return QByteArray Empty if the hash is unknown or the stored body is damaged.
+     */
+    QByteArray body(const QByteArray &hash) const;
+
+    /**
+     * @brief Archive size, written blocks only.
+     */
+    Stats stats() const;
+
+    /**
+     * @brief Parses and optionally stores archived sensor data again; blocks until done.
+     * @details Locations are resolved from archived station sensor lists,
+     * the sensor catalog and the station cache (db::stations, which must
+     * be loaded).
+     */
+    ReplayResult replay(const ReplayOptions &options);
+
+    /**
+     * @brief Endpoint and ID of a request path; UnknownEndpoint for other paths.
+     */
+    static Endpoint parsePath(const QString &path, int *id);
+
+private:
+    /**
+     * @brief Where a body is stored.
+     */
+    struct Location {
+        qint64 blockOffset = 0;
+        quint32 offset = 0;
+        quint32 size = 0;
+    };
+
+    QString m_root;
+    mutable QMutex m_mutex;
+    QHash<QByteArray, Location> m_objects; ///< Bodies in data.pack
+    qint64 m_objectsRead = 0;              ///< Bytes of objects.idx loaded into m_objects
+
+    QByteArray m_block;                    ///< Open block
+    QHash<QByteArray, Location> m_pendingObjects; ///< Bodies in the open block (blockOffset unused)
+    QVector<QByteArray> m_pendingOrder;    ///< Their hashes in block order
+    QVector<Entry> m_pendingEntries;
+    qint64 m_pendingSinceMs = 0;
+
+    void loadObjects();
+    void flushLocked();
+    QByteArray readBlock(qint64 blockOffset) const;
+};
+
+#endif // RESPONSEARCHIVE_H
@@ -0,0 +1,809 @@
+/**
+ * @file sensorseries.cpp
+ * @brief Implementation of the SensorSeries value type.
+ */
+
+#include "sensorseries.h"
+#include "requestarena.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QMutex>
+#include <QSet>
+#include <QtEndian>
+#include <QtNumeric>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+namespace {
+const char *const kDateFormat = "yyyy-MM-dd HH:mm:ss"; ///< GIOS timestamp format
+const char kSegmentMagic[8] = { 'W', 'X', 'S', 'E', 'G', '1', 0, 0 };
+
+/**
+ * @brief Point collected while parsing, before sorting.
+ */
+struct RawPoint {
+    qint32 time;
+    float value;
+    bool valid;
+    quint8 flags;
+};
+
+/**
+ * @brief Builds a series from parsed points; sorts them first if needed.
+ */
+SensorSeries seriesFromPoints(std::pmr::vector<RawPoint> &points, const QString &key, int sensorId,
+                              bool qualityChecked)
+{
+    SensorSeries series;
+    series.setSensorId(sensorId);
+    series.setKey(key);
+
+    // The API returns newest first; keep the common case cheap
+    const auto byTime = [](const RawPoint &a, const RawPoint &b) { return a.time < b.time; };
+    if (points.size() > 1 && points.front().time > points.back().time)
+        std::reverse(points.begin(), points.end());
+    if (!std::is_sorted(points.begin(), points.end(), byTime))
+        std::stable_sort(points.begin(), points.end(), byTime);
+
+    series.reserve(int(points.size()));
+    for (const RawPoint &point : points)
+        series.append(point.time, point.value, point.valid);
+    if (qualityChecked) {
+        for (int i = 0; i < int(points.size()); ++i)
+            series.setFlags(i, points[i].flags);
+    }
+    return series;
+}
+
+/**
+ * @brief Days since 1970-01-01 of a proleptic Gregorian date.
+ */
+qint64 daysFromCivil(qint64 year, int month, int day)
+{
+    year -= month <= 2;
+    const qint64 era = (year >= 0 ? year : year - 399) / 400;
+    const qint64 yearOfEra = year - era * 400;
+    const qint64 dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const qint64 dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ * @brief Date of a day number from daysFromCivil().
+ */
+void civilFromDays(qint64 days, int *year, int *month, int *day)
+{
+    days += 719468;
+    const qint64 era = (days >= 0 ? days : days - 146096) / 146097;
+    const qint64 dayOfEra = days - era * 146097;
+    const qint64 yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const qint64 dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const qint64 shiftedMonth = (5 * dayOfYear + 2) / 153;
+    *day = int(dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+    *month = int(shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9);
+    *year = int(yearOfEra + era * 400 + (*month <= 2));
+}
+
+/**
+ * @brief Writes the shortest text that reads back as the same float.
+ * @param buffer At least 32 bytes.
+ * @return int Length of the text.
+ * @details Values are stored as float; formatting them widened to double
+ * would write 12.300000190734863 for 12.3.
+ */
+int formatFloat(char *buffer, float value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    return int(std::to_chars(buffer, buffer + 32, value).ptr - buffer);
+#else
+    QByteArray text;
+    for (int precision = 6; precision <= std::numeric_limits<float>::max_digits10; ++precision) {
+        text = QByteArray::number(double(value), 'g', precision);
+        if (text.toFloat() == value)
+            break;
+    }
+    memcpy(buffer, text.constData(), size_t(text.size()));
+    return int(text.size());
+#endif
+}
+
+/**
+ * @class LocalClock
+ * @brief Converts GIOS local timestamps to and from epoch seconds.
+ *
+ * Gives the same results as QDateTime with kDateFormat in local time, but
+ * asks QDateTime for the UTC offset only once per day. Days on which the
+ * offset changes (daylight saving) are converted point by point.
+ */
+class LocalClock
+{
+public:
+    /**
+     * @brief Parses "yyyy-MM-dd HH:mm:ss".
+     * @return bool False if the text is not a valid local time.
+     */
+    bool toEpoch(const char *text, int length, qint32 *epoch)
+    {
+        static const char kLayout[] = "dddd-dd-dd dd:dd:dd";
+        if (length != 19)
+            return false;
+        for (int i = 0; i < 19; ++i) {
+            if (kLayout[i] == 'd' ? text[i] < '0' || text[i] > '9' : text[i] != kLayout[i])
+                return false;
+        }
+        auto number = [text](int at, int digits) {
+            int value = 0;
+            for (int i = at; i < at + digits; ++i)
+                value = value * 10 + (text[i] - '0');
+            return value;
+        };
+        const int year = number(0, 4), month = number(5, 2), day = number(8, 2);
+        const int hour = number(11, 2), minute = number(14, 2), second = number(17, 2);
+        if (!QDate::isValid(year, month, day) || !QTime::isValid(hour, minute, second))
+            return false;
+
+        const qint64 days = daysFromCivil(year, month, day);
+        if (days != m_parseDay) {
+            const QDate date(year, month, day);
+            m_parseOffset = QDateTime(date, QTime(0, 0)).offsetFromUtc();
+            m_parseUniform = QDateTime(date, QTime(23, 59, 59)).offsetFromUtc() == m_parseOffset;
+            m_parseDay = days;
+        }
+        if (!m_parseUniform) {
+            const QDateTime dateTime(QDate(year, month, day), QTime(hour, minute, second));
+            if (!dateTime.isValid())
+                return false;
+            *epoch = qint32(dateTime.toSecsSinceEpoch());
+            return true;
+        }
+        *epoch = qint32(days * 86400 + hour * 3600 + minute * 60 + second - m_parseOffset);
+        return true;
+    }
+
+    /**
+     * @brief Writes the 19 characters of "yyyy-MM-dd HH:mm:ss" to out.
+     */
+    void format(qint32 epoch, char *out)
+    {
+        const qint64 utcDay = qint64(epoch) >= 0 ? epoch / 86400 : (qint64(epoch) - 86399) / 86400;
+        if (utcDay != m_formatDay) {
+            m_formatOffset = QDateTime::fromSecsSinceEpoch(utcDay * 86400).offsetFromUtc();
+            m_formatUniform = QDateTime::fromSecsSinceEpoch(utcDay * 86400 + 86399).offsetFromUtc() == m_formatOffset;
+            m_formatDay = utcDay;
+        }
+        if (!m_formatUniform) {
+            const QByteArray text = QDateTime::fromSecsSinceEpoch(epoch).toString(kDateFormat).toLatin1();
+            memcpy(out, text.constData(), 19);
+            return;
+        }
+
+        const qint64 local = qint64(epoch) + m_formatOffset;
+        const qint64 days = local >= 0 ? local / 86400 : (local - 86399) / 86400;
+        const int secondOfDay = int(local - days * 86400);
+        int year, month, day;
+        civilFromDays(days, &year, &month, &day);
+        auto put = [&out](int at, int value, int digits) {
+            for (int i = at + digits - 1; i >= at; --i, value /= 10)
+                out[i] = char('0' + value % 10);
+        };
+        put(0, year, 4);
+        out[4] = '-';
+        put(5, month, 2);
+        out[7] = '-';
+        put(8, day, 2);
+        out[10] = ' ';
+        put(11, secondOfDay / 3600, 2);
+        out[13] = ':';
+        put(14, secondOfDay / 60 % 60, 2);
+        out[16] = ':';
+        put(17, secondOfDay % 60, 2);
+    }
+
+private:
+    qint64 m_parseDay = std::numeric_limits<qint64>::min();
+    int m_parseOffset = 0;
+    bool m_parseUniform = false;
+    qint64 m_formatDay = std::numeric_limits<qint64>::min();
+    int m_formatOffset = 0;
+    bool m_formatUniform = false;
+};
+
+/**
+ * @class ResponseReader
+ * @brief Reads a GIOS "getData" response straight from its bytes.
+ *
+ * Accepts the JSON the API sends: an object with "key" and "values",
+ * values being objects with "date" and "value" (number, null or numeric
+ * string) and optionally "flags". Other members are skipped. Anything the
+ * reader does not handle, such as escaped strings, makes read() fail so
+ * that the caller can fall back to QJsonDocument.
+ */
+class ResponseReader
+{
+public:
+    ResponseReader(const QByteArray &json, std::pmr::vector<RawPoint> *points)
+        : m_pos(json.constData())
+        , m_end(json.constData() + json.size())
+        , m_points(points)
+    {
+    }
+
+    bool read()
+    {
+        if (!consume('{'))
+            return false;
+        if (consume('}'))
+            return atEnd();
+        do {
+            const char *name;
+            int nameLength;
+            if (!readString(&name, &nameLength) || !consume(':'))
+                return false;
+            if (is(name, nameLength, "key")) {
+                const char *key;
+                int keyLength;
+                if (!readString(&key, &keyLength))
+                    return false;
+                m_key = QString::fromUtf8(key, keyLength);
+            } else if (is(name, nameLength, "values")) {
+                if (!readValues())
+                    return false;
+            } else if (is(name, nameLength, "qualityChecked")) {
+                m_qualityChecked = consumeWord("true");
+                if (!m_qualityChecked && !consumeWord("false"))
+                    return false;
+            } else if (!skipValue(0)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}') && atEnd();
+    }
+
+    const QString &key() const { return m_key; }
+    bool qualityChecked() const { return m_qualityChecked; }
+
+private:
+    const char *m_pos;
+    const char *m_end;
+    std::pmr::vector<RawPoint> *m_points;
+    LocalClock m_clock;
+    QString m_key;
+    bool m_qualityChecked = false;
+
+    static bool is(const char *text, int length, const char *word)
+    {
+        return int(strlen(word)) == length && memcmp(text, word, length) == 0;
+    }
+
+    void skipSpace()
+    {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+            ++m_pos;
+    }
+
+    bool atEnd()
+    {
+        skipSpace();
+        return m_pos == m_end;
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+        if (m_pos < m_end && *m_pos == c) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool consumeWord(const char *word)
+    {
+        skipSpace();
+        const int length = int(strlen(word));
+        if (m_end - m_pos < length || memcmp(m_pos, word, length) != 0)
+            return false;
+        m_pos += length;
+        return true;
+    }
+
+    /**
+     * @brief Reads a string without escapes; returns a view into the input.
+     */
+    bool readString(const char **text, int *length)
+    {
+        if (!consume('"'))
+            return false;
+        const char *start = m_pos;
+        while (m_pos < m_end && *m_pos != '"') {
+            if (*m_pos == '\\')
+                return false;
+            ++m_pos;
+        }
+        if (m_pos == m_end)
+            return false;
+        *text = start;
+        *length = int(m_pos - start);
+        ++m_pos;
+        return true;
+    }
+
+    bool readNumber(double *value)
+    {
+        skipSpace();
+        const char *start = m_pos;
+        while (m_pos < m_end && ((*m_pos && strchr("+-.eE", *m_pos)) || (*m_pos >= '0' && *m_pos <= '9')))
+            ++m_pos;
+        return parseNumber(start, int(m_pos - start), value);
+    }
+
+    static bool parseNumber(const char *text, int length, double *value)
+    {
+        if (length == 0)
+            return false;
+        bool ok = false;
+        *value = QByteArray::fromRawData(text, length).toDouble(&ok);
+        return ok;
+    }
+
+    bool readValues()
+    {
+        if (!consume('['))
+            return false;
+        if (consume(']'))
+            return true;
+        do {
+            if (!readMeasurement())
+                return false;
+        } while (consume(','));
+        return consume(']');
+    }
+
+    bool readMeasurement()
+    {
+        if (!consume('{'))
+            return false;
+        RawPoint point{ 0, 0.0f, false, 0 };
+        bool hasDate = false;
+        if (!consume('}')) {
+            do {
+                const char *name;
+                int nameLength;
+                if (!readString(&name, &nameLength) || !consume(':'))
+                    return false;
+                if (is(name, nameLength, "date")) {
+                    const char *date;
+                    int dateLength;
+                    if (!readString(&date, &dateLength))
+                        return false;
+                    hasDate = m_clock.toEpoch(date, dateLength, &point.time);
+                } else if (is(name, nameLength, "value")) {
+                    if (!readMeasuredValue(&point))
+                        return false;
+                } else if (is(name, nameLength, "flags")) {
+                    double flags;
+                    if (!readNumber(&flags))
+                        return false;
+                    point.flags = quint8(int(flags));
+                } else if (!skipValue(0)) {
+                    return false;
+                }
+            } while (consume(','));
+            if (!consume('}'))
+                return false;
+        }
+        // Points with an unparsable date are dropped, as in fromJson()
+        if (hasDate)
+            m_points->push_back(point);
+        return true;
+    }
+
+    bool readMeasuredValue(RawPoint *point)
+    {
+        point->valid = false;
+        point->value = 0.0f;
+        skipSpace();
+        if (consumeWord("null"))
+            return true;
+        double value = 0;
+        if (m_pos < m_end && *m_pos == '"') {
+            const char *text;
+            int length;
+            if (!readString(&text, &length))
+                return false;
+            point->valid = !is(text, length, "null") && parseNumber(text, length, &value);
+        } else if (consumeWord("true") || consumeWord("false")) {
+            return true;
+        } else {
+            if (!readNumber(&value))
+                return false;
+            point->valid = true;
+        }
+        if (point->valid)
+            point->value = float(value);
+        return true;
+    }
+
+    bool skipValue(int depth)
+    {
+        if (depth > 32)
+            return false;
+        skipSpace();
+        if (m_pos == m_end)
+            return false;
+        const char *text;
+        int length;
+        double number;
+        switch (*m_pos) {
+        case '"':
+            return readString(&text, &length);
+        case '{':
+            ++m_pos;
+            if (consume('}'))
+                return true;
+            do {
+                if (!readString(&text, &length) || !consume(':') || !skipValue(depth + 1))
+                    return false;
+            } while (consume(','));
+            return consume('}');
+        case '[':
+            ++m_pos;
+            if (consume(']'))
+                return true;
+            do {
+                if (!skipValue(depth + 1))
+                    return false;
+            } while (consume(','));
+            return consume(']');
+        default:
+            return consumeWord("true") || consumeWord("false") || consumeWord("null") || readNumber(&number);
+        }
+    }
+};
+}
+
+/**
+ * @brief Constructs an empty series with its own (empty) storage.
+ */
+SensorSeries::SensorSeries() : d(new SensorSeriesData)
+{
+}
+
+/**
+ * @brief Implementation of fromJson().
+ * @details Values may be numbers, numeric strings or null. Points with an
+ * unparsable date are dropped; points with a null value are kept but marked
+ * invalid so the time axis stays complete. Quality flags written by
+ * toJson() are restored.
+ */
+SensorSeries SensorSeries::fromJson(const QJsonObject &data, int sensorId)
+{
+    const QJsonArray values = data["values"].toArray();
+    RequestArena::Scope arena;
+    std::pmr::vector<RawPoint> points(arena.resource());
+    points.reserve(values.size());
+
+    for (const QJsonValue &value : values) {
+        const QJsonObject measurement = value.toObject();
+
+        QDateTime dateTime = QDateTime::fromString(measurement["date"].toString(), kDateFormat);
+        if (!dateTime.isValid()) continue;
+
+        double val = 0;
+        bool validValue = false;
+        const QJsonValue valueJson = measurement["value"];
+        if (valueJson.isString()) {
+            QString valueStr = valueJson.toString();
+            if (valueStr != "null")
+                val = valueStr.toDouble(&validValue);
+        } else if (valueJson.isDouble()) {
+            val = valueJson.toDouble();
+            validValue = true;
+        }
+
+        points.push_back({ qint32(dateTime.toSecsSinceEpoch()), validValue ? float(val) : 0.0f, validValue,
+                           quint8(measurement["flags"].toInt()) });
+    }
+
+    return seriesFromPoints(points, data["key"].toString(), sensorId, data["qualityChecked"].toBool());
+}
+
+/**
+ * @brief Implementation of fromResponse().
+ * @details Points are collected in the thread's RequestArena, so besides
+ * the series itself only the key is allocated.
+ */
+bool SensorSeries::fromResponse(const QByteArray &json, int sensorId, SensorSeries *series)
+{
+    RequestArena::Scope arena;
+    std::pmr::vector<RawPoint> points(arena.resource());
+    points.reserve(json.size() / 40); // About 40 bytes per measurement
+
+    ResponseReader reader(json, &points);
+    if (!reader.read())
+        return false;
+    *series = seriesFromPoints(points, reader.key(), sensorId, reader.qualityChecked());
+    return true;
+}
+
+/**
+ * @brief Implementation of toJson().
+ * @details Invalid points are written with a null value; quality flags
+ * only where set. Values go through their shortest float text, so the
+ * document holds 12.3 rather than the widened double.
+ */
+QJsonObject SensorSeries::toJson() const
+{
+    char buffer[32];
+    QJsonArray values;
+    for (int i = size() - 1; i >= 0; --i) {
+        QJsonObject measurement;
+        measurement["date"] = QDateTime::fromSecsSinceEpoch(timestamp(i)).toString(kDateFormat);
+        measurement["value"] = isValid(i) ? QJsonValue(QByteArray(buffer, formatFloat(buffer, value(i))).toDouble())
+                                          : QJsonValue();
+        if (flags(i) != 0)
+            measurement["flags"] = flags(i);
+        values.append(measurement);
+    }
+
+    QJsonObject data;
+    data["key"] = m_key;
+    data["values"] = values;
+    if (m_sensorId != 0)
+        data["sensorId"] = m_sensorId;
+    if (hasFlags())
+        data["qualityChecked"] = true;
+    return data;
+}
+
+/**
+ * @brief Implementation of toJsonBytes().
+ * @details Writes the layout of QJsonDocument::Indented (members sorted by
+ * name, four-space indent) into one buffer. Values use the shortest text
+ * that reads back as the same float, as toJson() does; only the notation
+ * of very large or very small values may differ.
+ */
+QByteArray SensorSeries::toJsonBytes() const
+{
+    const QByteArray key = m_key.toUtf8();
+    QByteArray json;
+    json.reserve(key.size() + 128 + size() * (hasFlags() ? 136 : 112));
+
+    json += "{\n    \"key\": \"";
+    for (char c : key) {
+        if (c == '"' || c == '\\')
+            json += '\\';
+        json += c;
+    }
+    json += "\",\n";
+    if (hasFlags())
+        json += "    \"qualityChecked\": true,\n";
+    char buffer[32];
+    if (m_sensorId != 0) {
+        json += "    \"sensorId\": ";
+        json.append(buffer, int(std::to_chars(buffer, buffer + sizeof(buffer), m_sensorId).ptr - buffer));
+        json += ",\n";
+    }
+    json += "    \"values\": [";
+
+    LocalClock clock;
+    for (int i = size() - 1; i >= 0; --i) {
+        json += i == size() - 1 ? "\n        {\n            \"date\": \"" : ",\n        {\n            \"date\": \"";
+        clock.format(timestamp(i), buffer);
+        json.append(buffer, 19);
+        json += "\",\n";
+        if (flags(i) != 0) {
+            json += "            \"flags\": ";
+            json.append(buffer, int(std::to_chars(buffer, buffer + sizeof(buffer), int(flags(i))).ptr - buffer));
+            json += ",\n";
+        }
+        json += "            \"value\": ";
+        if (isValid(i) && qIsFinite(value(i))) {
+            json.append(buffer, formatFloat(buffer, value(i)));
+        } else {
+            json += "null";
+        }
+        json += "\n        }";
+    }
+    json += "\n    ]\n}\n";
+    return json;
+}
+
+/**
+ * @brief Implementation of toSegment().
+ */
+QByteArray SensorSeries::toSegment() const
+{
+    QByteArray key = m_key.toUtf8();
+    const int keyPadded = int((key.size() + 3) & ~3);
+
+    QByteArray segment;
+    segment.reserve(int(sizeof(kSegmentMagic)) + 16 + keyPadded + size() * 8 + d->validity.size() * 4
+                    + d->flags.size());
+    QDataStream out(&segment, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    out.writeRawData(kSegmentMagic, sizeof(kSegmentMagic));
+    out << quint32(size()) << qint32(m_sensorId) << quint32(d->validCount) << quint32(key.size());
+    key.append(keyPadded - key.size(), '\0');
+    out.writeRawData(key.constData(), int(key.size()));
+    for (qint32 time : d->timestamps)
+        out << time;
+    for (float value : d->values)
+        out << value;
+    for (quint32 word : d->validity)
+        out << word;
+    out.writeRawData(reinterpret_cast<const char *>(d->flags.constData()), int(d->flags.size()));
+    return segment;
+}
+
+/**
+ * @brief Implementation of mapSegment().
+ * @details The file is closed right after mapping; Qt keeps the mapping
+ * until the QFile object is destroyed, so a cached series holds no file
+ * descriptor. Windows refuses to replace or remove a mapped file, so a
+ * series held by a chart or the cache would make the writer's commit of
+ * the segment fail; there the file is read in one go instead.
+ */
+SensorSeries SensorSeries::mapSegment(const QString &filePath)
+{
+    QSharedPointer<QFile> file(new QFile(filePath));
+    if (!file->open(QIODevice::ReadOnly))
+        return SensorSeries();
+
+    const qint64 fileSize = file->size();
+    const qint64 headerSize = qint64(sizeof(kSegmentMagic)) + 16;
+#ifdef Q_OS_WIN
+    const QByteArray bytes = fileSize >= headerSize ? file->readAll() : QByteArray();
+    const uchar *data = bytes.size() == fileSize ? reinterpret_cast<const uchar *>(bytes.constData()) : nullptr;
+#else
+    const uchar *data = fileSize >= headerSize ? file->map(0, fileSize) : nullptr;
+#endif
+    file->close();
+    if (!data || memcmp(data, kSegmentMagic, sizeof(kSegmentMagic)) != 0)
+        return SensorSeries();
+
+    const uchar *header = data + sizeof(kSegmentMagic);
+    const quint32 count = qFromLittleEndian<quint32>(header);
+    const qint32 sensorId = qFromLittleEndian<qint32>(header + 4);
+    const quint32 validCount = qFromLittleEndian<quint32>(header + 8);
+    const quint32 keySize = qFromLittleEndian<quint32>(header + 12);
+    const qint64 columns = headerSize + ((qint64(keySize) + 3) & ~qint64(3));
+    const qint64 words = (qint64(count) + 31) / 32;
+    const qint64 flagsOffset = columns + qint64(count) * 8 + words * 4;
+    if (count > quint32(std::numeric_limits<int>::max() / 8)
+        || (fileSize != flagsOffset && fileSize != flagsOffset + count))
+        return SensorSeries();
+    const bool checked = count > 0 && fileSize == flagsOffset + count;
+
+    SensorSeries series;
+    series.setSensorId(sensorId);
+    series.setKey(QString::fromUtf8(reinterpret_cast<const char *>(data + headerSize), int(keySize)));
+
+    const auto *times = reinterpret_cast<const qint32 *>(data + columns);
+    const auto *values = reinterpret_cast<const float *>(data + columns + qint64(count) * 4);
+    const auto *validity = reinterpret_cast<const quint32 *>(data + columns + qint64(count) * 8);
+    const auto *flags = reinterpret_cast<const quint8 *>(data + flagsOffset);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN && defined(Q_OS_WIN)
+    series.d->timestamps = QVector<qint32>(times, times + count);
+    series.d->values = QVector<float>(values, values + count);
+    series.d->validity = QVector<quint32>(validity, validity + words);
+    series.d->validCount = int(validCount);
+    if (checked)
+        series.d->flags = QVector<quint8>(flags, flags + count);
+#elif Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    series.d->timestamps = QVector<qint32>::fromRawData(times, count);
+    series.d->values = QVector<float>::fromRawData(values, count);
+    series.d->validity = QVector<quint32>::fromRawData(validity, words);
+    series.d->validCount = int(validCount);
+    if (checked)
+        series.d->flags = QVector<quint8>::fromRawData(flags, count);
+    series.d->mapping = file;
+#else
+    series.reserve(int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        const quint32 bits = qFromLittleEndian(validity[i >> 5]);
+        series.append(qFromLittleEndian(times[i]), qFromLittleEndian(values[i]), bits & (1u << (i & 31)));
+        if (checked)
+            series.setFlags(int(i), flags[i]);
+    }
+    Q_UNUSED(validCount)
+#endif
+    return series;
+}
+
+/**
+ * @brief Implementation of lowerBound().
+ */
+int SensorSeries::lowerBound(qint32 time) const
+{
+    const QVector<qint32> &t = d->timestamps;
+    return int(std::lower_bound(t.cbegin(), t.cend(), time) - t.cbegin());
+}
+
+/**
+ * @brief Implementation of upperBound().
+ */
+int SensorSeries::upperBound(qint32 time) const
+{
+    const QVector<qint32> &t = d->timestamps;
+    return int(std::upper_bound(t.cbegin(), t.cend(), time) - t.cbegin());
+}
+
+/**
+ * @brief Implementation of reserve().
+ */
+void SensorSeries::reserve(int count)
+{
+    d->timestamps.reserve(count);
+    d->values.reserve(count);
+    d->validity.reserve((count + 31) / 32);
+}
+
+/**
+ * @brief Implementation of append().
+ */
+void SensorSeries::append(qint32 time, float value, bool valid)
+{
+    const int index = d->timestamps.size();
+    d->timestamps.append(time);
+    d->values.append(valid ? value : 0.0f);
+
+    if (!d->flags.isEmpty())
+        d->flags.append(0);
+    if ((index & 31) == 0)
+        d->validity.append(0);
+    if (valid) {
+        d->validity.last() |= 1u << (index & 31);
+        d->validCount++;
+    }
+}
+
+/**
+ * @brief Implementation of setFlags().
+ */
+void SensorSeries::setFlags(int i, quint8 flags)
+{
+    if (d->flags.isEmpty())
+        d->flags.fill(0, size());
+    d->flags[i] = flags;
+}
+
+/**
+ * @brief Implementation of memoryUsage().
+ * @details Interned strings are shared with other series and are counted at
+ * their full size here, so the result slightly overestimates.
+ */
+qsizetype SensorSeries::memoryUsage() const
+{
+    return qsizetype(sizeof(SensorSeries) + sizeof(SensorSeriesData))
+           + d->timestamps.capacity() * qsizetype(sizeof(qint32))
+           + d->values.capacity() * qsizetype(sizeof(float))
+           + d->validity.capacity() * qsizetype(sizeof(quint32))
+           + d->flags.capacity()
+           + (m_key.size() + m_location.size()) * qsizetype(sizeof(QChar));
+}
+
+/**
+ * @brief Implementation of intern().
+ * @details The pool only grows; it holds parameter codes and station names,
+ * which are bounded by the number of stations in the network.
+ */
+QString SensorSeries::intern(const QString &text)
+{
+    static QMutex mutex;
+    static QSet<QString> pool;
+
+    if (text.isEmpty())
+        return QString();
+
+    QMutexLocker locker(&mutex);
+    auto it = pool.constFind(text);
+    if (it == pool.cend())
+        it = pool.insert(text);
+    return *it;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file sensorseries.h
+ * @brief Compact, implicitly shared container for one sensor's measurements.
+ */
+
+#ifndef SENSORSERIES_H
+#define SENSORSERIES_H
+
+#include <QFile>
+#include <QMetaType>
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <QJsonObject>
+
+/**
+ * @brief Column storage shared between copies of a SensorSeries.
+ *
+ * Points are kept in ascending time order as parallel columns. A cleared
+ * bit in @c validity marks a point whose value was reported as null.
+ * @c flags holds QualityDetector flags once the series has been checked.
+ * For a mapped segment the columns are raw-data vectors over the mapping,
+ * which @c mapping keeps alive; the first modification copies them.
+ */
+class SensorSeriesData : public QSharedData
+{
+public:
+    QVector<qint32> timestamps; ///< Epoch seconds, ascending
+    QVector<float> values;      ///< Measured values (0 where invalid)
+    QVector<quint32> validity;  ///< One bit per point, set when value is present
+    int validCount = 0;         ///< Number of set bits in validity
+    QVector<quint8> flags;      ///< Quality flags per point; empty if never checked
+    QSharedPointer<QFile> mapping; ///< Mapped segment file, if any
+};
+
+/**
+ * @brief Read-only view of a contiguous column.
+ */
+template <typename T>
+struct ColumnSpan {
+    const T *data = nullptr;
+    int size = 0;
+
+    const T *begin() const { return data; }
+    const T *end() const { return data + size; }
+    const T &operator[](int i) const { return data[i]; }
+};
+
+/**
+ * @class SensorSeries
+ * @brief Value type holding the measurements of a single sensor.
+ *
+ * Copies share the point columns until one of them is modified, so passing a
+ * series through signals, lambdas and the database layer costs a pointer copy.
+ * A point takes 4 bytes of timestamp, 4 bytes of value and one validity bit.
+ * Key and location strings are interned so repeated series share them.
+ */
+class SensorSeries
+{
+public:
+    /**
+     * @brief Constructs an empty series.
+     */
+    SensorSeries();
+
+    /**
+     * @brief Builds a series from GIOS "getData" JSON.
+     * @param data Object with "key" and "values" (array of {date, value}).
+     * @param sensorId Sensor the data belongs to (0 if unknown).
+     * @return SensorSeries Parsed series, sorted by time. Empty on bad input.
+     */
+    static SensorSeries fromJson(const QJsonObject &data, int sensorId = 0);
+
+    /**
+     * @brief Builds a series straight from the bytes of a "getData" response.
+     * @param json Response body.
+     * @param sensorId Sensor the data belongs to (0 if unknown).
+     * @param series Receives the series; same result as fromJson() on the parsed document.
+     * @return bool False if the body uses JSON the reader does not handle
+     * (e.g. escaped strings) or is malformed; parse it with fromJson() then.
+     * @note Allocates no temporaries per point.
+     */
+    static bool fromResponse(const QByteArray &json, int sensorId, SensorSeries *series);
+
+    /**
+     * @brief Serializes the series back to the GIOS JSON layout.
+     * @return QJsonObject Newest point first, as returned by the API.
+     */
+    QJsonObject toJson() const;
+
+    /**
+     * @brief Serializes the series as indented JSON text.
+     * @return QByteArray Same document as QJsonDocument(toJson()).toJson(),
+     * built without per-point objects.
+     */
+    QByteArray toJsonBytes() const;
+
+    /**
+     * @brief Serializes the series as a segment file.
+     * @return QByteArray Segment, see mapSegment().
+     */
+    QByteArray toSegment() const;
+
+    /**
+     * @brief Maps a segment file written from toSegment().
+     * @param filePath Segment file.
+     * @return SensorSeries Series whose columns point into the mapping, empty
+     * if the file is missing or not a valid segment.
+     * @details Layout (little-endian, every field 4-byte aligned): the magic
+     * "WXSEG1\0\0", u32 point count, i32 sensor ID, u32 valid count, u32 key
+     * length, the UTF-8 key padded to 4 bytes, then the i32 timestamp, f32
+     * value and u32 validity columns, then for a checked series one u8 of
+     * quality flags per point. On big-endian hosts the columns are copied
+     * and byte-swapped. On Windows the file is read rather than mapped, so
+     * the writer can still replace it.
+     */
+    static SensorSeries mapSegment(const QString &filePath);
+
+    int sensorId() const { return m_sensorId; }
+    void setSensorId(int sensorId) { m_sensorId = sensorId; }
+
+    QString key() const { return m_key; }
+    void setKey(const QString &key) { m_key = intern(key); }
+
+    QString location() const { return m_location; }
+    void setLocation(const QString &location) { m_location = intern(location); }
+
+    int size() const { return d->timestamps.size(); }
+    bool isEmpty() const { return d->timestamps.isEmpty(); }
+    int validCount() const { return d->validCount; }
+
+    qint32 timestamp(int i) const { return d->timestamps.at(i); }
+    float value(int i) const { return d->values.at(i); }
+    bool isValid(int i) const { return d->validity.at(i >> 5) & (1u << (i & 31)); }
+
+    /**
+     * @brief Quality flags of a point (QualityDetector::Flag), 0 if clean or never checked.
+     */
+    quint8 flags(int i) const { return d->flags.isEmpty() ? 0 : d->flags.at(i); }
+
+    /**
+     * @brief Sets the quality flags of a point; the first call marks the series as checked.
+     */
+    void setFlags(int i, quint8 flags);
+
+    /**
+     * @brief Whether the series went through QualityDetector.
+     */
+    bool hasFlags() const { return !d->flags.isEmpty(); }
+
+    /**
+     * @brief Whether a point has a value and no quality flag.
+     */
+    bool isUsable(int i) const { return isValid(i) && flags(i) == 0; }
+
+    qint32 firstTimestamp() const { return d->timestamps.first(); }
+    qint32 lastTimestamp() const { return d->timestamps.last(); }
+
+    /**
+     * @brief Column views for loops over many points; valid until the series is modified.
+     */
+    ColumnSpan<qint32> timestamps() const { return { d->timestamps.constData(), size() }; }
+    ColumnSpan<float> values() const { return { d->values.constData(), size() }; }
+
+    /**
+     * @brief Whether the columns are read from a mapped segment file.
+     */
+    bool isMapped() const { return !d->mapping.isNull(); }
+
+    /**
+     * @brief Finds the first point not earlier than a given time.
+     * @param time Epoch seconds.
+     * @return int Index in [0, size()].
+     */
+    int lowerBound(qint32 time) const;
+
+    /**
+     * @brief Finds the first point later than a given time.
+     * @param time Epoch seconds.
+     * @return int Index in [0, size()].
+     */
+    int upperBound(qint32 time) const;
+
+    /**
+     * @brief Reserves room for a number of points.
+     * @param count Expected point count.
+     */
+    void reserve(int count);
+
+    /**
+     * @brief Appends a point.
+     * @param time Epoch seconds; must not be earlier than lastTimestamp().
+     * @param value Measured value.
+     * @param valid False when the value was missing.
+     */
+    void append(qint32 time, float value, bool valid = true);
+
+    /**
+     * @brief Approximate heap size of the series in bytes.
+     * @return qsizetype Bytes used by point columns and strings; mapped
+     * columns live in the page cache and are not counted.
+     */
+    qsizetype memoryUsage() const;
+
+    /**
+     * @brief Returns a shared instance of a string.
+     * @param text String to intern.
+     * @return QString Instance sharing its buffer with earlier equal strings.
+     */
+    static QString intern(const QString &text);
+
+private:
+    QSharedDataPointer<SensorSeriesData> d;
+    QString m_key;      ///< Parameter code, e.g. "PM10"
+    QString m_location; ///< Station display name
+    int m_sensorId = 0; ///< GIOS sensor ID
+};
+
+Q_DECLARE_METATYPE(SensorSeries)
+
+#endif // SENSORSERIES_H
@@ -0,0 +1,90 @@
+/**
+ * @file seriescache.cpp
+ * @brief Implementation of the decoded series cache.
+ */
+
+#include "seriescache.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <limits>
+
+SeriesCache::SeriesCache()
+{
+    setBudget(kDefaultBudget);
+}
+
+/**
+ * @brief Implementation of instance().
+ */
+SeriesCache &SeriesCache::instance()
+{
+    static SeriesCache cache;
+    return cache;
+}
+
+/**
+ * @brief Implementation of find().
+ */
+bool SeriesCache::find(const QString &key, SensorSeries *series, qint64 maxAgeMs)
+{
+    QMutexLocker locker(&m_mutex);
+    const Entry *entry = m_cache.object(key);
+    if (!entry || (maxAgeMs > 0 && QDateTime::currentMSecsSinceEpoch() - entry->storedMs > maxAgeMs)) {
+        m_misses++;
+        return false;
+    }
+
+    m_hits++;
+    *series = entry->series;
+    return true;
+}
+
+/**
+ * @brief Implementation of insert().
+ * @details Entries larger than the whole budget are refused by QCache.
+ */
+void SeriesCache::insert(const QString &key, const SensorSeries &series)
+{
+    if (series.isEmpty())
+        return;
+
+    const int cost = int(series.memoryUsage() / 1024) + 1;
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(key, new Entry{ series, QDateTime::currentMSecsSinceEpoch() }, cost);
+    qDebug() << "Cached" << key << "-" << m_cache.totalCost() << "of" << m_cache.maxCost() << "KiB used,"
+             << m_hits << "hits," << m_misses << "misses";
+}
+
+/**
+ * @brief Implementation of fileKey().
+ * @details Writers replace store files by rename, which gives the path a new
+ * modification time; the size catches replacements within the timestamp
+ * resolution of the file system.
+ */
+QString SeriesCache::fileKey(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    return QString("file:%1:%2:%3")
+        .arg(filePath)
+        .arg(info.lastModified().toMSecsSinceEpoch())
+        .arg(info.size());
+}
+
+/**
+ * @brief Implementation of setBudget().
+ */
+void SeriesCache::setBudget(qsizetype bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(int(qMin<qsizetype>(bytes / 1024, std::numeric_limits<int>::max())));
+}
+
+/**
+ * @brief Implementation of clear().
+ */
+void SeriesCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+}
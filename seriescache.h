@@ -0,0 +1,90 @@
+/**
+ * @file seriescache.h
+ * @brief Memory-budgeted cache of decoded sensor series.
+ */
+
+#ifndef SERIESCACHE_H
+#define SERIESCACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include "sensorseries.h"
+
+/**
+ * @class SeriesCache
+ * @brief Least-recently-used cache of decoded series, shared by the GUI.
+ *
+ * Holds series fetched from the API (keyed by sensor ID) and series loaded
+ * from the store (keyed by file path). Entries are charged by
+ * SensorSeries::memoryUsage() against a budget; when the budget is exceeded
+ * the least recently used entries are dropped. Since series are implicitly
+ * shared, a hit costs a reference count increment.
+ *
+ * API entries carry their fetch time so callers can ignore data older than
+ * the publication interval. File entries do not expire; instead their key
+ * includes the file's modification time and size, so a file replaced by a
+ * revision or a merge misses and is decoded again.
+ */
+class SeriesCache
+{
+public:
+    /**
+     * @brief Process-wide cache.
+     */
+    static SeriesCache &instance();
+
+    /**
+     * @brief Looks up an entry and marks it as recently used.
+     * @param key Key from sensorKey() or fileKey().
+     * @param series Receives the series on a hit.
+     * @param maxAgeMs Ignore entries older than this (0: any age).
+     * @return bool True on a hit.
+     */
+    bool find(const QString &key, SensorSeries *series, qint64 maxAgeMs = 0);
+
+    /**
+     * @brief Adds or replaces an entry; empty series are not cached.
+     */
+    void insert(const QString &key, const SensorSeries &series);
+
+    /**
+     * @brief Sets the memory budget.
+     * @param bytes Upper bound of the summed memoryUsage() of all entries.
+     */
+    void setBudget(qsizetype bytes);
+
+    /**
+     * @brief Drops all entries.
+     */
+    void clear();
+
+    static QString sensorKey(int sensorId) { return QString("sensor:%1").arg(sensorId); }
+
+    /**
+     * @brief Key of a store file in its current version.
+     * @param filePath Absolute path of the series file.
+     * @return QString Path, modification time and size.
+     */
+    static QString fileKey(const QString &filePath);
+
+    static const qsizetype kDefaultBudget = 64 * 1024 * 1024; ///< 64 MB
+
+private:
+    SeriesCache();
+
+    /**
+     * @brief Cached series with its insertion time.
+     */
+    struct Entry {
+        SensorSeries series;
+        qint64 storedMs;
+    };
+
+    QMutex m_mutex;
+    QCache<QString, Entry> m_cache; ///< Cost unit is KiB, so large budgets fit in an int
+    int m_hits = 0;
+    int m_misses = 0;
+};
+
+#endif // SERIESCACHE_H
@@ -0,0 +1,274 @@
+/**
+ * @file seriesexporter.cpp
+ * @brief Implementation of the streaming series exporter.
+ */
+
+#include "seriesexporter.h"
+#include "db.h"
+#include "storesnapshot.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <limits>
+
+namespace {
+/**
+ * @brief Saved files of one parameter, as found in a location directory.
+ */
+struct SeriesFiles {
+    QString key;
+    QStringList files; ///< In precedence order (see db::sortSeriesFiles())
+};
+
+/**
+ * @brief Quotes a CSV field when it contains separators or quotes.
+ */
+QByteArray csvField(const QString &text)
+{
+    QByteArray utf8 = text.toUtf8();
+    if (!utf8.contains(',') && !utf8.contains('"') && !utf8.contains('\n'))
+        return utf8;
+    utf8.replace("\"", "\"\"");
+    return '"' + utf8 + '"';
+}
+
+/**
+ * @brief Writes a length-prefixed UTF-8 string.
+ */
+void writeString(QDataStream &out, const QString &text)
+{
+    QByteArray utf8 = text.toUtf8().left(std::numeric_limits<quint16>::max());
+    out << quint16(utf8.size());
+    out.writeRawData(utf8.constData(), int(utf8.size()));
+}
+}
+
+/**
+ * @brief Stores the query; nothing is read until run().
+ */
+SeriesExporter::SeriesExporter(const ExportQuery &query, Format format, const QString &outputPath,
+                               QObject *parent)
+    : QObject(parent)
+    , m_query(query)
+    , m_format(format)
+    , m_outputPath(outputPath)
+{
+}
+
+/**
+ * @brief Stores the query and the output device; nothing is read until run().
+ */
+SeriesExporter::SeriesExporter(const ExportQuery &query, Format format, QIODevice *device, QObject *parent)
+    : QObject(parent)
+    , m_query(query)
+    , m_format(format)
+    , m_device(device)
+{
+}
+
+/**
+ * @brief Implementation of formatForPath().
+ */
+SeriesExporter::Format SeriesExporter::formatForPath(const QString &path)
+{
+    if (path.endsWith(".json", Qt::CaseInsensitive))
+        return Json;
+    return path.endsWith(".csv", Qt::CaseInsensitive) ? Csv : Columnar;
+}
+
+/**
+ * @brief Implementation of run().
+ * @details Makes two passes over one store snapshot: the first only counts
+ * matching file names for progress reporting, the second exports them.
+ * Files a collector adds while the export runs are not part of it; a file
+ * it replaces meanwhile is exported with whichever content is read.
+ * Within a location, the files of one parameter are merged as
+ * db::loadSeriesFiles() does, so overlapping files give one point per
+ * timestamp with the value the store reads back.
+ */
+void SeriesExporter::run()
+{
+    const QString root = db::getAppDataPath() + "/db";
+    const StoreSnapshot snapshot = StoreSnapshot::capture(root);
+
+    // Lists matching files of one location, grouped by key
+    auto listLocation = [this, &snapshot](const QString &location) {
+        QMap<QString, QStringList> byKey;
+        for (const QString &fileName : snapshot.files(location)) {
+            QString key;
+            qint32 from = 0, to = 0;
+            if (!db::parseSeriesFileName(fileName, &key, &from, &to))
+                continue;
+            if (!m_query.parameter.isEmpty() && key != m_query.parameter)
+                continue;
+            if (m_query.from != 0 && to < m_query.from)
+                continue;
+            if (m_query.to != 0 && from > m_query.to)
+                continue;
+            byKey[key].append(fileName);
+        }
+        QVector<SeriesFiles> groups;
+        for (auto k = byKey.cbegin(); k != byKey.cend(); ++k)
+            groups.append({ k.key(), db::sortSeriesFiles(k.value(), k.key()) });
+        return groups;
+    };
+
+    auto locationMatches = [this](const QString &name) {
+        return m_query.location.isEmpty() || name.contains(m_query.location, Qt::CaseInsensitive);
+    };
+
+    // Pass 1: count
+    int total = 0;
+    for (const QString &location : snapshot.locations()) {
+        if (!locationMatches(location))
+            continue;
+        for (const SeriesFiles &group : listLocation(location))
+            total += group.files.size();
+    }
+
+    QFile file(m_outputPath);
+    QIODevice *device = m_device;
+    if (!device) {
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            emit finished(false, "Could not open file for writing: " + m_outputPath);
+            return;
+        }
+        device = &file;
+    }
+
+    // Text output is batched; a failed write (e.g. a closed connection) ends the export
+    bool writeFailed = false;
+    auto write = [&](const QByteArray &data) {
+        if (!writeFailed && device->write(data) != data.size()) {
+            writeFailed = true;
+            m_cancelled = true;
+        }
+    };
+
+    QDataStream out(device);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    if (m_format == Csv)
+        write("location,parameter,sensor_id,timestamp,value\n");
+    else if (m_format == Json)
+        write("[");
+    else
+        out.writeRawData("WXCOL1\0\0", 8);
+
+    const qint32 rangeFrom = m_query.from != 0 ? qint32(m_query.from) : std::numeric_limits<qint32>::min();
+    const qint32 rangeTo = m_query.to != 0 ? qint32(m_query.to) : std::numeric_limits<qint32>::max();
+
+    // Pass 2: export
+    int done = 0;
+    qint64 rows = 0;
+    int runs = 0;
+    QByteArray buffer;
+    const QStringList locations = snapshot.locations();
+    for (const QString &location : locations) {
+        if (m_cancelled)
+            break;
+        if (!locationMatches(location))
+            continue;
+
+        for (const SeriesFiles &group : listLocation(location)) {
+            if (m_cancelled)
+                break;
+
+            const SensorSeries series = db::loadSeriesFiles(location, group.files);
+            const int begin = series.lowerBound(rangeFrom);
+            const int end = series.upperBound(rangeTo);
+
+            if (end > begin) {
+                if (m_format == Csv) {
+                    const QByteArray prefix = csvField(location) + ',' + csvField(series.key()) + ','
+                                              + QByteArray::number(series.sensorId()) + ',';
+                    for (int i = begin; i < end; ++i) {
+                        buffer += prefix;
+                        buffer += QDateTime::fromSecsSinceEpoch(series.timestamp(i))
+                                      .toString("yyyy-MM-dd HH:mm:ss").toLatin1();
+                        buffer += ',';
+                        if (series.isValid(i))
+                            buffer += QByteArray::number(double(series.value(i)), 'g', 7);
+                        buffer += '\n';
+                    }
+                    if (buffer.size() > (1 << 20)) {
+                        write(buffer);
+                        buffer.clear();
+                    }
+                } else if (m_format == Json) {
+                    QJsonObject header;
+                    header["location"] = location;
+                    header["parameter"] = series.key();
+                    header["sensorId"] = series.sensorId();
+                    QByteArray run = QJsonDocument(header).toJson(QJsonDocument::Compact);
+                    run.chop(1); // Reopen the object for the columns
+                    buffer += (runs > 0 ? ",\n" : "\n") + run + ",\"times\":[";
+                    for (int i = begin; i < end; ++i) {
+                        buffer += QByteArray::number(series.timestamp(i));
+                        buffer += i + 1 < end ? "," : "],\"values\":[";
+                    }
+                    for (int i = begin; i < end; ++i) {
+                        buffer += series.isValid(i) ? QByteArray::number(double(series.value(i)), 'g', 7) : "null";
+                        buffer += i + 1 < end ? "," : "]}";
+                    }
+                    if (buffer.size() > (1 << 20)) {
+                        write(buffer);
+                        buffer.clear();
+                    }
+                } else {
+                    out << quint32(end - begin);
+                    writeString(out, location);
+                    writeString(out, series.key());
+                    out << qint32(series.sensorId());
+                    for (int i = begin; i < end; ++i)
+                        out << qint32(series.timestamp(i));
+                    for (int i = begin; i < end; ++i)
+                        out << series.value(i);
+                    quint8 bits = 0;
+                    for (int i = begin; i < end; ++i) {
+                        if (series.isValid(i))
+                            bits |= quint8(1u << ((i - begin) & 7));
+                        if (((i - begin) & 7) == 7 || i == end - 1) {
+                            out << bits;
+                            bits = 0;
+                        }
+                    }
+                }
+                rows += end - begin;
+                runs++;
+            }
+
+            done += group.files.size();
+            emit progress(done, total);
+        }
+    }
+
+    if (m_format == Csv)
+        write(buffer);
+    else if (m_format == Json)
+        write(buffer + "\n]\n");
+    else
+        out << quint32(0);
+
+    writeFailed = writeFailed || out.status() != QDataStream::Ok;
+    if (!m_device) {
+        writeFailed = writeFailed || file.error() != QFileDevice::NoError;
+        file.close();
+    }
+
+    if (m_cancelled || writeFailed) {
+        if (!m_device)
+            file.remove();
+        emit finished(false, writeFailed ? "Could not write " + (m_device ? QString("the output") : m_outputPath)
+                                         : QString("Export cancelled"));
+        return;
+    }
+
+    emit finished(true, QString("Exported %1 rows from %2 files to %3")
+                            .arg(rows).arg(done)
+                            .arg(m_device ? QString("the output") : QFileInfo(m_outputPath).fileName()));
+}
@@ -0,0 +1,119 @@
+/**
+ * @file seriesexporter.h
+ * @brief Streaming export of stored sensor series to CSV or a columnar file.
+ */
+
+#ifndef SERIESEXPORTER_H
+#define SERIESEXPORTER_H
+
+#include <QIODevice>
+#include <QObject>
+#include <QString>
+#include <atomic>
+
+/**
+ * @brief Selection of stored data to export.
+ */
+struct ExportQuery {
+    QString location;  ///< Substring the location must contain (empty for all)
+    QString parameter; ///< Exact parameter key (empty for all)
+    qint64 from = 0;   ///< Range start in epoch seconds (0 for unbounded)
+    qint64 to = 0;     ///< Range end in epoch seconds (0 for unbounded)
+};
+
+/**
+ * @class SeriesExporter
+ * @brief Writes stored series matching a query to a file or stream, one series at a time.
+ *
+ * The store is walked directory by directory. The matching files of one
+ * parameter are merged by store precedence (see db::loadSeriesFiles()),
+ * written and released before the next parameter is read, so memory use is
+ * bounded by the largest single series regardless of selection size.
+ * Overlapping saved windows of the same series therefore give one point per
+ * timestamp.
+ *
+ * run() blocks; move the exporter to a QThread to keep the UI responsive.
+ *
+ * Columnar layout (little-endian): the magic "WXCOL1\0\0", then one block per
+ * series run of: u32 rowCount, u16 + UTF-8 location, u16 + UTF-8 key,
+ * i32 sensorId, rowCount x i32 epoch seconds, rowCount x f32 values,
+ * ceil(rowCount / 8) validity bytes (LSB first). A rowCount of 0 ends the file.
+ *
+ * JSON layout: an array with one object per series run, {"location",
+ * "parameter", "sensorId", "times": [epoch seconds], "values": [number or
+ * null]}.
+ */
+class SeriesExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Output formats.
+     */
+    enum Format {
+        Csv,      ///< location,parameter,sensor_id,timestamp,value
+        Columnar, ///< Binary column blocks, see class description
+        Json      ///< Column arrays per series run, see class description
+    };
+
+    /**
+     * @brief Constructs an exporter.
+     * @param query Data selection.
+     * @param format Output format.
+     * @param outputPath File to write.
+     * @param parent Parent QObject (optional).
+     */
+    SeriesExporter(const ExportQuery &query, Format format, const QString &outputPath,
+                   QObject *parent = nullptr);
+
+    /**
+     * @brief Constructs an exporter writing to an open device, e.g. a network stream.
+     * @param query Data selection.
+     * @param format Output format.
+     * @param device Open device; not closed by the exporter. A failed write cancels the export.
+     * @param parent Parent QObject (optional).
+     */
+    SeriesExporter(const ExportQuery &query, Format format, QIODevice *device, QObject *parent = nullptr);
+
+    /**
+     * @brief Picks a format from a file extension (".csv", ".json" or anything else).
+     */
+    static Format formatForPath(const QString &path);
+
+public slots:
+    /**
+     * @brief Performs the export.
+     * @note Emits progress() per file and finished() once at the end.
+     */
+    void run();
+
+    /**
+     * @brief Requests the running export to stop; safe from any thread.
+     */
+    void cancel() { m_cancelled = true; }
+
+signals:
+    /**
+     * @brief Emitted after each processed file.
+     * @param done Files processed so far.
+     * @param total Files matching the query.
+     */
+    void progress(int done, int total);
+
+    /**
+     * @brief Emitted when the export ends.
+     * @param ok False on error or cancellation.
+     * @param message Summary or error description.
+     */
+    void finished(bool ok, const QString &message);
+
+private:
+    ExportQuery m_query;
+    Format m_format;
+    QString m_outputPath;
+    QIODevice *m_device = nullptr; ///< Output if not writing to m_outputPath
+    std::atomic_bool m_cancelled{false};
+};
+
+#endif // SERIESEXPORTER_H
@@ -0,0 +1,104 @@
+/**
+ * @file seriesring.cpp
+ * @brief Implementation of the sensor point ring buffer.
+ */
+
+#include "seriesring.h"
+#include <QtNumeric>
+#include <algorithm>
+
+/**
+ * @brief Implementation of the constructor.
+ */
+SeriesRing::SeriesRing(int capacity)
+    : m_points(qMax(1, capacity))
+{
+}
+
+/**
+ * @brief Implementation of add().
+ */
+bool SeriesRing::add(qint32 time, float value, quint8 flags)
+{
+    const Point point{ time, value, flags };
+    if (isEmpty() || time > lastTimestamp()) {
+        if (size() == capacity())
+            evictOldest();
+        push(point);
+        return true;
+    }
+    if (time < firstTimestamp())
+        return false;
+
+    // Revision or late point: merge into a copy of the window
+    QVector<Point> points;
+    points.reserve(size() + 1);
+    for (int i = 0; i < size(); ++i)
+        points.append(at(i));
+    auto it = std::lower_bound(points.begin(), points.end(), time,
+                               [](const Point &p, qint32 t) { return p.time < t; });
+    if (it != points.end() && it->time == time)
+        *it = point;
+    else
+        points.insert(it, point);
+    if (points.size() > capacity())
+        points.removeFirst();
+    rebuild(points);
+    return false;
+}
+
+/**
+ * @brief Appends a point after the newest one; the ring must not be full.
+ */
+void SeriesRing::push(const Point &point)
+{
+    const qint64 seq = m_end++;
+    m_points[int(seq % m_points.size())] = point;
+    if (point.flags != 0)
+        m_flagged++;
+    if (point.flags != 0 || qIsNaN(point.value))
+        return;
+
+    m_sum += point.value;
+    m_usable++;
+    while (!m_minQueue.empty() && slot(m_minQueue.back()).value >= point.value)
+        m_minQueue.pop_back();
+    m_minQueue.push_back(seq);
+    while (!m_maxQueue.empty() && slot(m_maxQueue.back()).value <= point.value)
+        m_maxQueue.pop_back();
+    m_maxQueue.push_back(seq);
+}
+
+/**
+ * @brief Drops the oldest point and its share of the statistics.
+ */
+void SeriesRing::evictOldest()
+{
+    const Point &oldest = slot(m_begin);
+    if (oldest.flags != 0) {
+        m_flagged--;
+    } else if (!qIsNaN(oldest.value)) {
+        m_sum -= oldest.value;
+        m_usable--;
+    }
+    if (!m_minQueue.empty() && m_minQueue.front() == m_begin)
+        m_minQueue.pop_front();
+    if (!m_maxQueue.empty() && m_maxQueue.front() == m_begin)
+        m_maxQueue.pop_front();
+    m_begin++;
+}
+
+/**
+ * @brief Refills the ring from sorted points, recomputing the statistics.
+ */
+void SeriesRing::rebuild(const QVector<Point> &points)
+{
+    m_begin = m_end = 0;
+    m_sum = 0;
+    m_usable = 0;
+    m_flagged = 0;
+    m_minQueue.clear();
+    m_maxQueue.clear();
+    for (const Point &point : points)
+        push(point);
+}
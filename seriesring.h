@@ -0,0 +1,86 @@
+/**
+ * @file seriesring.h
+ * @brief Fixed-capacity window of the newest points of a sensor, with running statistics.
+ */
+
+#ifndef SERIESRING_H
+#define SERIESRING_H
+
+#include <QVector>
+#include <deque>
+
+/**
+ * @class SeriesRing
+ * @brief Ring buffer of time-ordered points that keeps its statistics up to date.
+ *
+ * Appending a point newer than all others costs O(1) amortized: the
+ * oldest point is overwritten once the ring is full, the sum is adjusted
+ * and the minimum and maximum come from monotonic queues of the points in
+ * the window. Only points that are valid and carry no quality flag count
+ * in the statistics.
+ *
+ * A point at or before the newest timestamp (a revised or late value) is
+ * merged into the window and the statistics are rebuilt, which costs
+ * O(capacity); add() reports it so that views can rebuild as well.
+ */
+class SeriesRing
+{
+public:
+    /**
+     * @brief One point in the window.
+     */
+    struct Point {
+        qint32 time = 0;
+        float value = 0;
+        quint8 flags = 0; ///< QualityDetector::Flag bits
+    };
+
+    /**
+     * @brief Constructs an empty ring.
+     * @param capacity Maximum number of points kept (at least 1).
+     */
+    explicit SeriesRing(int capacity);
+
+    int capacity() const { return m_points.size(); }
+    int size() const { return int(m_end - m_begin); }
+    bool isEmpty() const { return m_end == m_begin; }
+
+    /**
+     * @brief Point by age, 0 being the oldest in the window.
+     */
+    const Point &at(int i) const { return slot(m_begin + i); }
+
+    qint32 firstTimestamp() const { return at(0).time; }
+    qint32 lastTimestamp() const { return at(size() - 1).time; }
+
+    /**
+     * @brief Adds a point, evicting the oldest if the ring is full.
+     * @return bool True if the point was appended after all others; false
+     * if it revised or filled in the window (statistics were rebuilt) or
+     * was older than the window (ignored).
+     */
+    bool add(qint32 time, float value, quint8 flags = 0);
+
+    int usableCount() const { return m_usable; }   ///< Points counted in the statistics
+    int flaggedCount() const { return m_flagged; } ///< Points with quality flags
+    double mean() const { return m_usable > 0 ? m_sum / m_usable : 0; }
+    float min() const { return m_usable > 0 ? slot(m_minQueue.front()).value : 0; }
+    float max() const { return m_usable > 0 ? slot(m_maxQueue.front()).value : 0; }
+
+private:
+    QVector<Point> m_points;
+    qint64 m_begin = 0; ///< Sequence number of the oldest point
+    qint64 m_end = 0;   ///< Sequence number after the newest point
+    double m_sum = 0;
+    int m_usable = 0;
+    int m_flagged = 0;
+    std::deque<qint64> m_minQueue; ///< Usable points with increasing values, oldest first
+    std::deque<qint64> m_maxQueue; ///< Usable points with decreasing values, oldest first
+
+    const Point &slot(qint64 seq) const { return m_points[int(seq % m_points.size())]; }
+    void push(const Point &point);
+    void evictOldest();
+    void rebuild(const QVector<Point> &points);
+};
+
+#endif // SERIESRING_H
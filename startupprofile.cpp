@@ -0,0 +1,55 @@
+/**
+ * @file startupprofile.cpp
+ * @brief Implementation of the startup milestones.
+ */
+
+#include "startupprofile.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSet>
+
+namespace {
+QMutex mutex;
+QElapsedTimer clock;
+QSet<QString> reached;
+}
+
+/**
+ * @brief Implementation of start().
+ */
+void StartupProfile::start()
+{
+    QMutexLocker locker(&mutex);
+    clock.start();
+    reached.clear();
+}
+
+/**
+ * @brief Implementation of mark().
+ */
+void StartupProfile::mark(const QString &milestone)
+{
+    QMutexLocker locker(&mutex);
+    if (!clock.isValid() || reached.contains(milestone))
+        return;
+    reached.insert(milestone);
+    qInfo().noquote() << "Startup:" << milestone << "at" << clock.elapsed() << "ms";
+}
+
+/**
+ * @brief Implementation of elapsed().
+ */
+qint64 StartupProfile::elapsed()
+{
+    QMutexLocker locker(&mutex);
+    return clock.isValid() ? clock.elapsed() : 0;
+}
+
+/**
+ * @brief Implementation of isBenchmarkRun().
+ */
+bool StartupProfile::isBenchmarkRun()
+{
+    return qEnvironmentVariableIsSet(kBenchmarkVariable);
+}
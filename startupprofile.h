@@ -0,0 +1,52 @@
+/**
+ * @file startupprofile.h
+ * @brief Timestamps of the application's startup milestones.
+ */
+
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include <QString>
+
+/**
+ * @class StartupProfile
+ * @brief Process-wide startup clock that logs milestones as they are reached.
+ *
+ * The clock starts in main(), before the application object exists, so
+ * times exclude only loading the executable and its libraries. Each
+ * milestone is logged once as "Startup: <name> at <ms> ms"; the
+ * --startup-bench command reads these lines from the processes it starts.
+ */
+class StartupProfile
+{
+public:
+    /**
+     * @brief Starts the clock; call first thing in main().
+     */
+    static void start();
+
+    /**
+     * @brief Logs a milestone the first time it is reached.
+     * @param milestone Short name, e.g. "first-paint".
+     * @note Thread-safe.
+     */
+    static void mark(const QString &milestone);
+
+    /**
+     * @brief Milliseconds since start().
+     */
+    static qint64 elapsed();
+
+    /**
+     * @brief Whether this process was started by --startup-bench.
+     * @details Such a process quits once startup is complete.
+     */
+    static bool isBenchmarkRun();
+
+    /**
+     * @brief Environment variable that marks a benchmark run.
+     */
+    static constexpr const char *kBenchmarkVariable = "WEATHERAPP_STARTUP_BENCH";
+};
+
+#endif // STARTUPPROFILE_H
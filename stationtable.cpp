@@ -0,0 +1,140 @@
+/**
+ * @file stationtable.cpp
+ * @brief Implementation of the station table and string pool.
+ */
+
+#include "stationtable.h"
+#include <QJsonObject>
+#include <QtNumeric>
+
+/**
+ * @brief Implementation of StringPool::add().
+ */
+qint32 StringPool::add(const QString &text)
+{
+    auto it = m_index.constFind(text);
+    if (it != m_index.cend())
+        return *it;
+
+    const qint32 index = m_strings.size();
+    m_strings.append(text);
+    m_index.insert(text, index);
+    return index;
+}
+
+void StringPool::clear()
+{
+    m_strings.clear();
+    m_index.clear();
+}
+
+/**
+ * @brief Implementation of StringPool::memoryUsage().
+ * @details The hash shares its keys' buffers with m_strings, so only the
+ * node overhead is counted for it.
+ */
+qsizetype StringPool::memoryUsage() const
+{
+    qsizetype bytes = m_strings.capacity() * qsizetype(sizeof(QString));
+    for (const QString &text : m_strings)
+        bytes += text.capacity() * qsizetype(sizeof(QChar));
+    bytes += m_index.capacity() * qsizetype(sizeof(QString) + sizeof(qint32) + sizeof(void *));
+    return bytes;
+}
+
+/**
+ * @brief Implementation of load().
+ */
+void StationTable::load(const QJsonArray &stations)
+{
+    const int count = stations.size();
+    for (QVector<qint32> *column : { &m_city, &m_district, &m_province, &m_street, &m_code }) {
+        column->clear();
+        column->reserve(count);
+    }
+    m_ids.clear();
+    m_ids.reserve(count);
+    m_lat.clear();
+    m_lat.reserve(count);
+    m_lon.clear();
+    m_lon.reserve(count);
+    m_pool.clear();
+    m_rowById.clear();
+    m_rowById.reserve(count);
+    m_rowsByNameHash.clear();
+    m_rowsByNameHash.reserve(count);
+
+    for (const QJsonValue &value : stations) {
+        if (!value.isObject()) continue;
+        const QJsonObject obj = value.toObject();
+
+        const int row = m_ids.size();
+        m_ids.append(obj["id"].toInt());
+        m_city.append(m_pool.add(obj["city"].toString()));
+        m_district.append(m_pool.add(obj["district"].toString()));
+        m_province.append(m_pool.add(obj["province"].toString()));
+        m_street.append(m_pool.add(obj["station_street"].toString()));
+        m_code.append(m_pool.add(obj["station_code"].toString()));
+        m_lat.append(obj["lat"].toDouble(qQNaN()));
+        m_lon.append(obj["lon"].toDouble(qQNaN()));
+
+        m_rowById.insert(m_ids.last(), row);
+        m_rowsByNameHash.insert(qHash(normalize(displayName(row))), row);
+    }
+}
+
+/**
+ * @brief Implementation of rowForName().
+ */
+int StationTable::rowForName(const QString &name) const
+{
+    const QString normalized = normalize(name);
+    auto range = m_rowsByNameHash.equal_range(qHash(normalized));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (normalize(displayName(*it)) == normalized)
+            return *it;
+    }
+    return -1;
+}
+
+/**
+ * @brief Implementation of displayName().
+ */
+QString StationTable::displayName(int row) const
+{
+    return QString("%1, %2, %3, %4").arg(city(row), district(row), province(row), street(row));
+}
+
+/**
+ * @brief Implementation of displayNames().
+ */
+QStringList StationTable::displayNames() const
+{
+    QStringList names;
+    names.reserve(size());
+    for (int row = 0; row < size(); ++row)
+        names.append(displayName(row));
+    return names;
+}
+
+/**
+ * @brief Implementation of memoryUsage().
+ */
+qsizetype StationTable::memoryUsage() const
+{
+    return m_ids.capacity() * qsizetype(sizeof(int))
+           + (m_city.capacity() + m_district.capacity() + m_province.capacity()
+              + m_street.capacity() + m_code.capacity()) * qsizetype(sizeof(qint32))
+           + (m_lat.capacity() + m_lon.capacity()) * qsizetype(sizeof(double))
+           + m_pool.memoryUsage()
+           + m_rowById.capacity() * qsizetype(2 * sizeof(int) + sizeof(void *))
+           + m_rowsByNameHash.capacity() * qsizetype(sizeof(size_t) + sizeof(int) + 2 * sizeof(void *));
+}
+
+/**
+ * @brief Implementation of normalize().
+ */
+QString StationTable::normalize(const QString &name)
+{
+    return name.simplified().toCaseFolded();
+}
@@ -0,0 +1,135 @@
+/**
+ * @file stationtable.h
+ * @brief Column-oriented table of monitoring stations.
+ */
+
+#ifndef STATIONTABLE_H
+#define STATIONTABLE_H
+
+#include <QHash>
+#include <QJsonArray>
+#include <QMultiHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @class StringPool
+ * @brief Deduplicated strings addressed by a 32-bit index.
+ *
+ * Province, district and city names repeat across hundreds of stations;
+ * each distinct name is stored once and rows refer to it by index.
+ */
+class StringPool
+{
+public:
+    /**
+     * @brief Adds a string if new.
+     * @return qint32 Index of the (possibly existing) string.
+     */
+    qint32 add(const QString &text);
+
+    /**
+     * @brief String at an index returned by add().
+     */
+    const QString &at(qint32 index) const { return m_strings.at(index); }
+
+    int size() const { return m_strings.size(); }
+    void clear();
+
+    /**
+     * @brief Approximate heap size in bytes.
+     */
+    qsizetype memoryUsage() const;
+
+private:
+    QVector<QString> m_strings;
+    QHash<QString, qint32> m_index;
+};
+
+/**
+ * @class StationTable
+ * @brief Stations of the station cache as a struct of arrays.
+ *
+ * Every attribute is a separate column indexed by row, with the text
+ * columns holding StringPool indexes. IDs map to rows through a hash, and
+ * so do display names ("City, District, Province, Street"). The name hash
+ * is keyed by the hash of the normalized name only, and candidates are
+ * confirmed by rebuilding the row's name, so display strings are not kept
+ * as keys. The completer gets its list from displayNames() and owns the
+ * only full copy.
+ */
+class StationTable
+{
+public:
+    /**
+     * @brief Replaces the table with the entries of a station cache.
+     * @param stations Array written by ApiClient::processStationsData().
+     */
+    void load(const QJsonArray &stations);
+
+    int size() const { return m_ids.size(); }
+    bool isEmpty() const { return m_ids.isEmpty(); }
+
+    /**
+     * @brief Row of a station ID.
+     * @return int Row, or -1 if unknown.
+     */
+    int rowForId(int id) const { return m_rowById.value(id, -1); }
+
+    /**
+     * @brief Row of a display name; case and repeated spaces are ignored.
+     * @return int Row, or -1 if unknown.
+     */
+    int rowForName(const QString &name) const;
+
+    int id(int row) const { return m_ids.at(row); }
+    const QString &city(int row) const { return m_pool.at(m_city.at(row)); }
+    const QString &district(int row) const { return m_pool.at(m_district.at(row)); }
+    const QString &province(int row) const { return m_pool.at(m_province.at(row)); }
+    const QString &street(int row) const { return m_pool.at(m_street.at(row)); }
+    const QString &code(int row) const { return m_pool.at(m_code.at(row)); }
+    double latitude(int row) const { return m_lat.at(row); }
+    double longitude(int row) const { return m_lon.at(row); }
+
+    /**
+     * @brief Display name of a row, built on demand.
+     * @return QString "City, District, Province, Street"
+     */
+    QString displayName(int row) const;
+
+    /**
+     * @brief Display names of all rows, in row order.
+     */
+    QStringList displayNames() const;
+
+    const QVector<int> &ids() const { return m_ids; }
+    const QVector<double> &latitudes() const { return m_lat; }
+    const QVector<double> &longitudes() const { return m_lon; }
+
+    /**
+     * @brief Approximate heap size in bytes, including indexes and pool.
+     */
+    qsizetype memoryUsage() const;
+
+    /**
+     * @brief Normalizes a name for lookups (case-folded, whitespace simplified).
+     */
+    static QString normalize(const QString &name);
+
+private:
+    QVector<int> m_ids;
+    QVector<qint32> m_city;
+    QVector<qint32> m_district;
+    QVector<qint32> m_province;
+    QVector<qint32> m_street;
+    QVector<qint32> m_code;
+    QVector<double> m_lat;
+    QVector<double> m_lon;
+
+    StringPool m_pool;
+    QHash<int, int> m_rowById;
+    QMultiHash<size_t, int> m_rowsByNameHash;
+};
+
+#endif // STATIONTABLE_H
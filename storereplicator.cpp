@@ -0,0 +1,416 @@
+/**
+ * @file storereplicator.cpp
+ * @brief Implementation of delta replication between stores.
+ */
+
+#include "storereplicator.h"
+#include "storesnapshot.h"
+#include "writeaheadlog.h"
+#include "db.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kBundleMagic[] = "WXREP1\0\0";
+const char kManifestMagic[] = "WXHAS1\0\0";
+
+QByteArray sha256(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+/**
+ * @brief Received file, verified and parsed.
+ */
+struct Incoming {
+    QString path;
+    QString location;
+    QString key;
+    QByteArray hash;
+    QByteArray content;
+    SensorSeries series;
+};
+
+/**
+ * @brief Checks that a relative path names a series file directly below a location.
+ */
+bool isSeriesPath(const QString &path, QString *location, QString *key)
+{
+    const QStringList parts = path.split('/');
+    if (parts.size() != 2 || parts[0].isEmpty() || parts[0] == "." || parts[0] == ".."
+        || path.contains('\\'))
+        return false;
+    qint32 from = 0;
+    qint32 to = 0;
+    *location = parts[0];
+    return db::parseSeriesFileName(parts[1], key, &from, &to);
+}
+
+/**
+ * @brief Parses the JSON of a series file.
+ * @return SensorSeries Empty if the content is not a series.
+ */
+SensorSeries parseSeries(const QByteArray &content, const QString &location)
+{
+    const QJsonDocument document = QJsonDocument::fromJson(content);
+    if (!document.isObject())
+        return SensorSeries();
+    SensorSeries series = SensorSeries::fromJson(document.object(), document.object()["sensorId"].toInt());
+    series.setLocation(location);
+    return series;
+}
+
+/**
+ * @brief Loads a local series file as the commit being built sees it.
+ */
+SensorSeries loadLocal(const WriteAheadLog::Transaction &transaction, const QString &root, const QString &path,
+                       const QString &location)
+{
+    QByteArray content;
+    if (transaction.pending(path, &content))
+        return parseSeries(content, location);
+    return db::loadSensorData(root + "/" + path, location);
+}
+}
+
+/**
+ * @brief Implementation of the constructor.
+ */
+StoreReplicator::StoreReplicator(const QString &rootPath)
+    : m_root(rootPath.isEmpty() ? db::getAppDataPath() + "/db" : rootPath)
+{
+    QDir().mkpath(m_root);
+}
+
+/**
+ * @brief Implementation of manifest().
+ */
+QByteArray StoreReplicator::manifest()
+{
+    refreshIndex();
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(kManifestMagic, 8);
+    out << quint32(m_index.size());
+    for (auto it = m_index.cbegin(); it != m_index.cend(); ++it)
+        out.writeRawData(it.key().constData(), kHashBytes);
+    return data;
+}
+
+/**
+ * @brief Implementation of parseManifest().
+ */
+QSet<QByteArray> StoreReplicator::parseManifest(const QByteArray &data, bool *ok)
+{
+    QSet<QByteArray> hashes;
+    const bool valid = data.size() >= 12 && data.startsWith(QByteArray(kManifestMagic, 8));
+    quint32 count = 0;
+    if (valid)
+        memcpy(&count, data.constData() + 8, sizeof(count));
+    count = qFromLittleEndian(count);
+    if (!valid || data.size() != 12 + qint64(count) * kHashBytes) {
+        if (ok)
+            *ok = false;
+        return hashes;
+    }
+
+    hashes.reserve(count);
+    for (quint32 i = 0; i < count; ++i)
+        hashes.insert(data.mid(12 + qsizetype(i) * kHashBytes, kHashBytes));
+    if (ok)
+        *ok = true;
+    return hashes;
+}
+
+/**
+ * @brief Implementation of createBundle().
+ * @details Files are read after the lock is released; each is hashed again
+ * while it is read, so a file replaced by a merge since it was indexed is
+ * left out (its new content is indexed under its new hash).
+ */
+int StoreReplicator::createBundle(const QSet<QByteArray> &peerHashes, QIODevice *out)
+{
+    refreshIndex();
+
+    QVector<QPair<QString, QByteArray>> missing; // Path, hash
+    for (auto it = m_index.cbegin(); it != m_index.cend(); ++it) {
+        if (!it.value().isEmpty() && !peerHashes.contains(it.key()))
+            missing.append(qMakePair(it.value(), it.key()));
+    }
+    std::sort(missing.begin(), missing.end());
+
+    QCryptographicHash bundleHash(QCryptographicHash::Sha256);
+    bool failed = false;
+    auto write = [&](const QByteArray &data) {
+        bundleHash.addData(data);
+        failed = failed || out->write(data) != data.size();
+    };
+    auto number = [](auto value) {
+        value = qToLittleEndian(value);
+        return QByteArray(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+
+    write(QByteArray(kBundleMagic, 8));
+    int files = 0;
+    for (const auto &[path, hash] : std::as_const(missing)) {
+        QFile file(m_root + "/" + path);
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+        const QByteArray content = file.readAll();
+        if (sha256(content) != hash)
+            continue;
+        const QByteArray pathBytes = path.toUtf8();
+        const QByteArray compressed = qCompress(content);
+        write(number(quint16(pathBytes.size())) + pathBytes + hash);
+        write(number(quint32(compressed.size())));
+        write(compressed);
+        if (failed)
+            return -1;
+        files++;
+    }
+    write(number(quint16(0)));
+    if (failed || out->write(bundleHash.result()) != kHashBytes)
+        return -1;
+    return files;
+}
+
+/**
+ * @brief Implementation of applyBundle().
+ * @details The files are written in one write-ahead log commit. Its build
+ * runs under the StoreLock and compares each received file with the local
+ * files of the same parameter whose time range overlaps it, including
+ * files written earlier in the same bundle, so a concurrent save cannot
+ * slip in between. The same commit empties the tile pyramids of the
+ * touched parameters, which are then rebuilt with the received points;
+ * their index caches are removed afterwards.
+ */
+StoreReplicator::ApplyResult StoreReplicator::applyBundle(const QByteArray &bundle)
+{
+    ApplyResult result;
+    if (bundle.size() < 8 + 2 + kHashBytes || !bundle.startsWith(QByteArray(kBundleMagic, 8))) {
+        result.error = "Not a replication bundle";
+        return result;
+    }
+    const QByteArray body = bundle.chopped(kHashBytes);
+    if (sha256(body) != bundle.right(kHashBytes)) {
+        result.error = "Bundle checksum mismatch";
+        return result;
+    }
+
+    // Verify everything before writing anything
+    QVector<Incoming> incoming;
+    QDataStream in(body);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.skipRawData(8);
+    for (;;) {
+        quint16 pathSize = 0;
+        in >> pathSize;
+        if (in.status() != QDataStream::Ok || pathSize == 0)
+            break;
+        QByteArray pathBytes(pathSize, Qt::Uninitialized);
+        QByteArray hash(kHashBytes, Qt::Uninitialized);
+        quint32 compressedSize = 0;
+        in.readRawData(pathBytes.data(), pathSize);
+        in.readRawData(hash.data(), kHashBytes);
+        in >> compressedSize;
+        if (in.status() != QDataStream::Ok || compressedSize > quint32(body.size()))
+            break;
+        QByteArray compressed(compressedSize, Qt::Uninitialized);
+        if (in.readRawData(compressed.data(), compressedSize) != qint64(compressedSize))
+            break;
+
+        Incoming file;
+        file.path = QString::fromUtf8(pathBytes);
+        file.hash = hash;
+        file.content = qUncompress(compressed);
+        if (!isSeriesPath(file.path, &file.location, &file.key) || sha256(file.content) != hash) {
+            result.error = "Damaged file in bundle: " + file.path;
+            return result;
+        }
+        file.series = parseSeries(file.content, file.location);
+        if (file.series.isEmpty() || file.series.key() != file.key) {
+            result.error = "Invalid series in bundle: " + file.path;
+            return result;
+        }
+        incoming.append(file);
+    }
+    if (in.status() != QDataStream::Ok || !in.atEnd()) {
+        result.error = "Bundle is truncated";
+        return result;
+    }
+
+    refreshIndex();
+    QByteArray absorbedLines;
+    QSet<QString> touched; // "location/key"
+
+    const bool committed = WriteAheadLog::at(m_root).write([&](WriteAheadLog::Transaction &transaction) {
+        const StoreSnapshot snapshot = StoreSnapshot::capture(m_root);
+        for (const Incoming &file : std::as_const(incoming)) {
+            if (m_index.contains(file.hash)) {
+                result.known++;
+                continue;
+            }
+
+            // Valid flag of every local point the received file could duplicate
+            QStringList names = snapshot.files(file.location);
+            for (const QString &name : transaction.pendingFiles(file.location)) {
+                if (!names.contains(name))
+                    names.append(name);
+            }
+            QHash<qint32, bool> local;
+            const qint32 first = file.series.firstTimestamp();
+            const qint32 last = file.series.lastTimestamp();
+            for (const QString &fileName : std::as_const(names)) {
+                QString key;
+                qint32 from = 0;
+                qint32 to = 0;
+                if (!db::parseSeriesFileName(fileName, &key, &from, &to) || key != file.key || to < first || from > last)
+                    continue;
+                const SensorSeries series = loadLocal(transaction, m_root, file.location + "/" + fileName, file.location);
+                for (int i = series.lowerBound(first); i < series.upperBound(last); ++i)
+                    local[series.timestamp(i)] = local.value(series.timestamp(i)) || series.isValid(i);
+            }
+
+            int newPoints = 0;
+            for (int i = 0; i < file.series.size(); ++i) {
+                auto it = local.constFind(file.series.timestamp(i));
+                newPoints += it == local.cend() || (!*it && file.series.isValid(i));
+            }
+
+            if (newPoints == 0) {
+                absorbedLines += file.hash.toHex() + '\n';
+                m_index.insert(file.hash, QString());
+                result.absorbed++;
+                continue;
+            }
+
+            if (transaction.pending(file.path) || QFile::exists(m_root + "/" + file.path)) {
+                // Received points replace local ones, as when a save fetches a window again
+                const SensorSeries merged = db::mergeByPrecedence(
+                    { loadLocal(transaction, m_root, file.path, file.location), file.series });
+                transaction.write({ db::segmentPath(file.path), merged.toSegment() });
+                transaction.write({ file.path, merged.toJsonBytes() });
+                absorbedLines += file.hash.toHex() + '\n';
+                m_index.insert(file.hash, QString());
+                result.merged++;
+            } else {
+                transaction.write({ db::segmentPath(file.path), file.series.toSegment() });
+                transaction.write({ file.path, file.content });
+                result.added++;
+            }
+            touched.insert(file.location + "/" + file.key);
+        }
+
+        // Emptied pyramids are rebuilt with the received points on their next load
+        for (const QString &id : std::as_const(touched))
+            transaction.write({ id + ".pyr", QByteArray() });
+    });
+
+    if (!committed) {
+        result.error = "Could not write the received files";
+        result.added = result.merged = 0;
+        // Forget the hashes recorded for files that were not written
+        m_index.clear();
+        m_indexedVersion = 0;
+        m_indexLoaded = false;
+    } else {
+        {
+            StoreLock lock(m_root);
+            appendIndex(absorbedLines);
+        }
+        refreshIndex();
+        for (const QString &id : std::as_const(touched))
+            QFile::remove(m_root + "/" + id.section('/', 0, 0) + "/index.aqi");
+    }
+
+    result.ok = result.error.isEmpty();
+    qDebug() << "Applied bundle:" << result.added << "added," << result.merged << "merged,"
+             << result.absorbed << "absorbed," << result.known << "known";
+    return result;
+}
+
+/**
+ * @brief Loads the hash index and hashes the files published since it was last updated.
+ * @details Files are hashed without the StoreLock: commits replace files
+ * whole, and a file replaced after it was read here is published, and
+ * hashed, again. The lock is taken only to create the manifest or to
+ * update the index file.
+ */
+void StoreReplicator::refreshIndex()
+{
+    const QString indexPath = m_root + "/REPLICA";
+    if (!m_indexLoaded) {
+        m_indexLoaded = true;
+        QFile index(indexPath);
+        if (index.open(QIODevice::ReadOnly)) {
+            while (!index.atEnd()) {
+                const QByteArray line = index.readLine();
+                if (!line.endsWith('\n'))
+                    break; // Torn by a crash; the files are hashed again below
+                if (line.startsWith('@')) {
+                    m_indexedVersion = line.mid(1).trimmed().toLongLong();
+                    continue;
+                }
+                const QByteArray hash = QByteArray::fromHex(line.left(2 * kHashBytes));
+                const QString path = QString::fromUtf8(line.mid(2 * kHashBytes + 1).trimmed());
+                if (hash.size() == kHashBytes && (!path.isEmpty() || !m_index.contains(hash)))
+                    m_index.insert(hash, path);
+            }
+        }
+    }
+
+    if (StoreSnapshot::currentVersion(m_root) < 0) {
+        StoreLock lock(m_root);
+        StoreSnapshot::ensureManifest(m_root);
+    }
+    bool restart = false;
+    if (StoreSnapshot::currentVersion(m_root) < m_indexedVersion) {
+        // The manifest was recreated; start over
+        m_index.clear();
+        m_indexedVersion = 0;
+        restart = true;
+    }
+
+    qint64 end = 0;
+    const QStringList paths = StoreSnapshot::changesSince(m_root, m_indexedVersion, &end);
+    if (end == m_indexedVersion && !restart)
+        return;
+
+    QByteArray lines;
+    for (const QString &path : paths) {
+        QFile file(m_root + "/" + path);
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+        const QByteArray hash = sha256(file.readAll());
+        m_index.insert(hash, path);
+        lines += hash.toHex() + ' ' + path.toUtf8() + '\n';
+    }
+    lines += '@' + QByteArray::number(end) + '\n';
+
+    StoreLock lock(m_root);
+    if (restart)
+        QFile::remove(indexPath);
+    appendIndex(lines);
+    m_indexedVersion = end;
+}
+
+/**
+ * @brief Appends lines to the hash index with a single write.
+ * @note The caller must hold the StoreLock.
+ */
+void StoreReplicator::appendIndex(const QByteArray &lines)
+{
+    if (lines.isEmpty())
+        return;
+    QFile index(m_root + "/REPLICA");
+    if (!index.open(QIODevice::WriteOnly | QIODevice::Append) || index.write(lines) != lines.size())
+        qWarning() << "Could not append to the replication index:" << index.errorString();
+}
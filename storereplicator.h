@@ -0,0 +1,107 @@
+/**
+ * @file storereplicator.h
+ * @brief Delta replication of series files between stores.
+ */
+
+#ifndef STOREREPLICATOR_H
+#define STOREREPLICATOR_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QSet>
+#include <QString>
+
+/**
+ * @class StoreReplicator
+ * @brief Exchanges only the series files another store lacks, identified by content hash.
+ *
+ * Every series file is identified by the SHA-256 of its JSON. The hashes
+ * are kept in "db/REPLICA", an append-only index that records how much of
+ * the store manifest it covers, so each call hashes only files published
+ * since the last one.
+ *
+ * A round is: the receiving store writes its hash list (manifest()); the
+ * sending store writes a bundle of the files whose hashes are not on that
+ * list (createBundle()); the receiver applies it (applyBundle()). The hash
+ * list costs 32 bytes per file, and the bundle and the work of both sides
+ * scale with the new files.
+ *
+ * Applying merges by timestamp and is idempotent:
+ * - A file whose points the store already has is not written; its hash is
+ *   recorded as absorbed, so it is not offered again.
+ * - A file with new points is added as received, which keeps its hash the
+ *   same on both sides.
+ * - If a file with the same name but other content exists (two collectors
+ *   saving the same window), the two are merged point by point with
+ *   db::mergeByPrecedence(), the received points replacing the local ones
+ *   as when a save fetches a window again.
+ *
+ * Bundle layout (little-endian): the magic "WXREP1\0\0", then per file:
+ * u16 + UTF-8 relative path, 32-byte SHA-256 of the JSON, u32 +
+ * qCompress()ed JSON; a path length of 0 ends the list, followed by the
+ * SHA-256 of all preceding bytes. A bundle is verified completely before
+ * anything is written.
+ */
+class StoreReplicator
+{
+public:
+    static const int kHashBytes = 32;
+
+    /**
+     * @brief Outcome of applyBundle().
+     */
+    struct ApplyResult {
+        bool ok = false;
+        QString error;      ///< Why the bundle was rejected
+        int added = 0;      ///< Files written as received
+        int merged = 0;     ///< Files merged into a local file of the same name
+        int absorbed = 0;   ///< Files without new points
+        int known = 0;      ///< Files already in the store
+    };
+
+    /**
+     * @brief Opens a store for replication.
+     * @param rootPath Store root, created if missing; empty for the application store.
+     */
+    explicit StoreReplicator(const QString &rootPath = QString());
+
+    /**
+     * @brief Hash list of the store, to be sent to the other side.
+     * @return QByteArray "WXHAS1\0\0", u32 count, count x 32-byte hashes.
+     */
+    QByteArray manifest();
+
+    /**
+     * @brief Parses a hash list written by manifest().
+     * @param ok Receives false if the data is not a hash list.
+     */
+    static QSet<QByteArray> parseManifest(const QByteArray &data, bool *ok = nullptr);
+
+    /**
+     * @brief Writes the files the other side lacks.
+     * @param peerHashes Hash list of the other side; empty to send everything.
+     * @param out Open device to write the bundle to.
+     * @return int Files in the bundle, -1 on a write error.
+     */
+    int createBundle(const QSet<QByteArray> &peerHashes, QIODevice *out);
+
+    /**
+     * @brief Verifies a bundle and merges its files into the store.
+     * @note Written through the store's WriteAheadLog like any commit, so
+     * a crash while applying is recovered and readers see the new files
+     * once they are complete.
+     */
+    ApplyResult applyBundle(const QByteArray &bundle);
+
+private:
+    QString m_root;
+    QHash<QByteArray, QString> m_index; ///< Hash -> relative path, empty for absorbed files
+    qint64 m_indexedVersion = 0;        ///< Manifest bytes covered by m_index
+    bool m_indexLoaded = false;
+
+    void refreshIndex();
+    void appendIndex(const QByteArray &lines);
+};
+
+#endif // STOREREPLICATOR_H
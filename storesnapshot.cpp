@@ -0,0 +1,261 @@
+/**
+ * @file storesnapshot.cpp
+ * @brief Implementation of the store lock and manifest snapshots.
+ */
+
+#include "storesnapshot.h"
+#include "db.h"
+#include <QDebug>
+#include <QDirIterator>
+#include <QSaveFile>
+#include <QSet>
+
+namespace {
+QString manifestPath(const QString &rootPath)
+{
+    return rootPath + "/MANIFEST";
+}
+
+/**
+ * @brief Reads the version base of a compacted manifest.
+ * @param data Manifest content, or at least its first line.
+ * @param headerSize Receives the size of the "@version" line, 0 if there is none.
+ * @return qint64 Version of the first byte after the header.
+ */
+qint64 manifestBase(const QByteArray &data, qsizetype *headerSize)
+{
+    *headerSize = 0;
+    const qsizetype newline = data.indexOf('\n');
+    if (!data.startsWith('@') || newline < 0)
+        return 0;
+    *headerSize = newline + 1;
+    return data.mid(1, newline - 1).toLongLong();
+}
+
+/**
+ * @brief Largest header compact() writes: '@', up to 19 digits, newline.
+ */
+const qint64 kMaxHeaderSize = 21;
+}
+
+/**
+ * @brief Acquires the lock; the lock file lives next to the manifest.
+ * @details Lock age is not used to detect staleness (a checkpoint on a slow
+ * disk may hold it for a while); a dead owner is detected by its PID.
+ */
+StoreLock::StoreLock(const QString &rootPath)
+    : m_lock(rootPath + "/writer.lock")
+{
+    m_lock.setStaleLockTime(0);
+    if (!m_lock.lock())
+        qWarning() << "Could not lock the store:" << rootPath << m_lock.error();
+}
+
+/**
+ * @brief Implementation of capture().
+ * @details A line without its terminating newline is still being written
+ * and belongs to a later snapshot.
+ */
+StoreSnapshot StoreSnapshot::capture(const QString &rootPath)
+{
+    const QString root = rootPath.isEmpty() ? db::getAppDataPath() + "/db" : rootPath;
+    StoreSnapshot snapshot;
+
+    QFile manifest(manifestPath(root));
+    if (!manifest.open(QIODevice::ReadOnly)) {
+        for (const QString &path : listDirectories(root)) {
+            const qsizetype slash = path.lastIndexOf('/');
+            snapshot.m_files[path.left(slash)].append(path.mid(slash + 1));
+        }
+        for (QStringList &files : snapshot.m_files)
+            files.sort();
+        return snapshot;
+    }
+
+    const QByteArray data = manifest.readAll();
+    const qsizetype end = data.lastIndexOf('\n') + 1;
+    qsizetype header = 0;
+    const qint64 base = manifestBase(data, &header);
+
+    QMap<QString, QSet<QString>> files;
+    qsizetype pos = header;
+    while (pos < end) {
+        const qsizetype next = data.indexOf('\n', pos);
+        const QString path = QString::fromUtf8(data.constData() + pos, next - pos);
+        const qsizetype slash = path.lastIndexOf('/');
+        if (slash > 0)
+            files[SensorSeries::intern(path.left(slash))].insert(path.mid(slash + 1));
+        pos = next + 1;
+    }
+
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        QStringList names(it.value().cbegin(), it.value().cend());
+        names.sort();
+        snapshot.m_files.insert(it.key(), names);
+    }
+    snapshot.m_version = base + end - header;
+    return snapshot;
+}
+
+/**
+ * @brief Implementation of currentVersion().
+ * @details Between compactions the manifest only grows, so its size and
+ * the base in its header identify the version.
+ */
+qint64 StoreSnapshot::currentVersion(const QString &rootPath)
+{
+    const QString root = rootPath.isEmpty() ? db::getAppDataPath() + "/db" : rootPath;
+    QFile manifest(manifestPath(root));
+    if (!manifest.open(QIODevice::ReadOnly))
+        return -1;
+    qsizetype header = 0;
+    const qint64 base = manifestBase(manifest.read(kMaxHeaderSize), &header);
+    return base + manifest.size() - header;
+}
+
+/**
+ * @brief Implementation of changesSince().
+ * @details As for capture(), a line still being written is left for the
+ * next call. A version from before the last compaction gets every path.
+ */
+QStringList StoreSnapshot::changesSince(const QString &rootPath, qint64 version, qint64 *end)
+{
+    *end = version;
+    QFile manifest(manifestPath(rootPath));
+    if (!manifest.open(QIODevice::ReadOnly))
+        return QStringList();
+    qsizetype header = 0;
+    const qint64 base = manifestBase(manifest.read(kMaxHeaderSize), &header);
+    const qint64 start = header + qMax<qint64>(0, version - base);
+    if (manifest.size() < start || !manifest.seek(start))
+        return QStringList();
+
+    const QByteArray data = manifest.readAll();
+    const qsizetype complete = data.lastIndexOf('\n') + 1;
+    QStringList paths;
+    qsizetype pos = 0;
+    while (pos < complete) {
+        const qsizetype next = data.indexOf('\n', pos);
+        if (next > pos)
+            paths.append(QString::fromUtf8(data.constData() + pos, next - pos));
+        pos = next + 1;
+    }
+    *end = base + start - header + complete;
+    return paths;
+}
+
+/**
+ * @brief Implementation of fileCount().
+ */
+int StoreSnapshot::fileCount() const
+{
+    int count = 0;
+    for (const QStringList &files : m_files)
+        count += files.size();
+    return count;
+}
+
+/**
+ * @brief Implementation of publish().
+ * @details Each path is written as one line with a single write() call.
+ * The manifest is not fsynced here: until the next checkpoint the same
+ * paths are in the write-ahead log, whose recovery publishes them again.
+ */
+bool StoreSnapshot::publish(const QString &rootPath, const QStringList &relativePaths)
+{
+    QByteArray lines;
+    for (const QString &path : relativePaths) {
+        if (path.endsWith(".json"))
+            lines += path.toUtf8() + '\n';
+    }
+    if (lines.isEmpty())
+        return true;
+
+    QFile manifest(manifestPath(rootPath));
+    if (!manifest.open(QIODevice::WriteOnly | QIODevice::Append) || manifest.write(lines) != lines.size()) {
+        qWarning() << "Could not append to the store manifest:" << manifest.errorString();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Implementation of ensureManifest().
+ */
+void StoreSnapshot::ensureManifest(const QString &rootPath)
+{
+    if (QFile::exists(manifestPath(rootPath)))
+        return;
+
+    const QStringList paths = listDirectories(rootPath);
+    QByteArray lines;
+    for (const QString &path : paths)
+        lines += path.toUtf8() + '\n';
+
+    QSaveFile manifest(manifestPath(rootPath));
+    if (!manifest.open(QIODevice::WriteOnly) || manifest.write(lines) != lines.size() || !manifest.commit())
+        qWarning() << "Could not create the store manifest";
+    else
+        qDebug() << "Created the store manifest with" << paths.size() << "files";
+}
+
+/**
+ * @brief Implementation of compact().
+ * @details Keeps the first line of every path, in order, and drops a torn
+ * tail. The new file starts with "@version", the version the old one had
+ * reached, so versions keep growing across compactions.
+ */
+bool StoreSnapshot::compact(const QString &rootPath)
+{
+    QFile manifest(manifestPath(rootPath));
+    if (!manifest.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = manifest.readAll();
+    manifest.close();
+
+    qsizetype header = 0;
+    const qint64 base = manifestBase(data, &header);
+    const qsizetype end = data.lastIndexOf('\n') + 1;
+
+    QSet<QByteArray> seen;
+    QByteArray lines;
+    qsizetype pos = header;
+    while (pos < end) {
+        const qsizetype next = data.indexOf('\n', pos);
+        const QByteArray line = data.mid(pos, next - pos);
+        if (!line.isEmpty() && !seen.contains(line)) {
+            seen.insert(line);
+            lines += line + '\n';
+        }
+        pos = next + 1;
+    }
+    if (lines.size() > (end - header) / kCompactRatio && end == data.size())
+        return true; // Not worth a rewrite yet
+
+    const QByteArray compacted = '@' + QByteArray::number(base + end - header) + '\n' + lines;
+    QSaveFile file(manifestPath(rootPath));
+    if (!file.open(QIODevice::WriteOnly) || file.write(compacted) != compacted.size() || !file.commit()) {
+        qWarning() << "Could not compact the store manifest";
+        return false;
+    }
+    qDebug() << "Compacted the store manifest from" << data.size() << "to" << compacted.size() << "bytes";
+    return true;
+}
+
+/**
+ * @brief Lists "location/file.json" paths by walking the store directories.
+ */
+QStringList StoreSnapshot::listDirectories(const QString &rootPath)
+{
+    QStringList paths;
+    QDirIterator dirs(rootPath, QDir::Dirs | QDir::NoDotAndDotDot);
+    while (dirs.hasNext()) {
+        dirs.next();
+        QDirIterator it(dirs.filePath(), QStringList() << "*.json", QDir::Files);
+        while (it.hasNext()) {
+            it.next();
+            paths.append(dirs.fileName() + "/" + it.fileName());
+        }
+    }
+    return paths;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file storesnapshot.h
+ * @brief Writer lock and reader snapshots shared by processes using one store.
+ */
+
+#ifndef STORESNAPSHOT_H
+#define STORESNAPSHOT_H
+
+#include <QLockFile>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @class StoreLock
+ * @brief Advisory lock giving one process at a time the right to write the store.
+ *
+ * Held by WriteAheadLog for recovery, for each group commit (log append,
+ * placing files, publishing them) and for checkpoints. Readers never take it.
+ * A lock left behind by a crashed process is detected by its PID and taken
+ * over.
+ */
+class StoreLock
+{
+public:
+    /**
+     * @brief Blocks until the lock of a store is acquired.
+     * @param rootPath Store root (AppDataLocation/db).
+     */
+    explicit StoreLock(const QString &rootPath);
+
+    /**
+     * @brief Whether the lock was acquired; false only if the lock file cannot be created.
+     */
+    bool isLocked() const { return m_lock.isLocked(); }
+
+private:
+    QLockFile m_lock;
+};
+
+/**
+ * @class StoreSnapshot
+ * @brief List of the complete series files in the store at one point in time.
+ *
+ * The store keeps a manifest ("db/MANIFEST") of relative series file
+ * paths. A writer appends paths only after their files are complete and
+ * renamed into place, while holding the StoreLock. A snapshot is the set of
+ * complete lines in the manifest when it was read, so readers take no lock,
+ * never wait for the writer and never see files being written.
+ *
+ * Readers never write series files or their segments. The writer may
+ * replace a published file, still under the StoreLock: to merge revised
+ * values (db::reviseSensorData()), a series fetched again, a received
+ * replica, or a damaged file. It does so by renaming a complete new file
+ * over the old one and publishing the path again, so a reader opens either
+ * the old or the new content, and a snapshot's file names stay valid while
+ * the writer goes on. version() tells which snapshot is newer.
+ *
+ * A snapshot fixes which files exist, not what they contain: a file
+ * replaced after capture() is read with its new content. Readers that
+ * open several files may therefore combine contents of different commits;
+ * each file is still complete.
+ *
+ * Caches derived from the series are not part of a snapshot. Pyramids
+ * are written by the commits that change their series (and rebuilt in a
+ * commit of their own), so they follow the files under the same lock;
+ * index.aqi may be rebuilt by any process, replacing it atomically.
+ *
+ * Republished paths repeat in the manifest; compact() rewrites it with each
+ * path once when repeats make up most of it.
+ */
+class StoreSnapshot
+{
+public:
+    /**
+     * @brief Reads the current snapshot of a store.
+     * @param rootPath Store root; empty for the application store.
+     * @note Falls back to listing the directories if no writer has created a
+     * manifest yet; version() is then -1.
+     */
+    static StoreSnapshot capture(const QString &rootPath = QString());
+
+    /**
+     * @brief Manifest position covered; grows with every published commit,
+     * also across compact().
+     */
+    qint64 version() const { return m_version; }
+
+    /**
+     * @brief Version a snapshot taken now would have, without reading the manifest.
+     * @param rootPath Store root; empty for the application store.
+     * @return qint64 Changes whenever a commit is published; -1 without a manifest.
+     * @note May run ahead of capture() while a line is being appended.
+     */
+    static qint64 currentVersion(const QString &rootPath = QString());
+
+    /**
+     * @brief Paths published after a given version, in publication order.
+     * @param rootPath Store root.
+     * @param version Version already seen; 0 for all paths.
+     * @param end Receives the version the returned paths lead up to.
+     * @return QStringList Relative paths; may repeat a path published twice.
+     * @note Reads only the manifest bytes past version; empty without a manifest.
+     */
+    static QStringList changesSince(const QString &rootPath, qint64 version, qint64 *end);
+
+    /**
+     * @brief Locations with at least one series file, sorted.
+     */
+    QStringList locations() const { return m_files.keys(); }
+
+    /**
+     * @brief Series file names of a location, sorted.
+     */
+    QStringList files(const QString &location) const { return m_files.value(location); }
+
+    /**
+     * @brief Total number of series files.
+     */
+    int fileCount() const;
+
+    /**
+     * @brief Publishes complete files; the caller must hold the StoreLock.
+     * @param rootPath Store root.
+     * @param relativePaths Paths below the root; only ".json" series files are recorded.
+     * @return bool False if the manifest could not be appended.
+     */
+    static bool publish(const QString &rootPath, const QStringList &relativePaths);
+
+    /**
+     * @brief Creates the manifest from the directory tree if it does not exist.
+     * @note The caller must hold the StoreLock.
+     */
+    static void ensureManifest(const QString &rootPath);
+
+    /**
+     * @brief Rewrites the manifest with each path once if most lines repeat a path.
+     * @param rootPath Store root.
+     * @return bool False if the manifest could not be read or replaced.
+     * @note The caller must hold the StoreLock. Versions stay comparable;
+     * changesSince() a version from before the rewrite returns every path.
+     */
+    static bool compact(const QString &rootPath);
+
+private:
+    QMap<QString, QStringList> m_files; ///< Location -> sorted file names
+    qint64 m_version = -1;
+
+    static QStringList listDirectories(const QString &rootPath);
+
+    static const int kCompactRatio = 2; ///< Compact once the manifest is this many times its unique size
+};
+
+#endif // STORESNAPSHOT_H
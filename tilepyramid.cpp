@@ -0,0 +1,218 @@
+/**
+ * @file tilepyramid.cpp
+ * @brief Implementation of the multi-resolution tile pyramid.
+ */
+
+#include "tilepyramid.h"
+#include <QDataStream>
+#include <QtNumeric>
+#include <cstring>
+
+namespace {
+const char kMagic[8] = { 'W', 'X', 'P', 'Y', 'R', '1', 0, 0 };
+
+/**
+ * @brief Floor division, also for timestamps before the epoch.
+ */
+qint64 floorDiv(qint64 a, qint64 b)
+{
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+}
+
+/**
+ * @brief Merges two tiles; empty tiles are neutral.
+ */
+TilePyramid::Tile TilePyramid::merge(const Tile &a, const Tile &b)
+{
+    if (a.count == 0) return b;
+    if (b.count == 0) return a;
+    Tile t;
+    t.min = qMin(a.min, b.min);
+    t.max = qMax(a.max, b.max);
+    t.sum = a.sum + b.sum;
+    t.count = a.count + b.count;
+    return t;
+}
+
+/**
+ * @brief Returns the tile of a bucket, growing the level to include it.
+ */
+TilePyramid::Tile &TilePyramid::tileAt(int level, qint64 bucket)
+{
+    Level &l = m_levels[level];
+    if (l.tiles.isEmpty()) {
+        l.origin = bucket;
+        l.tiles.resize(1);
+    } else if (bucket < l.origin) {
+        l.tiles.insert(0, int(l.origin - bucket), Tile());
+        l.origin = bucket;
+    } else if (bucket - l.origin >= l.tiles.size()) {
+        l.tiles.resize(int(bucket - l.origin + 1));
+    }
+    return l.tiles[int(bucket - l.origin)];
+}
+
+/**
+ * @brief Implementation of insert().
+ */
+void TilePyramid::insert(qint32 time, float value)
+{
+    qint64 bucket = floorDiv(time, kBaseSeconds);
+    Tile &hour = tileAt(0, bucket);
+    hour.min = hour.max = value;
+    hour.sum = value;
+    hour.count = 1;
+
+    for (int level = 1; level < kLevels; ++level) {
+        const qint64 left = bucket & ~qint64(1);
+        const Level &children = m_levels[level - 1];
+        auto child = [&children](qint64 b) {
+            const qint64 i = b - children.origin;
+            return i >= 0 && i < children.tiles.size() ? children.tiles[int(i)] : Tile();
+        };
+        const Tile parent = merge(child(left), child(left + 1));
+        bucket = floorDiv(bucket, 2);
+        tileAt(level, bucket) = parent;
+    }
+}
+
+/**
+ * @brief Implementation of insert() for a whole series.
+ * @details Points with quality flags are left out.
+ */
+void TilePyramid::insert(const SensorSeries &series)
+{
+    if (!series.isEmpty())
+        m_coveredUntil = qMax(m_coveredUntil, series.lastTimestamp());
+    for (int i = 0; i < series.size(); ++i) {
+        if (series.isUsable(i))
+            insert(series.timestamp(i), series.value(i));
+    }
+}
+
+/**
+ * @brief Implementation of firstTimestamp().
+ */
+qint32 TilePyramid::firstTimestamp() const
+{
+    const Level &hours = m_levels[0];
+    for (int i = 0; i < hours.tiles.size(); ++i) {
+        if (hours.tiles[i].count > 0)
+            return qint32((hours.origin + i) * kBaseSeconds);
+    }
+    return 0;
+}
+
+/**
+ * @brief Implementation of lastTimestamp().
+ */
+qint32 TilePyramid::lastTimestamp() const
+{
+    const Level &hours = m_levels[0];
+    for (int i = hours.tiles.size() - 1; i >= 0; --i) {
+        if (hours.tiles[i].count > 0)
+            return qint32((hours.origin + i + 1) * kBaseSeconds - 1);
+    }
+    return 0;
+}
+
+/**
+ * @brief Implementation of tiles().
+ * @details Picks the coarsest level whose bucket is no longer than the
+ * range divided by minTiles.
+ */
+QVector<TilePyramid::Span> TilePyramid::tiles(qint32 from, qint32 to, int minTiles) const
+{
+    QVector<Span> spans;
+    if (isEmpty() || to < from)
+        return spans;
+
+    const qint64 range = qint64(to) - from + 1;
+    int level = 0;
+    while (level + 1 < kLevels && (kBaseSeconds << (level + 1)) * qMax(1, minTiles) <= range)
+        ++level;
+
+    const qint64 seconds = kBaseSeconds << level;
+    const Level &l = m_levels[level];
+    const qint64 first = qMax<qint64>(floorDiv(from, seconds) - l.origin, 0);
+    const qint64 last = qMin<qint64>(floorDiv(to, seconds) - l.origin, l.tiles.size() - 1);
+
+    spans.reserve(int(qMax<qint64>(0, last - first + 1)));
+    for (qint64 i = first; i <= last; ++i) {
+        const Tile &tile = l.tiles[int(i)];
+        if (tile.count > 0)
+            spans.append({ (l.origin + i) * seconds, seconds, tile });
+    }
+    return spans;
+}
+
+/**
+ * @brief Implementation of hourValues().
+ */
+QVector<float> TilePyramid::hourValues(qint64 firstHour, int count) const
+{
+    QVector<float> values(qMax(0, count), qQNaN());
+    const Level &hours = m_levels[0];
+    const qint64 begin = qMax(firstHour, hours.origin);
+    const qint64 end = qMin(firstHour + count, hours.origin + hours.tiles.size());
+    for (qint64 hour = begin; hour < end; ++hour) {
+        const Tile &tile = hours.tiles[int(hour - hours.origin)];
+        if (tile.count > 0)
+            values[int(hour - firstHour)] = tile.min;
+    }
+    return values;
+}
+
+/**
+ * @brief Implementation of toBytes().
+ */
+QByteArray TilePyramid::toBytes() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    const Level &hours = m_levels[0];
+    out.writeRawData(kMagic, sizeof(kMagic));
+    out << qint32(m_coveredUntil) << qint64(hours.origin) << quint32(hours.tiles.size());
+    for (const Tile &tile : hours.tiles)
+        out << (tile.count > 0 ? tile.min : qQNaN());
+    return data;
+}
+
+/**
+ * @brief Implementation of fromBytes().
+ */
+TilePyramid TilePyramid::fromBytes(const QByteArray &data, bool *ok)
+{
+    TilePyramid pyramid;
+    if (ok) *ok = false;
+
+    QDataStream in(data);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    char magic[sizeof(kMagic)];
+    if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic)) || memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+        return pyramid;
+
+    qint32 coveredUntil = 0;
+    qint64 origin = 0;
+    quint32 count = 0;
+    in >> coveredUntil >> origin >> count;
+    if (in.status() != QDataStream::Ok || data.size() - in.device()->pos() < qint64(count) * 4)
+        return pyramid;
+
+    for (quint32 i = 0; i < count; ++i) {
+        float value;
+        in >> value;
+        if (!qIsNaN(value))
+            pyramid.insert(qint32((origin + i) * kBaseSeconds), value);
+    }
+
+    pyramid.m_coveredUntil = coveredUntil;
+    if (ok) *ok = in.status() == QDataStream::Ok;
+    return pyramid;
+}
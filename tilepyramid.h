@@ -0,0 +1,130 @@
+/**
+ * @file tilepyramid.h
+ * @brief Multi-resolution min/max/mean summary of one sensor's history.
+ */
+
+#ifndef TILEPYRAMID_H
+#define TILEPYRAMID_H
+
+#include <QByteArray>
+#include <QVector>
+#include "sensorseries.h"
+
+/**
+ * @class TilePyramid
+ * @brief Min/max/mean tiles at power-of-two multiples of one hour.
+ *
+ * Level 0 holds one tile per hour, level n one tile per 2^n hours, so a
+ * parent tile is exactly the merge of its two children. Inserting a point
+ * sets its hour tile and recomputes its ancestors, which costs one step per
+ * level and works in any order. GIOS publishes one value per hour, so a
+ * point for an hour that already has a value replaces it: repeated inserts
+ * of overlapping windows are harmless and revised values are applied.
+ *
+ * tiles() returns a range at the coarsest level that still gives at least
+ * the requested number of tiles, so drawing any range costs about one tile
+ * per pixel whatever the length of the history.
+ *
+ * Only hour values are persisted (4 bytes per hour, little-endian):
+ * the magic "WXPYR1\0\0", i32 coveredUntil(), i64 first hour since the
+ * epoch, u32 hour count, then one f32 per hour, NaN where there is no value.
+ * Upper levels are rebuilt on load.
+ */
+class TilePyramid
+{
+public:
+    /**
+     * @brief Summary of the points of one time bucket.
+     */
+    struct Tile {
+        float min = 0;
+        float max = 0;
+        double sum = 0;
+        quint32 count = 0; ///< Points in the bucket; 0 for an empty tile
+
+        double mean() const { return count > 0 ? sum / count : 0; }
+    };
+
+    /**
+     * @brief Tile with the start of its bucket.
+     */
+    struct Span {
+        qint64 start;   ///< Bucket start, epoch seconds
+        qint64 seconds; ///< Bucket length
+        Tile tile;
+    };
+
+    static const int kLevels = 16;          ///< Up to 2^15 hours (about 3.7 years) per tile
+    static const qint64 kBaseSeconds = 3600; ///< Bucket length of level 0
+
+    /**
+     * @brief Sets the value of the hour containing a timestamp.
+     */
+    void insert(qint32 time, float value);
+
+    /**
+     * @brief Inserts every valid point of a series that has no quality flag.
+     * @note Also advances coveredUntil() to the series' last timestamp.
+     */
+    void insert(const SensorSeries &series);
+
+    /**
+     * @brief Newest timestamp of all inserted series, including invalid points.
+     * @details Lets the store tell whether the pyramid has seen its newest file,
+     * whose newest point is often still empty.
+     */
+    qint32 coveredUntil() const { return m_coveredUntil; }
+
+    bool isEmpty() const { return m_levels[0].tiles.isEmpty(); }
+
+    /**
+     * @brief Start of the oldest and end of the newest hour with a value.
+     */
+    qint32 firstTimestamp() const;
+    qint32 lastTimestamp() const;
+
+    /**
+     * @brief Non-empty tiles overlapping a range, at a resolution for a given width.
+     * @param from Range start, epoch seconds.
+     * @param to Range end, epoch seconds.
+     * @param minTiles Resolution the caller needs, e.g. the chart width in pixels.
+     * @return QVector<Span> Tiles in time order; buckets at the edges may extend past the range.
+     */
+    QVector<Span> tiles(qint32 from, qint32 to, int minTiles) const;
+
+    /**
+     * @brief Hour values as a dense column.
+     * @param firstHour First hour, in hours since the epoch.
+     * @param count Number of hours.
+     * @return QVector<float> One value per hour, NaN where the hour has none.
+     */
+    QVector<float> hourValues(qint64 firstHour, int count) const;
+
+    /**
+     * @brief Serializes the hour values.
+     */
+    QByteArray toBytes() const;
+
+    /**
+     * @brief Parses data written by toBytes().
+     * @param ok Receives false if the data is not a pyramid (optional).
+     */
+    static TilePyramid fromBytes(const QByteArray &data, bool *ok = nullptr);
+
+private:
+    /**
+     * @brief Tiles of one level, starting at an absolute bucket index.
+     */
+    struct Level {
+        qint64 origin = 0;
+        QVector<Tile> tiles;
+    };
+
+    Level m_levels[kLevels];
+    qint32 m_coveredUntil = 0;
+
+    Tile &tileAt(int level, qint64 bucket);
+    static Tile merge(const Tile &a, const Tile &b);
+};
+
+#endif // TILEPYRAMID_H
@@ -0,0 +1,629 @@
+/**
+ * @file writeaheadlog.cpp
+ * @brief Implementation of the store's write-ahead log.
+ */
+
+#include "writeaheadlog.h"
+#include "db.h"
+#include "storesnapshot.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QtEndian>
+#include <array>
+#include <map>
+#include <memory>
+#include <utility>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+namespace {
+const quint32 kRecordMagic = 0x314C4157; ///< "WAL1"
+const int kHeaderSize = 12;              ///< magic, payload length, CRC-32
+
+/**
+ * @brief CRC-32 (IEEE) of a byte range.
+ */
+quint32 crc32(const char *data, qsizetype size)
+{
+    static const auto table = []() {
+        std::array<quint32, 256> t{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (qsizetype i = 0; i < size; ++i)
+        crc = table[(crc ^ quint8(data[i])) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * @brief Flushes a file's data to stable storage.
+ */
+bool syncFile(QFile &file)
+{
+    if (!file.flush())
+        return false;
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+/**
+ * @brief Renames a file over another in one step.
+ * @details QFile::rename() refuses an existing target, and removing it
+ * first leaves a moment without the file.
+ */
+bool replaceFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_WIN
+    return MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(from).utf16()),
+                       reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(to).utf16()),
+                       MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+}
+
+/**
+ * @brief Implementation of instance().
+ */
+WriteAheadLog &WriteAheadLog::instance()
+{
+    return at(db::getAppDataPath() + "/db");
+}
+
+/**
+ * @brief Implementation of at().
+ * @details Thread-safe; the first caller for a root performs recovery.
+ * Logs live until the process exits.
+ */
+WriteAheadLog &WriteAheadLog::at(const QString &rootPath)
+{
+    static QMutex mutex;
+    static std::map<QString, std::unique_ptr<WriteAheadLog>> logs;
+
+    QMutexLocker locker(&mutex);
+    std::unique_ptr<WriteAheadLog> &log = logs[QDir::cleanPath(QDir(rootPath).absolutePath())];
+    if (!log)
+        log.reset(new WriteAheadLog(rootPath));
+    return *log;
+}
+
+/**
+ * @brief Opens (creating if needed) the log and replays leftover records.
+ */
+WriteAheadLog::WriteAheadLog(const QString &rootPath)
+    : m_root(rootPath)
+    , m_log(rootPath + "/wal.log")
+{
+    QDir().mkpath(m_root);
+    if (!m_log.open(QIODevice::ReadWrite)) {
+        qWarning() << "Could not open write-ahead log:" << m_log.fileName();
+        return; // The next write() tries again
+    }
+    recover();
+}
+
+/**
+ * @brief Encodes a record as header + payload.
+ * @details Payload: u16 path length, UTF-8 path, file content. The header
+ * holds the magic, the payload length and the payload's CRC-32, all
+ * little-endian.
+ */
+QByteArray WriteAheadLog::encode(const Record &record)
+{
+    const QByteArray path = record.relativePath.toUtf8();
+
+    QByteArray payload;
+    payload.reserve(2 + path.size() + record.content.size());
+    const quint16 pathSize = qToLittleEndian(quint16(path.size()));
+    payload.append(reinterpret_cast<const char *>(&pathSize), 2);
+    payload.append(path);
+    payload.append(record.content);
+
+    quint32 header[3] = { qToLittleEndian(kRecordMagic),
+                          qToLittleEndian(quint32(payload.size())),
+                          qToLittleEndian(crc32(payload.constData(), payload.size())) };
+
+    QByteArray encoded(reinterpret_cast<const char *>(header), kHeaderSize);
+    encoded.append(payload);
+    return encoded;
+}
+
+/**
+ * @brief Decodes the complete records at the start of log data.
+ * @param data Log content.
+ * @param end Receives the offset after the last complete record.
+ * @details Stops at the first record with a bad header, short payload or
+ * checksum mismatch.
+ */
+QVector<WriteAheadLog::Record> WriteAheadLog::decode(const QByteArray &data, qsizetype *end)
+{
+    QVector<Record> records;
+    qsizetype pos = 0;
+
+    while (data.size() - pos >= kHeaderSize) {
+        const quint32 magic = qFromLittleEndian<quint32>(data.constData() + pos);
+        const quint32 size = qFromLittleEndian<quint32>(data.constData() + pos + 4);
+        const quint32 crc = qFromLittleEndian<quint32>(data.constData() + pos + 8);
+        if (magic != kRecordMagic || size < 2 || qsizetype(size) > data.size() - pos - kHeaderSize)
+            break;
+
+        const char *payload = data.constData() + pos + kHeaderSize;
+        if (crc32(payload, size) != crc)
+            break;
+
+        const quint16 pathSize = qFromLittleEndian<quint16>(payload);
+        if (pathSize + 2u > size)
+            break;
+
+        Record record;
+        record.relativePath = QString::fromUtf8(payload + 2, pathSize);
+        record.content = QByteArray(payload + 2 + pathSize, size - 2 - pathSize);
+        records.append(record);
+
+        pos += kHeaderSize + size;
+    }
+
+    *end = pos;
+    return records;
+}
+
+/**
+ * @brief Replays complete records and drops a torn tail.
+ * @details Runs under the StoreLock, so no other process is appending. A
+ * record whose file is already in place with the same content is not
+ * written again; all replayed paths are published, since the crash may
+ * have come before their manifest lines. Everything after the last
+ * complete record is discarded; the complete records are kept while
+ * files are held back.
+ */
+void WriteAheadLog::recover()
+{
+    StoreLock lock(m_root);
+    StoreSnapshot::ensureManifest(m_root);
+
+    const QByteArray data = m_log.readAll();
+    qsizetype end = 0;
+    const QVector<Record> records = decode(data, &end);
+
+    int replayed = 0;
+    StoreSnapshot::publish(m_root, place(records, true, &replayed));
+
+    if (end < data.size())
+        qWarning() << "Discarding" << data.size() - end << "bytes of incomplete write-ahead log";
+    if (replayed > 0)
+        qDebug() << "Recovered" << replayed << "store files from the write-ahead log";
+
+    if (!m_heldBack.isEmpty()) {
+        // The log still holds their content; only the torn tail goes
+        qWarning() << m_heldBack.size() << "store files could not be replaced; keeping the write-ahead log";
+        m_log.resize(end);
+        syncFile(m_log);
+        m_logBytes = end;
+    } else if (!data.isEmpty()) {
+        syncStore(records);
+        m_log.resize(0);
+        syncFile(m_log);
+    }
+    m_log.seek(0);
+}
+
+/**
+ * @brief Writes a store file under a temporary name and renames it over the old one.
+ * @param record File to write.
+ * @param onlyIfDifferent Skip if the file already has this content (recovery).
+ * @return Placement Whether the file was written, already current or not replaced.
+ * @note Not fsynced; the log keeps the content until the next checkpoint.
+ */
+WriteAheadLog::Placement WriteAheadLog::materialize(const Record &record, bool onlyIfDifferent)
+{
+    const QString finalPath = m_root + "/" + record.relativePath;
+    if (onlyIfDifferent) {
+        QFile existing(finalPath);
+        if (existing.open(QIODevice::ReadOnly) && existing.size() == record.content.size()
+            && existing.readAll() == record.content)
+            return Unchanged;
+    }
+
+    QDir().mkpath(QFileInfo(finalPath).absolutePath());
+
+    const QString tempPath = finalPath + ".tmp";
+    QFile temp(tempPath);
+    if (!temp.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || temp.write(record.content) != record.content.size()) {
+        qWarning() << "Could not write" << tempPath;
+        return Failed;
+    }
+    temp.close();
+
+    if (!replaceFile(tempPath, finalPath)) {
+        qWarning() << "Could not move" << tempPath << "into place";
+        QFile::remove(tempPath);
+        return Failed;
+    }
+    return Written;
+}
+
+/**
+ * @brief Places logged files, holding back the ones that cannot be replaced.
+ * @param records Records in log order.
+ * @param onlyIfDifferent Passed to materialize().
+ * @param written Incremented per file actually written, if given.
+ * @return QStringList Paths in place, unchanged ones included.
+ * @details A record supersedes a held-back one for the same path. A series
+ * file whose segment is held back is held back too, so readers keep seeing
+ * a matching pair (segments are logged before their series file).
+ */
+QStringList WriteAheadLog::place(const QVector<Record> &records, bool onlyIfDifferent, int *written)
+{
+    QStringList placed;
+    for (const Record &record : records) {
+        m_heldBack.removeIf([&record](const HeldBack &file) { return file.record.relativePath == record.relativePath; });
+        const Placement placement = waitsForSegment(record) ? Failed : materialize(record, onlyIfDifferent);
+        if (placement == Failed) {
+            holdBack(record);
+            continue;
+        }
+        if (placement == Written && written)
+            ++*written;
+        placed.append(record.relativePath);
+    }
+    return placed;
+}
+
+/**
+ * @brief Tries again to place the held-back files.
+ * @return QStringList Paths placed now.
+ * @details A file that changed since it was held back was replaced by
+ * another writer with newer content and is dropped.
+ */
+QStringList WriteAheadLog::placeHeldBack()
+{
+    const QVector<HeldBack> heldBack = std::exchange(m_heldBack, {});
+    QStringList placed;
+    for (const HeldBack &file : heldBack) {
+        const QFileInfo info(m_root + "/" + file.record.relativePath);
+        if (info.lastModified() != file.modified || info.size() != file.size)
+            continue;
+        if (waitsForSegment(file.record) || materialize(file.record, false) == Failed)
+            m_heldBack.append(file);
+        else
+            placed.append(file.record.relativePath);
+    }
+    return placed;
+}
+
+/**
+ * @brief Remembers a logged file that is not in place, with the state of the file it should replace.
+ */
+void WriteAheadLog::holdBack(const Record &record)
+{
+    const QFileInfo info(m_root + "/" + record.relativePath);
+    m_heldBack.append({ record, info.lastModified(), info.size() });
+}
+
+/**
+ * @brief Whether a record must wait for its held-back segment.
+ */
+bool WriteAheadLog::waitsForSegment(const Record &record) const
+{
+    if (!record.relativePath.endsWith(".json"))
+        return false;
+    const QString segment = db::segmentPath(record.relativePath);
+    for (const HeldBack &file : m_heldBack) {
+        if (file.record.relativePath == segment)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Whether every logged file is in place, whichever process logged it.
+ * @param logged Records in the log, in log order.
+ * @details Compares the last record of each path with the store file. A
+ * file that differs is held back by some process, which keeps only the
+ * log's copy of the content; truncating would lose it. A file that no
+ * longer exists holds nothing back.
+ */
+bool WriteAheadLog::allInPlace(const QVector<Record> &logged) const
+{
+    QSet<QString> checked;
+    for (qsizetype i = logged.size() - 1; i >= 0; --i) {
+        const Record &record = logged[i];
+        if (checked.contains(record.relativePath))
+            continue;
+        checked.insert(record.relativePath);
+
+        QFile file(m_root + "/" + record.relativePath);
+        if (!file.exists())
+            continue;
+        if (!file.open(QIODevice::ReadOnly) || file.size() != record.content.size()
+            || file.readAll() != record.content)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Makes every store file written since the last checkpoint durable.
+ * @param logged Records in the log, from any process.
+ * @details Linux syncs the store's file system with one syncfs() call and
+ * other POSIX systems fall back to sync(). Windows has no equivalent, so
+ * each logged file and the manifest are flushed there.
+ */
+void WriteAheadLog::syncStore(const QVector<Record> &logged)
+{
+#if defined(Q_OS_LINUX)
+    Q_UNUSED(logged)
+    ::syncfs(m_log.handle());
+#elif defined(Q_OS_WIN)
+    QStringList paths;
+    for (const Record &record : logged)
+        paths.append(m_root + "/" + record.relativePath);
+    paths.append(m_root + "/MANIFEST");
+    for (const QString &path : std::as_const(paths)) {
+        QFile file(path);
+        if (file.open(QIODevice::ReadWrite))
+            syncFile(file);
+    }
+#else
+    Q_UNUSED(logged)
+    ::sync();
+#endif
+}
+
+/**
+ * @brief Implementation of write().
+ * @details Records are encoded here, before the group's leader is waited
+ * for.
+ */
+bool WriteAheadLog::write(const QVector<Record> &records)
+{
+    if (records.isEmpty())
+        return true;
+
+    Ticket ticket;
+    ticket.records = records;
+    for (const Record &record : records)
+        ticket.encoded += encode(record);
+    return commit(&ticket);
+}
+
+/**
+ * @brief Implementation of write() with a build.
+ */
+bool WriteAheadLog::write(const Build &build)
+{
+    Ticket ticket;
+    ticket.build = build;
+    return commit(&ticket);
+}
+
+/**
+ * @brief Queues a write and waits until a leader has flushed it.
+ * @details The first writer to find the log idle becomes the leader and
+ * flushes the whole queue, including writes other threads queued while the
+ * previous flush was running. The leader takes the StoreLock, retries the
+ * held-back files, runs the builds in queue order, appends at the current
+ * end of the log (another process may have appended or truncated it),
+ * places every file of the group and publishes them. A failed flush fails
+ * the calls of its group only; a partial append is cut off again, so it
+ * cannot hide records appended after it.
+ */
+bool WriteAheadLog::commit(Ticket *ticket)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_checkpointing)
+        m_condition.wait(&m_mutex);
+
+    m_pendingTickets.append(ticket);
+
+    while (!ticket->done) {
+        if (m_flushing) {
+            m_condition.wait(&m_mutex);
+            continue;
+        }
+
+        m_flushing = true;
+        QVector<Ticket *> batchTickets;
+        batchTickets.swap(m_pendingTickets);
+        locker.unlock();
+
+        // The log could not be opened at startup; recovery is still due then
+        if (!m_log.isOpen() && m_log.open(QIODevice::ReadWrite))
+            recover();
+
+        bool ok = false;
+        QString error;
+        qint64 logBytes = 0;
+        {
+            StoreLock lock(m_root);
+            if (!m_log.isOpen()) {
+                error = "log not open";
+            } else if (!lock.isLocked()) {
+                error = "store lock not acquired";
+            } else {
+                QStringList paths = placeHeldBack();
+                QVector<Record> batchRecords;
+                QByteArray batch;
+                for (Ticket *waiting : std::as_const(batchTickets)) {
+                    if (waiting->build) {
+                        Transaction transaction(this, &batchRecords, waiting);
+                        waiting->build(transaction);
+                    } else {
+                        batchRecords += waiting->records;
+                    }
+                    batch += waiting->encoded;
+                }
+
+                const qint64 start = m_log.size();
+                ok = batch.isEmpty()
+                     || (m_log.seek(start) && m_log.write(batch) == batch.size() && syncFile(m_log));
+                if (ok) {
+                    logBytes = m_log.size();
+                    paths += place(batchRecords);
+                    if (!m_heldBack.isEmpty())
+                        qWarning() << m_heldBack.size() << "store files are in use; they stay in the write-ahead log";
+                } else {
+                    error = m_log.errorString();
+                    m_log.resize(start);
+                }
+                StoreSnapshot::publish(m_root, paths);
+            }
+        }
+
+        locker.relock();
+        m_flushing = false;
+        if (ok)
+            m_logBytes = logBytes;
+        else
+            qWarning() << "Write-ahead log append failed:" << error;
+        for (Ticket *waiting : std::as_const(batchTickets)) {
+            waiting->done = true;
+            waiting->ok = ok;
+        }
+        m_condition.wakeAll();
+    }
+    if (!ticket->ok)
+        return false;
+
+    const bool needCheckpoint = m_logBytes > m_checkpointAt;
+    locker.unlock();
+
+    if (needCheckpoint)
+        checkpoint();
+    return true;
+}
+
+/**
+ * @brief Implementation of checkpoint().
+ * @details Blocks new writers and waits for the queued ones, then syncs
+ * and truncates the log under the StoreLock. Records of other processes
+ * are complete at that point, since they place their files while holding
+ * the same lock. Without the lock, or while files are held back by this
+ * process or another one (see allInPlace()), the log is left as it is and
+ * the next attempt waits until it has grown by another threshold. The
+ * manifest is compacted at the same time.
+ */
+void WriteAheadLog::checkpoint()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_checkpointing)
+        return;
+    m_checkpointing = true;
+
+    while (m_flushing || !m_pendingTickets.isEmpty())
+        m_condition.wait(&m_mutex);
+
+    if (m_log.isOpen()) {
+        StoreLock lock(m_root);
+        if (lock.isLocked())
+            StoreSnapshot::publish(m_root, placeHeldBack());
+        bool truncated = false;
+        if (!m_heldBack.isEmpty()) {
+            qWarning() << m_heldBack.size() << "store files are still in use; keeping the write-ahead log";
+        } else if (lock.isLocked()) {
+            m_log.seek(0);
+            qsizetype end = 0;
+            const QVector<Record> logged = decode(m_log.readAll(), &end);
+            if (!allInPlace(logged)) {
+                qWarning() << "Another process holds back store files; keeping the write-ahead log";
+            } else {
+                syncStore(logged);
+                m_log.resize(0);
+                m_log.seek(0);
+                syncFile(m_log);
+                m_logBytes = 0;
+                StoreSnapshot::compact(m_root);
+                truncated = true;
+            }
+        }
+        m_checkpointAt = truncated ? kCheckpointBytes : m_logBytes + kCheckpointBytes;
+    }
+
+    m_checkpointing = false;
+    m_condition.wakeAll();
+}
+
+/**
+ * @brief Implementation of the Transaction constructor.
+ */
+WriteAheadLog::Transaction::Transaction(const WriteAheadLog *log, QVector<Record> *group, Ticket *ticket)
+    : m_log(log)
+    , m_group(group)
+    , m_ticket(ticket)
+{
+}
+
+/**
+ * @brief Implementation of pending().
+ * @details The group's records are newer than the held-back ones, and a
+ * later record of a path newer than an earlier one.
+ */
+bool WriteAheadLog::Transaction::pending(const QString &relativePath, QByteArray *content) const
+{
+    for (qsizetype i = m_group->size() - 1; i >= 0; --i) {
+        if (m_group->at(i).relativePath == relativePath) {
+            if (content)
+                *content = m_group->at(i).content;
+            return true;
+        }
+    }
+    for (qsizetype i = m_log->m_heldBack.size() - 1; i >= 0; --i) {
+        if (m_log->m_heldBack[i].record.relativePath == relativePath) {
+            if (content)
+                *content = m_log->m_heldBack[i].record.content;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Implementation of pendingFiles().
+ */
+QStringList WriteAheadLog::Transaction::pendingFiles(const QString &directory) const
+{
+    const QString prefix = directory + "/";
+    QStringList names;
+    auto collect = [&](const Record &record) {
+        if (!record.relativePath.startsWith(prefix))
+            return;
+        const QString name = record.relativePath.mid(prefix.size());
+        if (!name.contains('/') && !names.contains(name))
+            names.append(name);
+    };
+    for (const Record &record : std::as_const(*m_group))
+        collect(record);
+    for (const HeldBack &file : m_log->m_heldBack)
+        collect(file.record);
+    return names;
+}
+
+/**
+ * @brief Implementation of write().
+ */
+void WriteAheadLog::Transaction::write(const Record &record)
+{
+    m_group->append(record);
+    m_ticket->records.append(record);
+    m_ticket->encoded += encode(record);
+}
@@ -0,0 +1,199 @@
+/**
+ * @file writeaheadlog.h
+ * @brief Crash-safe write path for the local store.
+ */
+
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+#include <functional>
+
+/**
+ * @class WriteAheadLog
+ * @brief Makes store writes durable with one fsync per group of writes.
+ *
+ * A write first appends its files to "db/wal.log" as checksummed records.
+ * Concurrent writers share one flush: whichever thread finds the log idle
+ * writes and fsyncs everything queued so far, and the others wait for it
+ * (group commit). Only then are the files written under a temporary name
+ * and renamed over the old ones, so a store file is always complete: the
+ * old content or the new.
+ *
+ * The store files themselves are not fsynced one by one. Once the log
+ * grows past a threshold, a checkpoint syncs the file system once and
+ * empties the log. On startup, records still in the log are replayed and a
+ * torn record at the end (crash during append) is discarded.
+ *
+ * A file that cannot be replaced (on Windows, one that is open or mapped
+ * elsewhere) is held back: it stays in the log, later flushes and
+ * checkpoints try again, and no process empties the log until it is in
+ * place (a checkpoint compares every logged file with the store first).
+ *
+ * Several processes may share the store. The leader holds the StoreLock
+ * from appending its group until the files are in place and published in
+ * the manifest (see StoreSnapshot); recovery and checkpoints hold it too,
+ * so processes never truncate or replay each other's commits in flight.
+ *
+ * A write that depends on what is stored (merging into an existing file)
+ * passes a Build instead of finished records. The leader runs it under the
+ * StoreLock, just before appending the group, so the files it reads cannot
+ * change before its own records replace them.
+ */
+class WriteAheadLog
+{
+public:
+    /**
+     * @brief One store file to write.
+     */
+    struct Record {
+        QString relativePath; ///< Path below the store root, e.g. "City/PM10_...json"
+        QByteArray content;   ///< Complete file content
+    };
+
+    class Transaction;
+
+    /**
+     * @brief Computes the files of a write from the store's current content.
+     */
+    using Build = std::function<void(Transaction &transaction)>;
+
+    /**
+     * @brief Returns the log of the application store, recovering it on first use.
+     */
+    static WriteAheadLog &instance();
+
+    /**
+     * @brief Returns the log of any store, recovering it on first use.
+     * @param rootPath Store root; one log per root and process.
+     */
+    static WriteAheadLog &at(const QString &rootPath);
+
+    /**
+     * @brief Durably writes a group of files.
+     * @param records Files to write; existing files with the same path are replaced.
+     * @return bool False if the log could not be written (nothing was stored);
+     * later calls try again.
+     * @note Blocks until the records are in the fsynced log and the files are
+     * in place, except held-back files, which are placed later.
+     */
+    bool write(const QVector<Record> &records);
+
+    /**
+     * @brief Durably writes files computed under the StoreLock.
+     * @param build Called once by the leader of the group, with the StoreLock
+     * held; it reads through the Transaction and adds the files to write.
+     * @return bool False if the log could not be written (nothing was stored).
+     * @note Blocks like write(records). The build may run on another thread,
+     * but always before this call returns.
+     */
+    bool write(const Build &build);
+
+    /**
+     * @brief Syncs written store files to disk and empties the log.
+     */
+    void checkpoint();
+
+private:
+    /**
+     * @brief One write() call waiting for the leader.
+     */
+    struct Ticket {
+        QVector<Record> records; ///< Finished records, or the ones build added
+        QByteArray encoded;      ///< The records as appended to the log
+        Build build;             ///< Run by the leader, if set
+        bool done = false;       ///< Set by the leader that flushed it
+        bool ok = false;
+    };
+
+    /**
+     * @brief Result of putting one logged file in place.
+     */
+    enum Placement { Written, Unchanged, Failed };
+
+    /**
+     * @brief Logged file that could not replace the store file yet.
+     */
+    struct HeldBack {
+        Record record;
+        QDateTime modified; ///< State of the file it should replace
+        qint64 size;
+    };
+
+    explicit WriteAheadLog(const QString &rootPath);
+    Q_DISABLE_COPY(WriteAheadLog)
+
+    void recover();
+    bool commit(Ticket *ticket);
+    Placement materialize(const Record &record, bool onlyIfDifferent);
+    QStringList place(const QVector<Record> &records, bool onlyIfDifferent = false, int *written = nullptr);
+    QStringList placeHeldBack();
+    void holdBack(const Record &record);
+    bool waitsForSegment(const Record &record) const;
+    bool allInPlace(const QVector<Record> &logged) const;
+    void syncStore(const QVector<Record> &logged);
+
+    static QByteArray encode(const Record &record);
+    static QVector<Record> decode(const QByteArray &data, qsizetype *end);
+
+    QString m_root;
+    QFile m_log;
+
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    QVector<Ticket *> m_pendingTickets; ///< Calls waiting for the next flush
+    bool m_flushing = false;      ///< A leader is writing the log
+    bool m_checkpointing = false; ///< A checkpoint is in progress
+    qint64 m_logBytes = 0;        ///< Log size after the last append, all processes included
+    qint64 m_checkpointAt = kCheckpointBytes; ///< Log size that triggers the next checkpoint
+    QVector<HeldBack> m_heldBack; ///< In log order; used by the leader or the checkpoint only
+
+    static const qint64 kCheckpointBytes = 8 * 1024 * 1024; ///< Log size that triggers a checkpoint
+};
+
+/**
+ * @class WriteAheadLog::Transaction
+ * @brief What a Build sees of the store and how it adds files.
+ *
+ * Files of the same group (earlier builds and records included) and
+ * held-back files are logged but not in place yet; reads return their
+ * logged content, so a build never merges into an outdated file.
+ */
+class WriteAheadLog::Transaction
+{
+public:
+    /**
+     * @brief Logged content of a file that is not in place yet.
+     * @param relativePath Path below the store root.
+     * @param content Receives the content, if given.
+     * @return bool False if the file in the store is current.
+     */
+    bool pending(const QString &relativePath, QByteArray *content = nullptr) const;
+
+    /**
+     * @brief Names of the pending files directly in a directory.
+     * @param directory Path below the store root, e.g. a location.
+     */
+    QStringList pendingFiles(const QString &directory) const;
+
+    /**
+     * @brief Adds a file to the write; later reads of its path return it.
+     */
+    void write(const Record &record);
+
+private:
+    friend class WriteAheadLog;
+    Transaction(const WriteAheadLog *log, QVector<Record> *group, Ticket *ticket);
+
+    const WriteAheadLog *m_log;
+    QVector<Record> *m_group; ///< Records of the group so far, this write's included
+    Ticket *m_ticket;
+};
+
+#endif // WRITEAHEADLOG_H